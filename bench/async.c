@@ -0,0 +1,78 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// async.c
+// ---------------------------------------------------------------------------------------------- //
+// Measures the asynchronous writer draining to a file, once with [writev] and once with io_uring.
+// Each run logs [BURSTS] bursts of [BURST] records from the main thread, each small enough for the
+// ring, and waits for every burst to be written before the next; it reports the producer's time per
+// record, the writer's throughput, and the records dropped (which should be none). [stdout] is
+// redirected to the file given as the only argument ([bench-async.log] by default).
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-async bench/async.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+
+#define BURSTS 64
+#define BURST 16384
+#define CAPACITY 32768
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void run(const char* name, const char* path, bool io_uring) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) exit(1);
+    close(fd);
+
+    lurk_async_set_io_uring(io_uring);
+    if (lurk_async_start(CAPACITY) != RESULT_SUCCESS) exit(1);
+
+    size_t dropped = lurk_async_dropped();
+    uint64_t produced = 0;
+    uint64_t start = now();
+    for (long burst = 0; burst < BURSTS; burst++) {
+        uint64_t begin = now();
+        for (long i = 0; i < BURST; i++)
+            LURK_LOG_FMT(RESULT_SUCCESS, "record %ld of the asynchronous writer benchmark", i);
+        produced += now() - begin;
+        lurk_async_flush();
+    }
+    uint64_t written = now() - start;
+    dropped = lurk_async_dropped() - dropped;
+
+    // the backend is only known once the writer has started
+    bool used = lurk_async_io_uring();
+    lurk_async_stop();
+
+    double records = (double)BURSTS * BURST;
+    fprintf(stderr, "%-8s (%s) %6.1f ns/record produced  %5.2f M records/s written  %zu dropped\n",
+            name, used ? "io_uring" : "writev",
+            (double)produced / records, records / ((double)written / 1e3), dropped);
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "bench-async.log";
+
+    run("writev", path, false);
+    run("io_uring", path, true);
+
+    return 0;
+}
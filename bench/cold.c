@@ -0,0 +1,82 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// cold.c
+// ---------------------------------------------------------------------------------------------- //
+// Measures the passing path of a guard-heavy function. [guarded] checks five parameters and two
+// objects and reports a formatted error if its count is negative; every failing branch should end
+// up in [guarded.cold], leaving [guarded] itself a straight line of compares. [bench/size-report.sh]
+// prints the size of both halves.
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-cold bench/cold.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "lurk.h"
+
+#define ITERATIONS 100000000L
+#define ROUNDS 5
+
+struct object {
+    int valid;
+    int value;
+};
+
+struct total {
+    int value;
+    result_t result;
+};
+
+static inline result_t object_check(const struct object* obj) {
+    return obj->valid ? RESULT_VALID_OBJECT : RESULT_INVALID_OBJECT;
+}
+
+__attribute__((noinline)) struct total guarded(const struct object* obj,
+                                               const int* a, const int* b, const int* c, int n) {
+    struct total total = { 0 };
+    OBJ_GUARD_NULL_PARAM(total, result, obj);
+    OBJ_GUARD_NULL_PARAM(total, result, a);
+    OBJ_GUARD_NULL_PARAM(total, result, b);
+    OBJ_GUARD_NULL_PARAM(total, result, c);
+    OBJ_VALIDATE_OBJECT(total, result, object_check, obj);
+    OBJ_VALIDATE_OBJECT(total, result, object_check, obj + 1);
+    if (n < 0) return RETURN_OBJ_BAD_PARAM_FMT(total, result, n, "n=%d", n);
+
+    total.value = *a + *b + *c + obj[0].value + obj[1].value + n;
+    total.result = RESULT_SUCCESS;
+    return total;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(void) {
+    struct object objs[2] = { { .valid = 1, .value = 1 }, { .valid = 1, .value = 2 } };
+    int a = 1, b = 2, c = 3;
+    volatile int sink = 0;
+    double best = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now();
+        for (long i = 0; i < ITERATIONS; i++) sink = guarded(objs, &a, &b, &c, (int)(i & 7)).value;
+
+        double ns = (now() - start) * 1e9 / (double)ITERATIONS;
+        if (round == 0 || ns < best) best = ns;
+    }
+
+    (void)sink;
+    printf("seven passing guards and a range check: %.2f ns/call\n", best);
+    return 0;
+}
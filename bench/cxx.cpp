@@ -0,0 +1,102 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// cxx.cpp
+// ---------------------------------------------------------------------------------------------- //
+// Checks the C++ view of the headers: the predicates are [constexpr], and the error and guard
+// macros can be used in an inline function, a function template, and an ordinary function of the
+// same unit (which is what call-site descriptors used to break, see [lurk.h]). Each is called on
+// its failing and its passing path with errors enabled and disabled; the errors go to [/dev/null].
+// Prints ["ok"] and exits with 0, or names the first check that failed and exits with 1.
+//
+//     c++ -std=c++17 -O2 -pthread -Iinclude -o bench-cxx bench/cxx.cpp build/liblurk.a
+
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lurk.h"
+
+static_assert(is_success(RESULT_SUCCESS) && !is_success(RESULT_FAILURE), "is_success");
+static_assert(is_failure(RESULT_FAILURE) && !is_failure(RESULT_SUCCESS), "is_failure");
+static_assert(is_valid_object(RESULT_VALID_OBJECT), "is_valid_object");
+static_assert(is_error(RESULT_BAD_PARAM) && !is_error(RESULT_DONE), "is_error");
+static_assert(is_lurk_err(RESULT_INTERNAL_ERROR) && !is_lurk_err(-4), "is_lurk_err");
+static_assert(is_true(RESULT_TRUE) && is_false(RESULT_FALSE), "is_true and is_false");
+
+static int evaluated = 0;
+
+static int count(int value) {
+    evaluated++;
+    return value;
+}
+
+inline result_t inline_guard(const int* ptr) {
+    GUARD_NULL_PARAM(ptr);
+    if (*ptr < 0) return RETURN_BAD_PARAM_FMT(ptr, "Got %d.", count(*ptr));
+    return RESULT_SUCCESS;
+}
+
+template <typename T>
+result_t template_guard(const T* ptr) {
+    GUARD_NULL_PARAM(ptr);
+    if (*ptr < 0) return RETURN_BAD_PARAM_FMT(ptr, "Got %d.", count(static_cast<int>(*ptr)));
+    return RESULT_SUCCESS;
+}
+
+result_t plain_guard(const int* ptr) {
+    GUARD_NULL_PARAM(ptr);
+    if (*ptr < 0) return RETURN_BAD_PARAM_FMT(ptr, "Got %d.", count(*ptr));
+    return RESULT_SUCCESS;
+}
+
+static bool check(const char* what, bool ok) {
+    if (!ok) std::printf("failed: %s\n", what);
+    return ok;
+}
+
+// runs every function on its passing and failing paths, and returns whether they all returned what
+// they should and evaluated the arguments of their errors [expected] times in total
+static bool run(int expected) {
+    const int good = 1;
+    const int bad = -1;
+    const long bad_long = -1;
+    evaluated = 0;
+
+    return check("inline, null", inline_guard(nullptr) == RESULT_BAD_PARAM) &&
+           check("inline, bad", inline_guard(&bad) == RESULT_BAD_PARAM) &&
+           check("inline, good", inline_guard(&good) == RESULT_SUCCESS) &&
+           check("template, null", template_guard<long>(nullptr) == RESULT_BAD_PARAM) &&
+           check("template, bad", template_guard(&bad_long) == RESULT_BAD_PARAM) &&
+           check("template, good", template_guard(&good) == RESULT_SUCCESS) &&
+           check("plain, null", plain_guard(nullptr) == RESULT_BAD_PARAM) &&
+           check("plain, bad", plain_guard(&bad) == RESULT_BAD_PARAM) &&
+           check("plain, good", plain_guard(&good) == RESULT_SUCCESS) &&
+           check("arguments evaluated", evaluated == expected);
+}
+
+int main() {
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0 || dup2(null, STDERR_FILENO) < 0) return 1;
+    close(null);
+
+    if (!run(3)) return 1;
+
+    result_config_t config;
+    lurk_get_defaults(&config);
+    config.do_err = false;
+    lurk_set_result_config(&config);
+
+    // disabled errors must not evaluate their arguments
+    if (!run(0)) return 1;
+
+    lurk_set_result_config(nullptr);
+    std::printf("ok\n");
+    return 0;
+}
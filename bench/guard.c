@@ -0,0 +1,64 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// guard.c
+// ---------------------------------------------------------------------------------------------- //
+// Measures the passing path of the object guards. Since the result predicates are inline, each
+// [VALIDATE_OBJECT] in [guarded] should compile down to a compare and a branch, with the error
+// path moved out of line; check with [objdump -d bench-guard] and look at [guarded].
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-guard bench/guard.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "lurk.h"
+
+#define ITERATIONS 200000000L
+#define ROUNDS 5
+
+struct object {
+    int valid;
+};
+
+static inline result_t object_check(const struct object* obj) {
+    return obj->valid ? RESULT_VALID_OBJECT : RESULT_INVALID_OBJECT;
+}
+
+__attribute__((noinline)) result_t guarded(const struct object* obj) {
+    VALIDATE_OBJECT(object_check, obj);
+    VALIDATE_OBJECT(object_check, obj + 1);
+    return RESULT_SUCCESS;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(void) {
+    struct object objs[2] = { { .valid = 1 }, { .valid = 1 } };
+    volatile result_t sink = RESULT_SUCCESS;
+    double best = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now();
+        for (long i = 0; i < ITERATIONS; i++) sink = guarded(objs);
+
+        double ns = (now() - start) * 1e9 / (double)ITERATIONS;
+        if (round == 0 || ns < best) best = ns;
+    }
+
+    (void)sink;
+    printf("two passing VALIDATE_OBJECT guards: %.2f ns/call\n", best);
+    return 0;
+}
@@ -0,0 +1,102 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// hotpath.c
+// ---------------------------------------------------------------------------------------------- //
+// Measures the cost per call of a formatted [LURK_LOG_FMT] and [RETURN_ERROR_FMT], once with the
+// default config writing to [/dev/null], once with [.do_log] and [.do_err] turned off, and once
+// with them off while the flight recorder (see [recorder.h]) keeps every record in memory. Built
+// with [-DLURK_NO_CALL_RETURN_ERROR] (as [bench-hotpath-nocall] by [make bench]), the error macros
+// no longer call into the library at all, which is the floor the disabled mode is measured against.
+// Results go to the original [stdout]; the records themselves go to [/dev/null].
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-hotpath bench/hotpath.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+
+#define ENABLED_ITERATIONS 1000000L
+#define RECORDED_ITERATIONS 10000000L
+#define DISABLED_ITERATIONS 200000000L
+#define ROUNDS 5
+
+#ifdef LURK_NO_CALL_RETURN_ERROR
+#   define ERR_MODE "no-call"
+#else
+#   define ERR_MODE "call"
+#endif
+
+static FILE* report;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) static result_t log_op(long i) {
+    return LURK_LOG_FMT(RESULT_SUCCESS, "hot path record %ld", i);
+}
+
+__attribute__((noinline)) static result_t err_op(long i) {
+    (void)i; // unused when the macro does not call into the library
+    return RETURN_ERROR_FMT(RESULT_BAD_PARAM, "hot path error %ld", i);
+}
+
+static double measure(result_t (*op)(long), long iterations) {
+    volatile result_t sink = RESULT_SUCCESS;
+    double best = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now();
+        for (long i = 0; i < iterations; i++) sink = op(i);
+
+        double ns = (now() - start) * 1e9 / (double)iterations;
+        if (round == 0 || ns < best) best = ns;
+    }
+
+    (void)sink;
+    return best;
+}
+
+static void run(const char* mode, bool enabled, long iterations) {
+    result_config_t config;
+    lurk_get_defaults(&config);
+    config.do_log = enabled;
+    config.do_err = enabled;
+    lurk_set_result_config(&config);
+
+    fprintf(report, "%-9s lurk_log %8.2f ns/op   lurk_err (%s) %8.2f ns/op\n", mode,
+            measure(&log_op, iterations), ERR_MODE, measure(&err_op, iterations));
+    fflush(report);
+}
+
+int main(void) {
+    int out = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    if (out < 0 || null < 0 || (report = fdopen(out, "w")) == NULL) return 1;
+    if (dup2(null, STDOUT_FILENO) < 0 || dup2(null, STDERR_FILENO) < 0) return 1;
+    close(null);
+
+    run("enabled", true, ENABLED_ITERATIONS);
+    run("disabled", false, DISABLED_ITERATIONS);
+
+    if (!is_success(lurk_recorder_start("/dev/null", 0))) return 1;
+    run("recorded", false, RECORDED_ITERATIONS);
+    lurk_recorder_stop();
+
+    return 0;
+}
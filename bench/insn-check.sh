@@ -0,0 +1,129 @@
+#!/bin/sh
+# license
+# ---------------------------------------------------------------------------------------------- #
+# Copyright (c) 2023, Casey Walker
+# All rights reserved.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+#
+#
+# insn-check.sh
+# ---------------------------------------------------------------------------------------------- #
+# Runs [bench-insn], adds the size of the hot and cold parts of every function it measured, and
+# compares the lot to a baseline, e.g.
+#
+#     bench/insn-check.sh build/bench-insn bench/insn.baseline
+#     bench/insn-check.sh -u build/bench-insn bench/insn.baseline
+#
+# A value regresses when it grows by more than [-t] percent (5 by default) of its baseline and by
+# more than a small absolute slack (0 bytes, half an instruction, or 0.05 branch misses per call),
+# which keeps the tiny ones from failing over rounding. Regressed values are marked with a ["!"]
+# and make the script exit with 1, as does a function missing from the run; functions not in the
+# baseline yet are marked with a ["+"]. Counts printed as ["-"] in the current run (no PMU) are
+# skipped, so the sizes are still checked where the instructions cannot be counted. A count the
+# baseline lacks but the current run has is marked with a ["?"] and fails too, since a baseline
+# taken without a PMU could otherwise never catch a count regressing: take it again with [-u] on a
+# host with one. With [-u], the baseline is replaced by the current values instead.
+
+usage() {
+    echo "usage: $0 [-u] [-t percent] <bench-insn> <baseline>" >&2
+    exit 2
+}
+
+update=0
+threshold=5
+while getopts ut: opt; do
+    case $opt in
+        u) update=1 ;;
+        t) threshold=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 2 ] || usage
+
+bench=$1
+baseline=$2
+
+current=$("$bench") || exit 2
+sizes=$(nm --print-size --defined-only "$bench") || exit 2
+
+table=$(printf '%s\n#sizes\n%s\n' "$current" "$sizes" | awk '
+    function hex(s,    i, v) {
+        v = 0
+        for (i = 1; i <= length(s); i++) v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+        return v
+    }
+    $0 == "#sizes" { in_sizes = 1; next }
+    /^#/ { next }
+    !in_sizes {
+        order[++n] = $1
+        counts[$1] = $2 " " $3 " " $4 " " $5
+        next
+    }
+    $3 ~ /^[tT]$/ {
+        name = $4
+        size = hex(tolower($2))
+        if (name ~ /\.cold(\.[0-9]+)?$/) {
+            sub(/\.cold(\.[0-9]+)?$/, "", name)
+            cold[name] += size
+        } else {
+            hot[name] += size
+        }
+    }
+    END {
+        printf "# %-30s %6s %6s %10s %10s %10s %10s\n", "function", "hot", "cold",
+               "pass insns", "fail insns", "pass miss", "fail miss"
+        for (i = 1; i <= n; i++) {
+            split(counts[order[i]], c, " ")
+            printf "%-32s %6d %6d %10s %10s %10s %10s\n", order[i], hot[order[i]] + 0,
+                   cold[order[i]] + 0, c[1], c[2], c[3], c[4]
+        }
+    }')
+
+if [ $update -eq 1 ]; then
+    printf '%s\n' "$table" > "$baseline" || exit 2
+    printf '%s\n' "$table"
+    exit 0
+fi
+
+[ -r "$baseline" ] || { echo "$0: cannot read $baseline" >&2; exit 2; }
+
+printf '%s\n' "$table" | awk -v threshold="$threshold" '
+    BEGIN { split("0 0 0.5 0.5 0.05 0.05", slack, " ") }
+    /^#/ { if (NR != FNR) print; next }
+    NR == FNR {
+        for (i = 2; i <= 7; i++) base[$1, i] = $i
+        known[$1] = 1
+        next
+    }
+    {
+        line = sprintf("%-32s", $1)
+        for (i = 2; i <= 7; i++) {
+            mark = ""
+            if (!($1 in known)) {
+                mark = "+"
+            } else if ($i != "-" && base[$1, i] == "-") {
+                mark = "?"
+                missing++
+            } else if ($i != "-") {
+                limit = base[$1, i] + base[$1, i] * threshold / 100
+                if (limit < base[$1, i] + slack[i - 1]) limit = base[$1, i] + slack[i - 1]
+                if ($i + 0 > limit) { mark = "!"; failed++ }
+            }
+            line = line sprintf(" %*s", i <= 3 ? 6 : 10, $i mark)
+        }
+        print line
+        seen[$1] = 1
+    }
+    END {
+        for (name in known) {
+            if (name in seen) continue
+            printf "%-32s missing from the current run\n", name
+            failed++
+        }
+        if (failed) printf "# %d value(s) regressed past %s%% of the baseline\n", failed, threshold
+        if (missing) printf "# %d count(s) missing from the baseline, take it again with -u\n", missing
+        exit failed || missing ? 1 : 0
+    }' "$baseline" -
@@ -0,0 +1,237 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// insn.c
+// ---------------------------------------------------------------------------------------------- //
+// Counts the instructions retired and the branches mispredicted per call of a corpus of functions,
+// each built around one representative [RETURN_*], [GUARD_*], or [VALIDATE_*] expansion, on both
+// its passing and its failing path, with [perf_event_open] counting user space only. [corpus_plain]
+// is the same check written without lurk, as the reference the others are compared against.
+// Unlike wall-clock time, these counts are stable from run to run, so [bench/insn-check.sh] can
+// hold them (and the code size of every [corpus_*] function) to a baseline.
+//
+// Prints one line per function: its name, then the instructions on the passing and failing path,
+// then the branch misses on both, with ["-"] for the counts the kernel cannot provide (e.g. in a
+// virtual machine without a PMU). Error records go to [/dev/null].
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-insn bench/insn.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // syscall
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "lurk.h"
+
+#define CALLS 1000
+#define ROUNDS 5
+
+struct object {
+    int value;
+    const int* member;
+};
+
+static inline result_t object_check(const struct object* obj) {
+    return obj->value >= 0 ? RESULT_VALID_OBJECT : RESULT_INVALID_OBJECT;
+}
+
+static inline result_t member_check(const int* member) {
+    return *member >= 0 ? RESULT_VALID_OBJECT : RESULT_INVALID_OBJECT;
+}
+
+__attribute__((noinline)) static result_t corpus_inner(const struct object* obj) {
+    return obj->value >= 0 ? RESULT_SUCCESS : RESULT_BAD_PARAM;
+}
+
+
+// The corpus. Every function is [noinline] and external so the compiler keeps it whole and its
+// symbol (and that of its [.cold] part) shows up in the symbol table.
+// ---------------------------------------------------------------------------------------------- //
+__attribute__((noinline)) result_t corpus_empty(const struct object* obj) {
+    (void)obj;
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_plain(const struct object* obj) {
+    if (obj == NULL || obj->value < 0) return RESULT_BAD_PARAM;
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_guard_null_param(const struct object* obj) {
+    GUARD_NULL_PARAM(obj);
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_guard_valid_object(const struct object* obj) {
+    GUARD_VALID_OBJECT(object_check, obj);
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_validate_object(const struct object* obj) {
+    VALIDATE_OBJECT(object_check, obj);
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_validate_object_member(const struct object* obj) {
+    VALIDATE_OBJECT_MEMBER(member_check, obj, obj->member);
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_return_bad_param(const struct object* obj) {
+    if (obj->value < 0) return RETURN_BAD_PARAM(obj->value);
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_return_error_fmt(const struct object* obj) {
+    if (obj->value < 0) return RETURN_ERROR_FMT(RESULT_BAD_PARAM, "value %d", obj->value);
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_return_pass_error(const struct object* obj) {
+    result_t result = corpus_inner(obj);
+    if (is_error(result)) return RETURN_PASS_ERROR(RESULT_INTERNAL_ERROR, result);
+    return RESULT_SUCCESS;
+}
+
+__attribute__((noinline)) result_t corpus_return_trace_error(const struct object* obj) {
+    result_t result = corpus_inner(obj);
+    if (is_error(result)) return RETURN_TRACE_ERROR(result);
+    return RESULT_SUCCESS;
+}
+
+
+// Counting.
+// ---------------------------------------------------------------------------------------------- //
+static const int good_member = 1;
+static const int bad_member = -1;
+static const struct object good = { .value = 1, .member = &good_member };
+static const struct object bad_value = { .value = -1, .member = &good_member };
+static const struct object bad_member_object = { .value = 1, .member = &bad_member };
+
+struct site {
+    const char* name;
+    result_t (*fn)(const struct object*);
+    const struct object* fail;
+};
+
+static const struct site sites[] = {
+    { "corpus_empty", &corpus_empty, &bad_value },
+    { "corpus_plain", &corpus_plain, &bad_value },
+    { "corpus_guard_null_param", &corpus_guard_null_param, NULL },
+    { "corpus_guard_valid_object", &corpus_guard_valid_object, &bad_value },
+    { "corpus_validate_object", &corpus_validate_object, &bad_value },
+    { "corpus_validate_object_member", &corpus_validate_object_member, &bad_member_object },
+    { "corpus_return_bad_param", &corpus_return_bad_param, &bad_value },
+    { "corpus_return_error_fmt", &corpus_return_error_fmt, &bad_value },
+    { "corpus_return_pass_error", &corpus_return_pass_error, &bad_value },
+    { "corpus_return_trace_error", &corpus_return_trace_error, &bad_value },
+};
+
+struct counts {
+    bool valid;
+    double instructions;
+    double misses;
+};
+
+// the instruction counter leads a group with the branch-miss counter, so both are read at once
+static int leader = -1;
+
+static int open_counter(uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static bool open_counters(void) {
+    leader = open_counter(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if (leader < 0) return false;
+
+    if (open_counter(PERF_COUNT_HW_BRANCH_MISSES, leader) < 0) {
+        close(leader);
+        leader = -1;
+        return false;
+    }
+
+    return true;
+}
+
+// the fewest counts seen over [ROUNDS] runs of [CALLS] calls, per call, including the loop
+static struct counts count(result_t (*fn)(const struct object*), const struct object* obj) {
+    struct counts best = { .valid = false };
+    if (leader < 0) return best;
+
+    volatile result_t sink = RESULT_SUCCESS;
+    for (int i = 0; i < CALLS; i++) sink = fn(obj); // warms up the caches and the predictors
+
+    for (int round = 0; round < ROUNDS; round++) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        for (int i = 0; i < CALLS; i++) sink = fn(obj);
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        uint64_t values[3]; // the number of counters, then their values
+        if (read(leader, values, sizeof(values)) != (ssize_t)sizeof(values)) return best;
+
+        double instructions = (double)values[1] / CALLS;
+        double misses = (double)values[2] / CALLS;
+        if (!best.valid || instructions < best.instructions) best.instructions = instructions;
+        if (!best.valid || misses < best.misses) best.misses = misses;
+        best.valid = true;
+    }
+
+    (void)sink;
+    return best;
+}
+
+static void print_count(double value, bool valid) {
+    if (valid) printf("  %10.1f", value < 0 ? 0 : value);
+    else printf("  %10s", "-");
+}
+
+int main(void) {
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0 || dup2(null, STDERR_FILENO) < 0) return 1;
+    close(null);
+
+    bool counting = open_counters();
+
+    // the loop and the call itself, measured with [corpus_empty], are taken off every count
+    struct counts empty = count(&corpus_empty, &good);
+
+    printf("# %-29s  %10s  %10s  %10s  %10s\n",
+           "function", "pass insns", "fail insns", "pass miss", "fail miss");
+    for (size_t i = 0; i < sizeof(sites) / sizeof(sites[0]); i++) {
+        struct counts pass = count(sites[i].fn, &good);
+        struct counts fail = count(sites[i].fn, sites[i].fail);
+
+        printf("%-31s", sites[i].name);
+        print_count(pass.instructions - empty.instructions, pass.valid);
+        print_count(fail.instructions - empty.instructions, fail.valid);
+        print_count(pass.misses, pass.valid);
+        print_count(fail.misses, fail.valid);
+        printf("\n");
+    }
+
+    if (!counting) fprintf(stdout, "# hardware counters unavailable; instructions not counted\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// load.c
+// ---------------------------------------------------------------------------------------------- //
+// Generates load on the default sink from 1, 2, 4, ... up to [max_threads] threads at once, each
+// making [CALLS] calls that alternate between [LURK_LOG_FMT] and [RETURN_ERROR_FMT], and reports
+// the p50, p99, and p99.9 latency of a single call and the total throughput. The whole sweep runs
+// three times, with [stdout] and [stderr] redirected to [/dev/null], to a file, and to a pipe
+// drained by a child process. Latencies include one [clock_gettime] each.
+//
+//     bench-load [max_threads] [file]     (8 and [bench-load.log] by default)
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-load bench/load.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+
+#define CALLS 50000
+
+struct worker {
+    pthread_t thread;
+    pthread_barrier_t* start;
+    uint32_t* lat;
+};
+
+static FILE* report;
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int compare(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void* work(void* arg) {
+    struct worker* w = arg;
+
+    pthread_barrier_wait(w->start);
+
+    for (long i = 0; i < CALLS; i++) {
+        uint64_t start = now();
+        if (i % 2 == 0) LURK_LOG_FMT(RESULT_SUCCESS, "load record %ld", i);
+        else RETURN_ERROR_FMT(RESULT_BAD_PARAM, "load error %ld", i);
+
+        uint64_t ns = now() - start;
+        w->lat[i] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    }
+
+    return NULL;
+}
+
+static void run(const char* sink, int threads, uint32_t* lat) {
+    struct worker* workers = calloc((size_t)threads, sizeof(*workers));
+    if (workers == NULL) exit(1);
+
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)threads + 1);
+
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (struct worker){ .start = &start, .lat = lat + (size_t)t * CALLS };
+        if (pthread_create(&workers[t].thread, NULL, &work, &workers[t]) != 0) exit(1);
+    }
+
+    pthread_barrier_wait(&start);
+    uint64_t begin = now();
+    for (int t = 0; t < threads; t++) pthread_join(workers[t].thread, NULL);
+    uint64_t elapsed = now() - begin;
+
+    pthread_barrier_destroy(&start);
+    free(workers);
+
+    size_t n = (size_t)threads * CALLS;
+    qsort(lat, n, sizeof(*lat), &compare);
+    fprintf(report, "%-9s %3d threads  p50 %6u ns  p99 %7u ns  p99.9 %8u ns  %6.3f M calls/s\n",
+            sink, threads, lat[n / 2], lat[n / 100 * 99], lat[n / 1000 * 999],
+            (double)n / ((double)elapsed / 1e3));
+    fflush(report);
+}
+
+static void sweep(const char* sink, int fd, int max_threads, uint32_t* lat) {
+    if (dup2(fd, STDOUT_FILENO) < 0 || dup2(fd, STDERR_FILENO) < 0) exit(1);
+    close(fd);
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) run(sink, threads, lat);
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    const char* path = argc > 2 ? argv[2] : "bench-load.log";
+    if (max_threads < 1) return 1;
+
+    int out = dup(STDOUT_FILENO);
+    if (out < 0 || (report = fdopen(out, "w")) == NULL) return 1;
+
+    uint32_t* lat = malloc((size_t)max_threads * CALLS * sizeof(*lat));
+    if (lat == NULL) return 1;
+
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0) return 1;
+    sweep("/dev/null", null, max_threads, lat);
+
+    int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) return 1;
+    sweep("file", file, max_threads, lat);
+
+    int fds[2];
+    if (pipe(fds) != 0) return 1;
+
+    pid_t drain = fork();
+    if (drain < 0) return 1;
+    if (drain == 0) {
+        close(fds[1]);
+        char buf[65536];
+        while (read(fds[0], buf, sizeof(buf)) > 0);
+        _exit(0);
+    }
+
+    close(fds[0]);
+    sweep("pipe", fds[1], max_threads, lat);
+
+    // the child sees the end of the pipe once no descriptor refers to it any more
+    int null_again = open("/dev/null", O_WRONLY);
+    if (null_again < 0) return 1;
+    dup2(null_again, STDOUT_FILENO);
+    dup2(null_again, STDERR_FILENO);
+    close(null_again);
+    waitpid(drain, NULL, 0);
+
+    free(lat);
+    return 0;
+}
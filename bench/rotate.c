@@ -0,0 +1,84 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// rotate.c
+// ---------------------------------------------------------------------------------------------- //
+// Measures how long a producer waits on the rotating file sink, once with segments large enough to
+// never rotate and once rotating every [SMALL_SEGMENT] bytes with a retention budget, so files are
+// created, truncated, and deleted throughout. If rotation stays off the producer's path, the tail
+// of the latency distribution should look the same in both runs. The segments are written to the
+// directory given as the only argument (the current one by default).
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-rotate bench/rotate.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lurk.h"
+
+#define RECORDS 500000
+#define SMALL_SEGMENT (256 * 1024)
+#define LARGE_SEGMENT ((size_t)1 << 30)
+#define BUDGET (4 * 1024 * 1024)
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char* name, const char* path, size_t segment, uint64_t* lat) {
+    if (lurk_rotate_start(path, segment, 0, BUDGET) != RESULT_SUCCESS) exit(1);
+
+    size_t before = lurk_rotate_rotations();
+    for (long i = 0; i < RECORDS; i++) {
+        uint64_t start = now();
+        LURK_LOG_FMT(RESULT_SUCCESS, "record %ld of the rotation benchmark", i);
+        lat[i] = now() - start;
+    }
+    size_t rotations = lurk_rotate_rotations() - before;
+
+    lurk_rotate_stop();
+
+    qsort(lat, RECORDS, sizeof(*lat), &compare);
+    printf("%-10s %6zu rotations  p50 %6llu ns  p99 %6llu ns  p99.9 %7llu ns  max %8llu ns\n",
+           name, rotations,
+           (unsigned long long)lat[RECORDS / 2],
+           (unsigned long long)lat[RECORDS / 100 * 99],
+           (unsigned long long)lat[RECORDS / 1000 * 999],
+           (unsigned long long)lat[RECORDS - 1]);
+}
+
+int main(int argc, char** argv) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/bench-rotate.log", argc > 1 ? argv[1] : ".");
+
+    result_config_t config;
+    lurk_get_defaults(&config);
+    config.log_fn = &lurk_rotate_log;
+    lurk_set_result_config(&config);
+
+    uint64_t* lat = malloc(RECORDS * sizeof(*lat));
+    if (lat == NULL) return 1;
+
+    run("steady", path, LARGE_SEGMENT, lat);
+    run("rotating", path, SMALL_SEGMENT, lat);
+
+    free(lat);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+# license
+# ---------------------------------------------------------------------------------------------- #
+# Copyright (c) 2023, Casey Walker
+# All rights reserved.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+#
+#
+# size-report.sh
+# ---------------------------------------------------------------------------------------------- #
+# Prints the size of the hot and cold parts of every function in an object or executable, e.g.
+#
+#     bench/size-report.sh bench-cold guarded
+#
+# The hot part is the function itself; the cold part is the [<name>.cold] block the compiler split
+# off into [.text.unlikely]. Without any names, every function that has a cold part is listed.
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <object> [function...]" >&2
+    exit 1
+fi
+
+object=$1
+shift
+
+nm --print-size --defined-only "$object" | awk -v names="$*" '
+    function hex(s,    i, v) {
+        v = 0
+        for (i = 1; i <= length(s); i++) v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+        return v
+    }
+    BEGIN {
+        n = split(names, list, " ")
+        for (i = 1; i <= n; i++) wanted[list[i]] = 1
+    }
+    $3 ~ /^[tT]$/ {
+        name = $4
+        size = hex(tolower($2))
+        if (name ~ /\.cold(\.[0-9]+)?$/) {
+            sub(/\.cold(\.[0-9]+)?$/, "", name)
+            cold[name] += size
+        } else {
+            hot[name] += size
+        }
+        seen[name] = 1
+    }
+    END {
+        printf "%-32s %8s %8s\n", "function", "hot", "cold"
+        for (name in seen) {
+            if (n > 0 ? !(name in wanted) : !(name in cold)) continue
+            printf "%-32s %8d %8d\n", name, hot[name], cold[name]
+        }
+    }'
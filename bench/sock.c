@@ -0,0 +1,176 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// sock.c
+// ---------------------------------------------------------------------------------------------- //
+// Measures the socket sink (see [sock.h]) over a Unix-domain socket and over TCP on the loopback
+// against the default error function writing to [stderr] redirected into a pipe. In each run, a
+// thread on the receiving end reads and counts the records as a collector would. The main thread
+// raises [BURSTS] bursts of [BURST] errors, each small enough for the ring, and waits for every
+// burst to be received before the next. It reports the producer's time per record, the throughput
+// from the first record raised to the last one received, and the records dropped (which should be
+// none).
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-sock bench/sock.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+
+#define BURSTS 64
+#define BURST 16384
+#define CAPACITY 32768
+
+static atomic_size_t received = 0;
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// counts the records arriving on [fd] until it is closed
+static void* receive(void* arg) {
+    int fd = *(int*)arg;
+    char buf[65536];
+
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        size_t lines = 0;
+        for (const char* p = buf; (p = memchr(p, '\n', (size_t)(buf + n - p))) != NULL; p++)
+            lines++;
+        atomic_fetch_add(&received, lines);
+    }
+
+    close(fd);
+    return NULL;
+}
+
+// accepts the one connection of the socket sink on the listening socket [fd], then receives
+static void* accept_and_receive(void* arg) {
+    int listener = *(int*)arg;
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) exit(1);
+
+    return receive(&fd);
+}
+
+// raises the errors of a run and waits for each burst, returning the producer's time in total
+static uint64_t produce(bool sock, uint64_t* elapsed) {
+    size_t dropped = lurk_sock_dropped();
+    uint64_t produced = 0;
+    uint64_t start = now();
+
+    for (long burst = 0; burst < BURSTS; burst++) {
+        uint64_t begin = now();
+        for (long i = 0; i < BURST; i++)
+            RETURN_ERROR_FMT(RESULT_FAILURE, "record %ld of the socket sink benchmark", i);
+        produced += now() - begin;
+
+        if (sock) lurk_sock_flush();
+
+        size_t expected = (size_t)(burst + 1) * BURST - (lurk_sock_dropped() - dropped);
+        while (atomic_load(&received) < expected) sched_yield();
+    }
+
+    *elapsed = now() - start;
+    return produced;
+}
+
+static void report(const char* name, uint64_t produced, uint64_t elapsed, size_t dropped) {
+    double records = (double)BURSTS * BURST;
+    printf("%-8s %6.1f ns/record produced  %5.2f M records/s received  %zu dropped\n",
+           name, (double)produced / records, records / ((double)elapsed / 1e3), dropped);
+}
+
+static void run_pipe(void) {
+    int p[2];
+    int saved = dup(STDERR_FILENO);
+    if (saved < 0 || pipe(p) != 0 || dup2(p[1], STDERR_FILENO) < 0) exit(1);
+    close(p[1]);
+
+    atomic_store(&received, 0);
+    pthread_t receiver;
+    if (pthread_create(&receiver, NULL, &receive, &p[0]) != 0) exit(1);
+
+    uint64_t elapsed;
+    uint64_t produced = produce(false, &elapsed);
+
+    // closing the last write end lets the receiver see the end of the pipe
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+    pthread_join(receiver, NULL);
+
+    report("pipe", produced, elapsed, 0);
+}
+
+static void run_sock(const char* name, int listener, const char* address) {
+    atomic_store(&received, 0);
+    pthread_t receiver;
+    if (pthread_create(&receiver, NULL, &accept_and_receive, &listener) != 0) exit(1);
+
+    result_config_t config;
+    lurk_get_defaults(&config);
+    config.err_fn = &lurk_sock_err;
+    lurk_set_result_config(&config);
+    if (lurk_sock_start(address, CAPACITY) != RESULT_SUCCESS) exit(1);
+
+    size_t dropped = lurk_sock_dropped();
+    uint64_t elapsed;
+    uint64_t produced = produce(true, &elapsed);
+    dropped = lurk_sock_dropped() - dropped;
+
+    lurk_sock_stop();
+    lurk_set_result_config(NULL);
+    pthread_join(receiver, NULL);
+    close(listener);
+
+    report(name, produced, elapsed, dropped);
+}
+
+int main(void) {
+    run_pipe();
+
+    struct sockaddr_un un = { .sun_family = AF_UNIX };
+    snprintf(un.sun_path, sizeof(un.sun_path), "/tmp/lurk-bench-sock-%ld", (long)getpid());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&un, sizeof(un)) != 0 ||
+        listen(listener, 1) != 0)
+        exit(1);
+
+    char address[128];
+    snprintf(address, sizeof(address), "unix:%s", un.sun_path);
+    run_sock("unix", listener, address);
+    unlink(un.sun_path);
+
+    // an ephemeral port on the loopback
+    struct sockaddr_in in = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(in);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&in, sizeof(in)) != 0 ||
+        listen(listener, 1) != 0 || getsockname(listener, (struct sockaddr*)&in, &len) != 0)
+        exit(1);
+
+    snprintf(address, sizeof(address), "tcp:127.0.0.1:%u", (unsigned)ntohs(in.sin_port));
+    run_sock("tcp", listener, address);
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// write.c
+// ---------------------------------------------------------------------------------------------- //
+// Compares the default error function, which renders a record and hands it to a single [write],
+// with the one it replaced, which made three calls on the unbuffered [stderr] stream (a [fprintf]
+// of the header, a [vfprintf] of the message, and a [fprintf] of the postfix) and so three writes
+// that other threads could interleave with. Both run from 1, 2, and 4 threads at once, each making
+// [CALLS] calls to [RETURN_ERROR_FMT] with [stderr] redirected to [/dev/null], and the best of
+// [ROUNDS] is reported in ns per record.
+//
+//     cc -std=c11 -O2 -pthread -Iinclude -o bench-write bench/write.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+
+#define CALLS 200000
+#define ROUNDS 3
+
+// the default error function as it was before it wrote each record with a single [write]
+static void err_stdio(result_t result, const char* caller, const char* loc, const char* fmt,
+                      va_list args) {
+    if (fmt == NULL) return;
+    if (caller == NULL) caller = "(unknown)";
+    if (loc == NULL) loc = "???";
+
+    time_t traw = time(NULL);
+    struct tm t = {0};
+    gmtime_r(&traw, &t);
+
+    int n = fprintf(stderr, "%02d:%02d:%02d  %08x  [%s:%s.%s]  %s",
+                    t.tm_hour, t.tm_min, t.tm_sec, result, "lurk", caller, loc, "");
+    if (n < 0) abort();
+
+    n = vfprintf(stderr, fmt, args);
+    if (n < 0) abort();
+
+    n = fprintf(stderr, "%s", "\n");
+    if (n < 0) abort();
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void* work(void* arg) {
+    pthread_barrier_t* start = arg;
+    pthread_barrier_wait(start);
+
+    for (long i = 0; i < CALLS; i++) RETURN_ERROR_FMT(RESULT_BAD_PARAM, "write record %ld", i);
+    return NULL;
+}
+
+// returns the best time of [ROUNDS] in ns per record with [threads] threads
+static double run(int threads) {
+    pthread_t workers[4];
+    double best = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        pthread_barrier_t start;
+        pthread_barrier_init(&start, NULL, (unsigned)threads + 1);
+
+        for (int t = 0; t < threads; t++) {
+            if (pthread_create(&workers[t], NULL, &work, &start) != 0) exit(1);
+        }
+
+        pthread_barrier_wait(&start);
+        double begin = now();
+        for (int t = 0; t < threads; t++) pthread_join(workers[t], NULL);
+
+        double ns = (now() - begin) * 1e9 / ((double)threads * CALLS);
+        if (round == 0 || ns < best) best = ns;
+        pthread_barrier_destroy(&start);
+    }
+
+    return best;
+}
+
+int main(void) {
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0 || dup2(null, STDERR_FILENO) < 0) return 1;
+    close(null);
+    setvbuf(stderr, NULL, _IONBF, 0);
+
+    result_config_t config;
+    lurk_get_defaults(&config);
+    config.err_fn = &err_stdio;
+
+    for (int threads = 1; threads <= 4; threads *= 2) {
+        lurk_set_result_config(&config);
+        double before = run(threads);
+
+        lurk_set_result_config(NULL);
+        double after = run(threads);
+
+        printf("%d threads  three stdio calls %7.1f ns/record  single write %7.1f ns/record\n",
+               threads, before, after);
+    }
+
+    return 0;
+}
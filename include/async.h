@@ -0,0 +1,127 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// async.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the interface for the optional asynchronous logging mode. When it is running,
+// the default log and error functions no longer write on the calling thread; instead they render
+// each record into a slot of a bounded, lock-free ring and a single background writer thread drains
+// the ring to [stdout] and [stderr]. Custom [result_log_fn] and [result_err_fn] functions are not
+// affected by this mode.
+//
+// On Linux, the writer submits each batch through io_uring as a single write, with the ring
+// registered as a fixed buffer, and gathers the next batch while the kernel writes the current
+// one; a batch's slots go back to the producers when its write completes.
+// Where io_uring is unavailable (an older kernel, or a sandbox that forbids it), or when built with
+// [LURK_NO_IO_URING], the writer falls back to one [writev] per batch.
+// Either way, the writer writes to the descriptor numbers [1] and [2], which are looked up again
+// for every batch, so redirecting [stdout] or [stderr] with [dup2] or [freopen] after
+// [lurk_async_start] is followed: records still queued at that point, and any after them, go to
+// the new target, while the batch in flight goes to the old one.
+
+
+#ifndef LURK_ASYNC_H
+#define LURK_ASYNC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Records larger than [LURK_ASYNC_RECORD_SIZE] (including the time, result, tag, prefix, and
+// postfix) are truncated to fit, always keeping the postfix. [LURK_ASYNC_DEFAULT_CAPACITY] is the
+// number of records the ring holds when no capacity is given to [lurk_async_start].
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_ASYNC_RECORD_SIZE
+#   define LURK_ASYNC_RECORD_SIZE 512
+#endif
+
+#ifndef LURK_ASYNC_DEFAULT_CAPACITY
+#   define LURK_ASYNC_DEFAULT_CAPACITY 4096
+#endif
+
+
+// [lurk_async_start]
+//  * allocates the record ring and starts the background writer thread
+//  * the first successful call also registers an [atexit] handler that drains and stops the writer,
+//    and [pthread_atfork] handlers so that a forked child starts out in synchronous mode with an
+//    empty ring (records pending at the time of the fork are written only by the parent)
+//  == Parameters ==
+//      [capacity]
+//          * the number of records the ring can hold; must be a power of two, or [0] to use
+//            [LURK_ASYNC_DEFAULT_CAPACITY]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the writer was started
+//      [RESULT_FAILURE]
+//          * if the asynchronous mode was already running
+//      [RESULT_BAD_PARAM]
+//          * if [capacity] is not a power of two
+//      [RESULT_INTERNAL_ERROR]
+//          * if the ring could not be allocated or the writer thread could not be created
+// [lurk_async_stop]
+//  * drains every record already in the ring, then stops and joins the writer thread; records
+//    produced afterwards are written synchronously again
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the writer was stopped
+//      [RESULT_FAILURE]
+//          * if the asynchronous mode was not running
+// [lurk_async_flush]
+//  * blocks until every record pushed before the call has been handed to the output
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the ring was flushed
+//      [RESULT_FAILURE]
+//          * if the asynchronous mode was not running
+// [lurk_async_running]
+//  * determines whether the asynchronous mode is currently running
+//  ==   Return   ==
+//      [true]
+//          * if the writer thread is running
+//      [false]
+//          * otherwise
+// [lurk_async_set_io_uring]
+//  * chooses whether the writer submits through io_uring where it is available (the default) or
+//    always uses [writev]; takes effect at the next [lurk_async_start]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the choice was recorded
+//      [RESULT_FAILURE]
+//          * if the asynchronous mode is running
+// [lurk_async_io_uring]
+//  * determines whether the running writer submits through io_uring
+//  ==   Return   ==
+//      [true]
+//          * if the asynchronous mode is running on io_uring
+//      [false]
+//          * if it is not running, or uses [writev]
+// [lurk_async_dropped]
+//  * the number of records dropped because the ring was full since the process started
+//  * producers never wait for space; the writer also reports drops on [stderr] as they happen
+//  ==   Return   ==
+//      * the total count of dropped records
+result_t lurk_async_start(size_t capacity);
+result_t lurk_async_stop(void);
+result_t lurk_async_flush(void);
+bool lurk_async_running(void);
+result_t lurk_async_set_io_uring(bool enabled);
+bool lurk_async_io_uring(void);
+size_t lurk_async_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_ASYNC_H
@@ -0,0 +1,254 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// binlog.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the deferred-formatting binary log mode. Instead of running the format string
+// through printf on every error, the error macros capture their arguments with their types and the
+// library stores only a call-site identifier, a timestamp, the result, and the raw argument bytes.
+// The [lurk-decode] tool (see [tools/lurk-decode.c]) renders a binary log back into the usual text
+// format offline.
+//
+// The macros only capture typed arguments when [LURK_BINARY_LOG] is defined before including lurk
+// (ideally for the whole program, e.g. with [-DLURK_BINARY_LOG]). While no binary log is started,
+// typed errors are formatted as text and passed on to the active [result_err_fn] as usual.
+
+
+#ifndef LURK_BINLOG_H
+#define LURK_BINLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Arguments are captured with [_Generic] into [struct lurk_arg]. Integers are widened to 64 bits,
+// floating point values to [double], and character pointers are copied as strings when the record
+// is stored (any other pointer is stored as its address). Arguments of any other type, such as
+// structs, are rejected at compile time.
+// ---------------------------------------------------------------------------------------------- //
+// [enum lurk_arg_type]
+//  [LURK_ARG_INT], [LURK_ARG_UINT]
+//      * signed and unsigned integers of any width, including [bool] and [char]
+//  [LURK_ARG_DOUBLE]
+//      * [float], [double], and [long double] (narrowed to [double])
+//  [LURK_ARG_STR]
+//      * [char*] and [const char*]; a [NULL] string is stored as ["(null)"]
+//  [LURK_ARG_PTR]
+//      * any other pointer
+enum lurk_arg_type {
+    LURK_ARG_INT    = 1,
+    LURK_ARG_UINT   = 2,
+    LURK_ARG_DOUBLE = 3,
+    LURK_ARG_STR    = 4,
+    LURK_ARG_PTR    = 5,
+};
+
+struct lurk_arg {
+    enum lurk_arg_type type;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const char* s;
+        const void* p;
+    };
+};
+
+static inline struct lurk_arg lurk_arg_int(long long i) {
+    return (struct lurk_arg){ .type = LURK_ARG_INT, .i = i };
+}
+
+static inline struct lurk_arg lurk_arg_uint(unsigned long long u) {
+    return (struct lurk_arg){ .type = LURK_ARG_UINT, .u = u };
+}
+
+static inline struct lurk_arg lurk_arg_double(long double d) {
+    return (struct lurk_arg){ .type = LURK_ARG_DOUBLE, .d = (double)d };
+}
+
+static inline struct lurk_arg lurk_arg_str(const char* s) {
+    return (struct lurk_arg){ .type = LURK_ARG_STR, .s = s };
+}
+
+static inline struct lurk_arg lurk_arg_ptr(const void* p) {
+    return (struct lurk_arg){ .type = LURK_ARG_PTR, .p = p };
+}
+
+#define LURK_ARG(x)                                                                                \
+    _Generic((x),                                                                                  \
+        _Bool: lurk_arg_uint,                                                                      \
+        char: lurk_arg_int,                                                                        \
+        signed char: lurk_arg_int,                                                                 \
+        unsigned char: lurk_arg_uint,                                                              \
+        short: lurk_arg_int,                                                                       \
+        unsigned short: lurk_arg_uint,                                                             \
+        int: lurk_arg_int,                                                                         \
+        unsigned int: lurk_arg_uint,                                                               \
+        long: lurk_arg_int,                                                                        \
+        unsigned long: lurk_arg_uint,                                                              \
+        long long: lurk_arg_int,                                                                   \
+        unsigned long long: lurk_arg_uint,                                                         \
+        float: lurk_arg_double,                                                                    \
+        double: lurk_arg_double,                                                                   \
+        long double: lurk_arg_double,                                                              \
+        char*: lurk_arg_str,                                                                       \
+        const char*: lurk_arg_str,                                                                 \
+        default: lurk_arg_ptr)(x)
+
+// [LURK_ARGS] expands to the argument count followed by a compound literal array of captured
+// arguments, for up to [LURK_ARGS_MAX] arguments
+#define LURK_ARGS_MAX 16
+
+#define LURK_NARGS(...)                                                                            \
+    LURK_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LURK_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, n, ...) n
+
+#define LURK_CAT(a, b) LURK_CAT_(a, b)
+#define LURK_CAT_(a, b) a##b
+
+#define LURK_MAP(m, ...) LURK_CAT(LURK_MAP_, LURK_NARGS(__VA_ARGS__))(m, __VA_ARGS__)
+#define LURK_MAP_1(m, x) m(x)
+#define LURK_MAP_2(m, x, ...) m(x), LURK_MAP_1(m, __VA_ARGS__)
+#define LURK_MAP_3(m, x, ...) m(x), LURK_MAP_2(m, __VA_ARGS__)
+#define LURK_MAP_4(m, x, ...) m(x), LURK_MAP_3(m, __VA_ARGS__)
+#define LURK_MAP_5(m, x, ...) m(x), LURK_MAP_4(m, __VA_ARGS__)
+#define LURK_MAP_6(m, x, ...) m(x), LURK_MAP_5(m, __VA_ARGS__)
+#define LURK_MAP_7(m, x, ...) m(x), LURK_MAP_6(m, __VA_ARGS__)
+#define LURK_MAP_8(m, x, ...) m(x), LURK_MAP_7(m, __VA_ARGS__)
+#define LURK_MAP_9(m, x, ...) m(x), LURK_MAP_8(m, __VA_ARGS__)
+#define LURK_MAP_10(m, x, ...) m(x), LURK_MAP_9(m, __VA_ARGS__)
+#define LURK_MAP_11(m, x, ...) m(x), LURK_MAP_10(m, __VA_ARGS__)
+#define LURK_MAP_12(m, x, ...) m(x), LURK_MAP_11(m, __VA_ARGS__)
+#define LURK_MAP_13(m, x, ...) m(x), LURK_MAP_12(m, __VA_ARGS__)
+#define LURK_MAP_14(m, x, ...) m(x), LURK_MAP_13(m, __VA_ARGS__)
+#define LURK_MAP_15(m, x, ...) m(x), LURK_MAP_14(m, __VA_ARGS__)
+#define LURK_MAP_16(m, x, ...) m(x), LURK_MAP_15(m, __VA_ARGS__)
+
+#define LURK_ARGS(...)                                                                             \
+    LURK_NARGS(__VA_ARGS__), (const struct lurk_arg[]){ LURK_MAP(LURK_ARG, __VA_ARGS__) }
+
+
+// A binary log is a sequence of records, each starting with its total size as a [uint16_t] and a
+// [uint8_t] record kind. All integers are stored in the byte order of the producing machine, which
+// the stream header records so that a decoder can reject a foreign stream. Strings are stored as a
+// [uint16_t] length followed by the bytes, without a nul.
+// ---------------------------------------------------------------------------------------------- //
+//  [LURK_BINLOG_HEADER]
+//      * written by every [lurk_binlog_start]
+//      * the 8 byte magic ["LURKBIN1"], the [uint32_t] [LURK_BINLOG_BYTE_ORDER] mark, then the
+//        project name, prefix, and postfix strings of the active config
+//  [LURK_BINLOG_SITE]
+//      * written once per call site (and log) before its first event
+//      * a [uint32_t] site identifier, then the caller, location, and format strings
+//  [LURK_BINLOG_EVENT]
+//      * a [uint32_t] site identifier, an [int32_t] result, a [uint64_t] stamp (see
+//        [lurk_stamp]), a [uint8_t] argument count, and then each argument as a [uint8_t]
+//        [enum lurk_arg_type] followed by 8 bytes (integers, doubles, and pointers) or a string
+//  [LURK_BINLOG_INLINE_EVENT]
+//      * used when the call site table is full; like an event, but the site identifier is
+//        replaced by the caller, location, and format strings
+//  [LURK_BINLOG_INLINE_LOG]
+//      * a logged record rather than an error, as kept by the flight recorder (see [recorder.h]);
+//        like an inline event, but without the caller and location strings
+//  [LURK_BINLOG_CLOCK]
+//      * written before the first event stamped with the TSC and whenever the TSC is recalibrated
+//      * the [uint64_t] [.tsc], [.ns], and [.mult] and the [uint32_t] [.shift] of a
+//        [struct lurk_tsc_calibration], which converts the TSC stamps of the events after it
+#define LURK_BINLOG_MAGIC "LURKBIN1"
+#define LURK_BINLOG_BYTE_ORDER 0x01020304u
+
+enum lurk_binlog_kind {
+    LURK_BINLOG_HEADER       = 0,
+    LURK_BINLOG_SITE         = 1,
+    LURK_BINLOG_EVENT        = 2,
+    LURK_BINLOG_INLINE_EVENT = 3,
+    LURK_BINLOG_CLOCK        = 4,
+    LURK_BINLOG_INLINE_LOG   = 5,
+};
+
+// [LURK_BINLOG_SITES] is the size of the table that assigns identifiers to call sites; sites past
+// it are logged as inline events
+#ifndef LURK_BINLOG_SITES
+#   define LURK_BINLOG_SITES 4096
+#endif
+
+
+// [lurk_binlog_start]
+//  * starts writing typed errors to [fd] as binary records, beginning with a stream header
+//  * records are handed to the asynchronous writer when it is running (see [async.h]), so the
+//    calling thread only encodes and copies the record; otherwise each record is written directly
+//  * the file descriptor stays owned by the caller and must stay open until [lurk_binlog_stop]
+//  == Parameters ==
+//      [fd]
+//          * the file descriptor to write to; must not be negative
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the binary log was started
+//      [RESULT_FAILURE]
+//          * if a binary log was already started
+//      [RESULT_BAD_PARAM]
+//          * if [fd] is negative
+// [lurk_binlog_stop]
+//  * stops the binary log; typed errors are formatted as text again
+//  * waits for threads still writing a record to the descriptor, and flushes the records still
+//    queued in the asynchronous writer, so the descriptor is no longer used once it returns
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the binary log was stopped
+//      [RESULT_FAILURE]
+//          * if no binary log was started
+// [lurk_err_args]
+//  * the typed counterpart of [lurk_err] used by the error macros when [LURK_BINARY_LOG] is defined
+//  * behaves like [lurk_err], including [result_config.do_err], but stores a binary record while a
+//    binary log is started
+//  == Parameters ==
+//      [result], [caller], [loc], [fmt]
+//          * see [lurk_err]; [caller], [loc], and [fmt] must be string literals (or otherwise live
+//            for the rest of the program), since they identify the call site
+//      [nargs]
+//          * the number of captured arguments
+//      [args]
+//          * the captured arguments, matching the conversions in [fmt]; may be [NULL] if [nargs] is
+//            [0]
+//  ==   Return   ==
+//      [result]
+//          * will always return the result passed to it
+// [lurk_format_args]
+//  * formats [fmt] with captured arguments like [snprintf] would with the original arguments
+//  * integers are narrowed to the type named by the length modifier of their conversion, exactly
+//    as printf would read them, and values are converted to fit the conversion specifier when their
+//    captured type does not match it; [%n] is not supported
+//  == Parameters ==
+//      [buf]
+//          * the buffer to format into; may be [NULL] if [size] is [0]
+//      [size]
+//          * the size of [buf]; the output is truncated and nul-terminated to fit
+//      [fmt], [nargs], [args]
+//          * see [lurk_err_args]
+//  ==   Return   ==
+//      * the length of the complete output without the nul, like [snprintf]
+result_t lurk_binlog_start(int fd);
+result_t lurk_binlog_stop(void);
+LURK_COLD result_t lurk_err_args(result_t result,
+                                 const char* caller, const char* loc,
+                                 const char* fmt, size_t nargs, const struct lurk_arg* args);
+size_t lurk_format_args(char* buf, size_t size,
+                        const char* fmt, size_t nargs, const struct lurk_arg* args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_BINLOG_H
@@ -0,0 +1,146 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// breadcrumb.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the breadcrumb mode for errors. Normally every [RETURN_TRACE_ERROR] and
+// [RETURN_PASS_ERROR] an error propagates through writes a record of its own, so an error deep in a
+// call chain costs one formatted write per level. When [LURK_BREADCRUMBS] is defined before
+// including lurk (ideally for the whole program, e.g. with [-DLURK_BREADCRUMBS]), the error macros
+// write nothing at all: each one pushes a compact frame (its call site, its result, and its
+// arguments captured like in a binary log, see [binlog.h]) onto a fixed-size thread-local stack.
+// Any error macro other than the trace and pass ones starts a new chain; the trace and pass ones
+// add a frame to it. The caller that handles the error then either writes the whole chain as a
+// single record with [lurk_log_error] or drops it with [lurk_clear_error].
+//
+// Like [LURK_BINARY_LOG], the mode captures arguments with [_Generic], so it is only available to
+// C11 code. A chain that is neither logged nor cleared is silently replaced by the next one.
+
+
+#ifndef LURK_BREADCRUMB_H
+#define LURK_BREADCRUMB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "result.h"
+#include "binlog.h"
+#include "site.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// [LURK_BREADCRUMB_DEPTH] is the number of frames a chain holds; frames past it are only counted.
+// [LURK_BREADCRUMB_ARGS] is the number of arguments kept per frame, further ones are rendered as
+// ["(missing)"]. String arguments are copied into the [LURK_BREADCRUMB_TEXT] bytes shared by the
+// whole chain, and truncated once it is full.
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_BREADCRUMB_DEPTH
+#   define LURK_BREADCRUMB_DEPTH 16
+#endif
+
+#ifndef LURK_BREADCRUMB_ARGS
+#   define LURK_BREADCRUMB_ARGS 4
+#endif
+
+#ifndef LURK_BREADCRUMB_TEXT
+#   define LURK_BREADCRUMB_TEXT 512
+#endif
+
+// [struct lurk_breadcrumb]
+//  [.result]
+//      * the result returned at the frame
+//  [.caller], [.loc], [.fmt]
+//      * the call site of the frame, as passed to a [result_err_fn]
+//  [.nargs], [.args]
+//      * the arguments captured for [.fmt]; string arguments point into the chain's [.text]
+struct lurk_breadcrumb {
+    result_t result;
+    const char* caller;
+    const char* loc;
+    const char* fmt;
+    size_t nargs;
+    struct lurk_arg args[LURK_BREADCRUMB_ARGS];
+};
+
+// [struct lurk_breadcrumbs]
+//  [.depth]
+//      * the number of frames in [.frames]; [0] when there is no error pending
+//  [.dropped]
+//      * the number of frames pushed after [.frames] was full
+//  [.frames]
+//      * the chain, starting with the frame that began it (the deepest one)
+//  [.textlen], [.text]
+//      * the copies of the string arguments of every frame
+struct lurk_breadcrumbs {
+    size_t depth;
+    size_t dropped;
+    struct lurk_breadcrumb frames[LURK_BREADCRUMB_DEPTH];
+    size_t textlen;
+    char text[LURK_BREADCRUMB_TEXT];
+};
+
+
+// [lurk_crumb]
+//  * the breadcrumb counterpart of [lurk_err] used by the error macros when [LURK_BREADCRUMBS] is
+//    defined; records a frame instead of writing anything, unless errors are disabled in
+//    [lurk_enabled] and the result counters (see [counters.h]) are not running
+//  == Parameters ==
+//      [result], [caller], [loc], [fmt]
+//          * see [lurk_err]; [caller], [loc], and [fmt] must be string literals (or otherwise live
+//            until the chain is logged or cleared)
+//      [hop]
+//          * [true] to add the frame to the pending chain, [false] to start a new chain with it
+//      [nargs], [args]
+//          * see [lurk_err_args]
+//  ==   Return   ==
+//      [result]
+//          * will always return the result passed to it
+// [lurk_crumb_site]
+//  * the call-site counterpart of [lurk_crumb]; behaves exactly like [lurk_crumb] called with the
+//    caller, location, and format of [site]
+// [lurk_last_error]
+//  * the chain pending on the calling thread; it stays valid until the thread's next error macro,
+//    [lurk_log_error], or [lurk_clear_error]
+//  ==   Return   ==
+//      * the chain, whose [.depth] is [0] if no error is pending; never [NULL]
+// [lurk_format_error]
+//  * formats the pending chain like [snprintf]: the message of its first frame, followed by
+//    [" <- %08x [caller.loc] message"] for every later frame
+//  == Parameters ==
+//      [buf]
+//          * the buffer to format into; may be [NULL] if [size] is [0]
+//      [size]
+//          * the size of [buf]; the output is truncated and nul-terminated to fit
+//  ==   Return   ==
+//      * the length of the complete output without the nul, like [snprintf]
+// [lurk_log_error]
+//  * writes the pending chain as a single error record through the active [result_err_fn], with
+//    the result and call site of its first frame, then clears it
+//  ==   Return   ==
+//      * the result of the last frame of the chain, i.e. the one the caller was returned, or
+//        [RESULT_SUCCESS] if no error was pending
+// [lurk_clear_error]
+//  * drops the pending chain without writing it
+LURK_COLD result_t lurk_crumb(result_t result, const char* caller, const char* loc, const char* fmt,
+                              bool hop, size_t nargs, const struct lurk_arg* args);
+LURK_COLD result_t lurk_crumb_site(result_t result, const lurk_site_t* site,
+                                   bool hop, size_t nargs, const struct lurk_arg* args);
+const struct lurk_breadcrumbs* lurk_last_error(void);
+size_t lurk_format_error(char* buf, size_t size);
+result_t lurk_log_error(void);
+void lurk_clear_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_BREADCRUMB_H
@@ -0,0 +1,145 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// counters.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the result counters. While they are enabled, every record logged or error
+// raised counts towards its result code, whether or not it is written: a program can run with
+// [.do_log] and [.do_err] turned off and still know how often each error happens.
+//
+// Counting never contends. Each thread counts in a shard of its own, aligned to and padded out to
+// whole cache lines, with a plain load and store; a code is mapped to its counter by a small table
+// shared read-only by all threads. [lurk_counters_snapshot] adds the shards up, and an exporter
+// thread can write the totals to a file in the OpenMetrics text format on a fixed cadence, for a
+// metrics agent to pick up.
+
+
+#ifndef LURK_COUNTERS_H
+#define LURK_COUNTERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// [LURK_COUNTERS_CODES] is the number of distinct result codes counted separately; the codes seen
+// after that many are counted together as ["other"]. [LURK_COUNTERS_PATH_MAX] is the longest export
+// path accepted, including the nul.
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_COUNTERS_CODES
+#   define LURK_COUNTERS_CODES 128
+#endif
+
+#define LURK_COUNTERS_PATH_MAX 4096
+
+// [struct lurk_counter]
+//  [.result]
+//      * the result code counted
+//  [.logs], [.errs]
+//      * the number of records logged and of errors raised with it
+// [struct lurk_counters]
+//  * the totals of every counter at one point in time
+//  [.count]
+//      * the number of codes in [.codes], in the order they were first counted
+//  [.codes]
+//      * the counters of each code
+//  [.other]
+//      * the counters of every code that did not fit in [.codes]; its [.result] is meaningless
+struct lurk_counter {
+    result_t result;
+    uint64_t logs;
+    uint64_t errs;
+};
+
+struct lurk_counters {
+    size_t count;
+    struct lurk_counter codes[LURK_COUNTERS_CODES];
+    struct lurk_counter other;
+};
+
+
+// [lurk_counters_enable]
+//  * starts or stops counting; counters keep their totals while counting is stopped
+//  * while counting, calls into the library are no longer skipped inline when [.do_log] or
+//    [.do_err] are off (see [lurk_enabled]), since they have to be counted
+//  * records are counted by [lurk_log] and [lurk_err] and their call-site and argument capturing
+//    counterparts; an error held in a breadcrumb chain (see [breadcrumb.h]) is counted once it is
+//    written
+//  == Parameters ==
+//      [enable]
+//          * whether to count
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * always
+// [lurk_counters_snapshot]
+//  * adds the shards of every thread, including exited ones, up into [snapshot]; counts made
+//    concurrently may or may not be included
+//  == Parameters ==
+//      [snapshot]
+//          * where to store the totals; must not be [NULL]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the totals were stored
+//      [RESULT_BAD_PARAM]
+//          * if [snapshot] is [NULL]
+// [lurk_counters_format]
+//  * renders [snapshot] in the OpenMetrics text format as the ["lurk_results"] counter family, with
+//    a ["lurk_results_total"] sample for each kind (["log"] or ["err"]) of each code, labelled with
+//    the code and, if it is registered (see [domain.h]), its name
+//  == Parameters ==
+//      [buf]
+//          * the buffer to render into; may be [NULL] if [size] is [0]
+//      [size]
+//          * the size of [buf]; the output is truncated and nul-terminated to fit
+//      [snapshot]
+//          * the totals to render; must not be [NULL]
+//  ==   Return   ==
+//      * the length of the complete output without the nul, like [snprintf]
+// [lurk_counters_export_start]
+//  * starts a thread that writes a snapshot to [path] every [period_ms] milliseconds, each time
+//    into a temporary file next to it that then replaces it, so a reader never sees a partial one
+//  == Parameters ==
+//      [path]
+//          * the file to export to; must not be [NULL] and must be shorter than
+//            [LURK_COUNTERS_PATH_MAX]; the temporary file is [path] with [".tmp"] appended
+//      [period_ms]
+//          * how often to export; must not be [0]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the exporter was started
+//      [RESULT_FAILURE]
+//          * if an exporter is already running
+//      [RESULT_BAD_PARAM]
+//          * if [path] is [NULL] or too long, or [period_ms] is [0]
+//      [RESULT_INTERNAL_ERROR]
+//          * if the thread could not be created
+// [lurk_counters_export_stop]
+//  * writes a last snapshot and stops the exporter
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the exporter was stopped
+//      [RESULT_FAILURE]
+//          * if no exporter was running
+result_t lurk_counters_enable(bool enable);
+result_t lurk_counters_snapshot(struct lurk_counters* snapshot);
+size_t lurk_counters_format(char* buf, size_t size, const struct lurk_counters* snapshot);
+result_t lurk_counters_export_start(const char* path, unsigned period_ms);
+result_t lurk_counters_export_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_COUNTERS_H
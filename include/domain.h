@@ -0,0 +1,123 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// domain.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the registry of result codes. A library that defines results of its own
+// reserves a range of codes for them (a domain) with [lurk_domain_reserve], and then gives each of
+// its codes a name and a category with [lurk_result_register]. Lurk's own results are registered
+// as the ["lurk"] domain from the start.
+//
+// Every code of every domain lives in one flat table indexed by the code itself, so looking up a
+// name or a category is a bounds check and a load, with no hashing or searching. The default log
+// and error functions print a registered result by its name instead of in hex.
+
+
+#ifndef LURK_DOMAIN_H
+#define LURK_DOMAIN_H
+
+#include <stddef.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// [LURK_DOMAINS_MAX] is the number of domains that can be reserved, including lurk's own.
+// [LURK_DOMAIN_SPAN_MAX] bounds how far apart the lowest and the highest reserved code may be,
+// which is what the size of the table follows; domains should therefore be reserved close to each
+// other.
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_DOMAINS_MAX
+#   define LURK_DOMAINS_MAX 64
+#endif
+
+#ifndef LURK_DOMAIN_SPAN_MAX
+#   define LURK_DOMAIN_SPAN_MAX 65536
+#endif
+
+// [enum lurk_category]
+//  * the categories of [enum result] (see [result.h]) a code can be registered with
+//  [LURK_CATEGORY_ERROR], [LURK_CATEGORY_SUCCESS], [LURK_CATEGORY_STATUS]
+//      * what any negative code, zero, and any positive code are respectively, unless they are
+//        registered otherwise
+//  [LURK_CATEGORY_BOOLEAN]
+//      * a code that is only ever returned as a boolean result
+enum lurk_category {
+    LURK_CATEGORY_ERROR   = 0,
+    LURK_CATEGORY_SUCCESS = 1,
+    LURK_CATEGORY_STATUS  = 2,
+    LURK_CATEGORY_BOOLEAN = 3,
+};
+
+
+// [lurk_domain_reserve]
+//  * reserves the codes [first] to [first + count - 1] for the domain [name]; they have no names
+//    until they are registered
+//  == Parameters ==
+//      [name]
+//          * the name of the domain, e.g. the name of the library; must not be [NULL] and must stay
+//            valid for the rest of the program
+//      [first]
+//          * the lowest code of the domain
+//      [count]
+//          * the number of codes in the domain; must not be [0]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the codes were reserved
+//      [RESULT_FAILURE]
+//          * if any of the codes belongs to another domain, or [LURK_DOMAINS_MAX] domains are
+//            already reserved
+//      [RESULT_BAD_PARAM]
+//          * if [name] is [NULL], [count] is [0], the range does not fit in a [result_t], or the
+//            codes of all domains would span more than [LURK_DOMAIN_SPAN_MAX]
+//      [RESULT_INTERNAL_ERROR]
+//          * if the table could not be grown
+// [lurk_result_register]
+//  * names a code of a reserved domain
+//  == Parameters ==
+//      [result]
+//          * the code to name
+//      [name]
+//          * the name to print for it, e.g. ["MYLIB_TIMEOUT"]; must not be [NULL] and must stay
+//            valid for the rest of the program
+//      [category]
+//          * the category of the code
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the code was named
+//      [RESULT_FAILURE]
+//          * if the code is not in a reserved domain, or already has a name
+//      [RESULT_BAD_PARAM]
+//          * if [name] is [NULL] or [category] is not one of [enum lurk_category]
+// [lurk_result_name]
+//  * looks up the name of a code; safe to call from any thread at any time
+//  ==   Return   ==
+//      * the registered name, or [NULL] if the code has none
+// [lurk_result_category]
+//  * looks up the category of a code; safe to call from any thread at any time
+//  ==   Return   ==
+//      * the registered category, or the one its sign implies if the code has no name
+// [lurk_result_domain]
+//  * looks up the domain a code belongs to
+//  ==   Return   ==
+//      * the name of the domain, or [NULL] if the code is not in a reserved domain
+result_t lurk_domain_reserve(const char* name, result_t first, size_t count);
+result_t lurk_result_register(result_t result, const char* name, enum lurk_category category);
+const char* lurk_result_name(result_t result);
+enum lurk_category lurk_result_category(result_t result);
+const char* lurk_result_domain(result_t result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_DOMAIN_H
@@ -0,0 +1,125 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// kv.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines structured logging: a record made of a fixed message and typed key/value
+// fields, e.g. [lurk_logkv(RESULT_SUCCESS, "login", LURK_KV("user", id), LURK_KV("ok", true))].
+// The fields are captured like the arguments of the binary log (see [binlog.h]) and travel with the
+// record through the active [result_log_fn] or [result_err_fn]. The default functions, and every
+// sink built on them, encode them according to [result_config.format] (see [result.h]) straight
+// into the buffer the record is rendered in: appended to the message as logfmt in the text format,
+// or as members of the record in the JSON and logfmt formats. Nothing is allocated on the way.
+
+
+#ifndef LURK_KV_H
+#define LURK_KV_H
+
+#include <stddef.h>
+
+#include "result.h"
+#include "binlog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// [struct lurk_kv]
+//  * a field of a structured record; [.key] must stay valid while the record is written and should
+//    not repeat one of the keys the format already uses (see [enum lurk_format])
+// [LURK_KV]
+//  * captures a field with [LURK_ARG] (see [binlog.h]); strings are encoded as strings, integers
+//    and floating point values as numbers, and other pointers as their address
+// [LURK_KVS]
+//  * expands to the number of fields followed by a compound literal array of them; there must be at
+//    least one field
+struct lurk_kv {
+    const char* key;
+    struct lurk_arg value;
+};
+
+#define LURK_KV(key, value) ((struct lurk_kv){ (key), LURK_ARG(value) })
+
+#define LURK_KVS(...)                                                                              \
+    sizeof((const struct lurk_kv[]){ __VA_ARGS__ }) / sizeof(struct lurk_kv),                      \
+    (const struct lurk_kv[]){ __VA_ARGS__ }
+
+// [lurk_logkv] and [lurk_errkv] log a message with the fields given as [LURK_KV]s; [lurk_errkv]
+// fills in the caller and location like the error macros do
+#define lurk_logkv(result, msg, ...) lurk_log_fields(result, msg, LURK_KVS(__VA_ARGS__))
+
+#define lurk_errkv(result, msg, ...)                                                               \
+    lurk_err_fields(result, __func__, LURK_LINE_STRING, msg, LURK_KVS(__VA_ARGS__))
+
+
+// [lurk_log_fields]
+//  * logs [msg] with [fields] through the active [result_log_fn] like [lurk_log], honouring
+//    [result_config.do_log]
+//  * the log function is called with the format ["%s"] and [msg]; a custom one can get the fields
+//    with [lurk_fields] and encode them with [lurk_encode_fields]
+//  == Parameters ==
+//      [result]
+//          * the result that is being logged
+//      [msg]
+//          * the message, which is not a format string; must not be [NULL]
+//      [nfields]
+//          * the number of fields
+//      [fields]
+//          * the fields; may be [NULL] if [nfields] is [0]
+//  ==   Return   ==
+//      [result]
+//          * will always return the result passed to it
+// [lurk_err_fields]
+//  * like [lurk_log_fields], but logs an error through the active [result_err_fn] like [lurk_err];
+//    while a binary log is running (see [binlog.h]), it is still written as text
+//  == Parameters ==
+//      [result], [caller], [loc]
+//          * see [lurk_err]
+//      [msg], [nfields], [fields]
+//          * see [lurk_log_fields]
+//  ==   Return   ==
+//      [result]
+//          * will always return the result passed to it
+// [lurk_fields]
+//  * gets the fields of the record a [result_log_fn] or [result_err_fn] was called for
+//  == Parameters ==
+//      [fmt]
+//          * the format the function was called with
+//      [fields]
+//          * where to store a pointer to the fields; must not be [NULL]
+//  ==   Return   ==
+//      * the number of fields, or [0] (with [*fields] set to [NULL]) for a record without any
+// [lurk_encode_fields]
+//  * encodes fields the way [format] encodes them in a record: as JSON members separated by commas
+//    (without the braces) for [LURK_FORMAT_JSON], and as logfmt pairs separated by spaces otherwise
+//  == Parameters ==
+//      [buf]
+//          * the buffer to encode into; may be [NULL] if [size] is [0]
+//      [size]
+//          * the size of [buf]; the output is truncated and nul-terminated to fit
+//      [format]
+//          * the format to encode the fields for
+//      [nfields], [fields]
+//          * see [lurk_log_fields]
+//  ==   Return   ==
+//      * the length of the complete output without the nul, like [snprintf]
+result_t lurk_log_fields(result_t result, const char* msg,
+                         size_t nfields, const struct lurk_kv* fields);
+LURK_COLD result_t lurk_err_fields(result_t result, const char* caller, const char* loc,
+                                   const char* msg, size_t nfields, const struct lurk_kv* fields);
+size_t lurk_fields(const char* fmt, const struct lurk_kv** fields);
+size_t lurk_encode_fields(char* buf, size_t size, enum lurk_format format,
+                          size_t nfields, const struct lurk_kv* fields);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_KV_H
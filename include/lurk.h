@@ -14,12 +14,72 @@
 #ifndef LURK_H
 #define LURK_H
 
+// the implementation needs POSIX.1-2008 (and [syscall] for io_uring), which has to be requested
+// before any system header
+#if defined(LURK_IMPLEMENTATION) && !defined(_POSIX_C_SOURCE)
+#   define _POSIX_C_SOURCE 200809L
+#endif
+#if defined(LURK_IMPLEMENTATION) && !defined(_DEFAULT_SOURCE)
+#   define _DEFAULT_SOURCE
+#endif
+
 #define LURK_STRINGIZE(x) #x
 #define LURK_DEFLECT_STRINGIZE(x) LURK_STRINGIZE(x)
 #define LURK_LINE_STRING LURK_DEFLECT_STRINGIZE(__LINE__)
-#define LURK_STR_SPACECAT(str0, str1) str0" "str1
+#define LURK_STR_SPACECAT(str0, str1) str0 " " str1
+
+// static call-site descriptors (see [site.h]) need GNU statement expressions and ELF sections; they
+// can be turned off by defining [LURK_NO_SITES]. C++ never uses them: the static locals of inline
+// and template functions are COMDAT, and GCC will not put those in the same section as the ones of
+// ordinary functions
+#if defined(__GNUC__) && defined(__ELF__) && !defined(__cplusplus) && !defined(LURK_NO_SITES)
+#   define LURK_HAVE_SITES
+#endif
 
 #include "result.h"
+#include "async.h"
+#include "binlog.h"
+#include "breadcrumb.h"
+#include "counters.h"
+#include "domain.h"
+#include "kv.h"
+#include "mmap.h"
+#include "recorder.h"
+#include "rotate.h"
+#include "shm.h"
+#include "sigsafe.h"
+#include "site.h"
+#include "sock.h"
+#include "timestamp.h"
 
 #endif // LURK_H
 
+
+// Defining [LURK_IMPLEMENTATION] before including [lurk.h] in exactly one C translation unit (and
+// before any other header in it) compiles the whole library into that unit, so it can be used
+// without building or linking it separately and the compiler can inline across it. Every other
+// unit includes [lurk.h] as usual. The program still needs [-pthread].
+// ---------------------------------------------------------------------------------------------- //
+#if defined(LURK_IMPLEMENTATION) && !defined(LURK_IMPLEMENTATION_INCLUDED)
+#define LURK_IMPLEMENTATION_INCLUDED
+
+#include "../src/result.c"
+#include "../src/async.c"
+#include "../src/binlog.c"
+#include "../src/breadcrumb.c"
+#include "../src/counters.c"
+#include "../src/domain.c"
+#include "../src/format.c"
+#include "../src/kv.c"
+#include "../src/mmap.c"
+#include "../src/recorder.c"
+#include "../src/rotate.c"
+#include "../src/shm.c"
+#include "../src/sigsafe.c"
+#include "../src/site.c"
+#include "../src/sock.c"
+#include "../src/timestamp.c"
+#include "../src/uring.c"
+
+#endif // LURK_IMPLEMENTATION
+
@@ -0,0 +1,122 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// mmap.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the memory-mapped file sink. [lurk_mmap_start] preallocates a file of a fixed
+// size and maps it into memory; [lurk_mmap_log] and [lurk_mmap_err], set as the [.log_fn] and
+// [.err_fn] of the config, then render each record on the calling thread, reserve room for it in
+// the mapping with a single atomic add, and copy it in. No system call is made per record: the
+// kernel writes the pages back on its own, and a background thread can additionally [msync] them
+// on a fixed cadence to bound how much an operating system crash loses.
+//
+// Every record is framed by a header word that is written last, so a process that dies while
+// writing leaves records that can be told apart from complete ones. [lurk-decode] (see
+// [tools/lurk-decode.c]) reads a mapped file back as text.
+
+
+#ifndef LURK_MMAP_H
+#define LURK_MMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// A mapped file starts with a [LURK_MMAP_HEADER_SIZE] byte header: the 8 byte magic ["LURKMAP1"]
+// and the [uint32_t] [LURK_MMAP_BYTE_ORDER] mark, zero-padded. Records follow it back to back, each
+// aligned to [LURK_MMAP_ALIGN] bytes:
+//  * a [uint32_t] header word holding the length of the text, with [LURK_MMAP_COMMITTED] set once
+//    the text is complete
+//  * the text of the record exactly as the default functions write it, including the newline
+//  * zero padding up to the next multiple of [LURK_MMAP_ALIGN]
+// A zero header word means no record was started there (yet); a reader moves on to the next
+// aligned word. [LURK_MMAP_RECORD_SIZE] is the size records are truncated to, keeping the postfix.
+// ---------------------------------------------------------------------------------------------- //
+#define LURK_MMAP_MAGIC "LURKMAP1"
+#define LURK_MMAP_BYTE_ORDER 0x01020304u
+#define LURK_MMAP_HEADER_SIZE 64
+#define LURK_MMAP_ALIGN 8
+#define LURK_MMAP_COMMITTED UINT32_C(0x80000000)
+
+#ifndef LURK_MMAP_RECORD_SIZE
+#   define LURK_MMAP_RECORD_SIZE 512
+#endif
+
+
+// [lurk_mmap_start]
+//  * creates (or truncates) the file at [path], preallocates [size] bytes for it with
+//    [posix_fallocate], and maps it; records written by [lurk_mmap_log] and [lurk_mmap_err] go to
+//    it from then on
+//  * the file does not wrap or grow: once it is full, records are dropped and counted (see
+//    [lurk_mmap_dropped]), and reported on [stderr] by the sync thread and by [lurk_mmap_stop];
+//    stopping and starting again on a new path begins a new file
+//  * a failed [msync] in the sync thread is reported on [stderr], and the thread keeps going
+//  == Parameters ==
+//      [path]
+//          * the file to write to; must not be [NULL]
+//      [size]
+//          * the size of the file; must be larger than [LURK_MMAP_HEADER_SIZE]
+//      [sync_ms]
+//          * how often, in milliseconds, a background thread calls [msync] on the written part of
+//            the file, or [0] to leave the write-back to the kernel until [lurk_mmap_stop]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the file was mapped
+//      [RESULT_FAILURE]
+//          * if a file was already mapped
+//      [RESULT_BAD_PARAM]
+//          * if [path] is [NULL] or [size] is too small
+//      [RESULT_INTERNAL_ERROR]
+//          * if the file could not be created, allocated, or mapped, or the sync thread could not
+//            be created
+// [lurk_mmap_stop]
+//  * waits for records being written to finish, syncs and unmaps the file, and truncates it to the
+//    records written; [lurk_mmap_log] and [lurk_mmap_err] fall back to the default functions again
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the file was closed
+//      [RESULT_FAILURE]
+//          * if no file was mapped
+//      [RESULT_INTERNAL_ERROR]
+//          * if the file was closed, but could not be synced or truncated
+// [lurk_mmap_sync]
+//  * calls [msync] on the written part of the file right away, blocking until it is on disk
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the file was synced
+//      [RESULT_FAILURE]
+//          * if no file was mapped
+//      [RESULT_INTERNAL_ERROR]
+//          * if [msync] failed
+// [lurk_mmap_dropped]
+//  * the number of records dropped because the file was full since the process started
+// [lurk_mmap_log], [lurk_mmap_err]
+//  * a [result_log_fn] and a [result_err_fn] that write to the mapped file, or behave exactly like
+//    the default functions while none is mapped
+//  * they honour [result_config.do_log] and [result_config.do_err] like the default functions
+result_t lurk_mmap_start(const char* path, size_t size, unsigned sync_ms);
+result_t lurk_mmap_stop(void);
+result_t lurk_mmap_sync(void);
+size_t lurk_mmap_dropped(void);
+void lurk_mmap_log(result_t result, const char* fmt, va_list args);
+void lurk_mmap_err(result_t result, const char* caller, const char* loc,
+                   const char* fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_MMAP_H
@@ -0,0 +1,129 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// recorder.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the flight recorder. While it runs, every record passed to [lurk_log] and
+// [lurk_err] (and their call-site and argument capturing counterparts) is also kept in memory,
+// whether or not [.do_log] and [.do_err] let it be written: each thread stores its records in a
+// fixed-size ring of its own that overwrites the oldest record, so the last few hundred records of
+// every thread are always at hand. Nothing is formatted and nothing is written while recording;
+// a record is a binary event like those of [binlog.h], with its arguments captured as they are.
+//
+// The rings are dumped as a binary log, which [lurk-decode] renders as text, when the process
+// receives a crash signal or on demand. The dump only uses async-signal-safe calls. Each ring also
+// starts with a magic-tagged header, so [lurk-decode] can find the rings in a core file and extract
+// them even when the process died before it could dump them.
+
+
+#ifndef LURK_RECORDER_H
+#define LURK_RECORDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// A ring starts with a [LURK_RECORDER_HEADER_SIZE] byte header, aligned to 64 bytes:
+//  * the 8 byte magic ["LURKREC1"] and the [uint32_t] [LURK_RECORDER_BYTE_ORDER] mark
+//  * the [uint32_t] number of slots and [uint32_t] size of a slot in bytes
+//  * the [uint32_t] thread id of the thread that records into it
+//  * the [uint64_t] number of records it has taken so far
+//  * the [uint64_t] [.tsc], [.ns], and [.mult] and the [uint32_t] [.shift] of the TSC calibration
+//    (see [timestamp.h]) its TSC stamps were last taken with; all zero if there were none
+// Its slots follow the header back to back. A slot holds a [uint64_t] sequence word, which is the
+// number of the record in it plus one and is zero while the record is being written, followed by
+// the record as a [LURK_BINLOG_INLINE_EVENT] or [LURK_BINLOG_INLINE_LOG] (see [binlog.h]), with
+// strings truncated to fit. [LURK_RECORDER_SLOTS] must be a power of two.
+//
+// The ring of a thread that exits keeps its records until there are [LURK_RECORDER_RINGS] rings;
+// after that, a new thread takes over a ring left by an exited one instead of adding another.
+// ---------------------------------------------------------------------------------------------- //
+#define LURK_RECORDER_MAGIC "LURKREC1"
+#define LURK_RECORDER_BYTE_ORDER 0x01020304u
+#define LURK_RECORDER_HEADER_SIZE 64
+
+#ifndef LURK_RECORDER_SLOTS
+#   define LURK_RECORDER_SLOTS 256
+#endif
+
+#ifndef LURK_RECORDER_SLOT_SIZE
+#   define LURK_RECORDER_SLOT_SIZE 256
+#endif
+
+#ifndef LURK_RECORDER_RINGS
+#   define LURK_RECORDER_RINGS 64
+#endif
+
+#define LURK_RECORDER_PATH_MAX 4096
+
+
+// [lurk_recorder_start]
+//  * starts recording and installs handlers that dump the rings to [path] and then let the signal
+//    take its previous course on [SIGSEGV], [SIGBUS], [SIGILL], [SIGFPE], and [SIGABRT] (so
+//    [abort] on a failed write still dumps), and that dump and carry on on [dump_signal]
+//  * a fault raised by the kernel is not raised again: the handler returns, so the faulting
+//    instruction runs again and faults into the previous handler with its real [siginfo]
+//  * the handlers run on the alternate signal stack where the thread has one, which a [SIGSEGV]
+//    from a stack overflow needs (see [sigaltstack])
+//  * every dump is appended to [path] as a binary log of its own, thread by thread, each thread's
+//    records from the oldest to the newest
+//  * while recording, calls into the library are no longer skipped inline when [.do_log] or
+//    [.do_err] are off (see [lurk_enabled]), since they have to be recorded
+//  == Parameters ==
+//      [path]
+//          * the file to dump to; must not be [NULL] and must be shorter than
+//            [LURK_RECORDER_PATH_MAX]
+//      [dump_signal]
+//          * the signal that dumps on demand, e.g. [SIGUSR1], or [0] for none
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if recording was started
+//      [RESULT_FAILURE]
+//          * if it was already running
+//      [RESULT_BAD_PARAM]
+//          * if [path] is [NULL] or too long, or [dump_signal] is not a valid signal
+//      [RESULT_INTERNAL_ERROR]
+//          * if a handler could not be installed
+// [lurk_recorder_stop]
+//  * stops recording and restores the handlers [lurk_recorder_start] replaced; the rings keep their
+//    records and can still be dumped
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if recording was stopped
+//      [RESULT_FAILURE]
+//          * if it was not running
+// [lurk_recorder_dump]
+//  * writes every ring to [fd] as a binary log, the way the handlers do; async-signal-safe
+//  * a record being written by another thread meanwhile is left out
+//  == Parameters ==
+//      [fd]
+//          * the file descriptor to write to
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the rings were written
+//      [RESULT_BAD_PARAM]
+//          * if [fd] is negative
+//      [RESULT_INTERNAL_ERROR]
+//          * if a write failed
+result_t lurk_recorder_start(const char* path, int dump_signal);
+result_t lurk_recorder_stop(void);
+result_t lurk_recorder_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_RECORDER_H
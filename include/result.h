@@ -20,21 +20,147 @@
 #include <stdbool.h>
 #include <stdarg.h>
 
+// [LURK_UNLIKELY] marks the failing branch of the guards so the compiler lays it out away from the
+// passing path, and [LURK_COLD] marks the error functions, so that every branch ending in a call
+// to one is treated the same way (GCC and Clang move such blocks into a separate [.text.unlikely]
+// section); they are never inlined, which matters when the library is built into the same unit
+#if defined(__GNUC__)
+#   define LURK_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#   define LURK_COLD __attribute__((cold, noinline))
+#else
+#   define LURK_UNLIKELY(x) (x)
+#   define LURK_COLD
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 // These macros can be used to log a simple error to [stderr]. They use the function [return_error]
 // defined below, and include the function name in the error message. They can be bypassed by
 // defining [LURK_NO_CALL_RETURN_ERROR] if a programmer wishes to avoid *all* potential logging
 // overhead (see below about configuration how logging can be dynamically controlled instead).
+// Where call-site descriptors are available ([LURK_HAVE_SITES], see [site.h]), they pass a single
+// pointer to a static descriptor of the call site instead of the caller, location, and format.
+// Defining [LURK_BINARY_LOG] makes them capture their arguments with their types instead so they
+// can be stored in a binary log (see [binlog.h]), and defining [LURK_BREADCRUMBS] makes them push
+// a frame onto the thread's error chain without writing anything (see [breadcrumb.h]).
+// [RETURN_ERROR_HOP] and [RETURN_ERROR_HOP_FMT] are the variants the trace and pass macros below
+// use; they only differ in that they add to the pending chain instead of starting a new one.
 // ---------------------------------------------------------------------------------------------- //
-#ifndef LURK_NO_CALL_RETURN_ERROR
-#   define RETURN_ERROR(result, err) lurk_err(result, __func__, LURK_LINE_STRING, err)
+#if defined(LURK_NO_CALL_RETURN_ERROR)
+#   define RETURN_ERROR(result, err) result
+
+#   define RETURN_ERROR_FMT(result, err, ...) result
+#elif defined(LURK_HAVE_SITES) && defined(LURK_BREADCRUMBS)
+#   define RETURN_ERROR(result, err)                                                               \
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_crumb_site(result, &lurk_site_, false, 0, NULL),                       \
+                       lurk_crumb(result, __func__, LURK_LINE_STRING, err, false, 0, NULL))
+
+#   define RETURN_ERROR_FMT(result, err, ...)                                                      \
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_crumb_site(result, &lurk_site_, false, LURK_ARGS(__VA_ARGS__)),        \
+                       lurk_crumb(result, __func__, LURK_LINE_STRING, err, false,                  \
+                                  LURK_ARGS(__VA_ARGS__)))
+
+#   define RETURN_ERROR_HOP(result, err)                                                           \
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_crumb_site(result, &lurk_site_, true, 0, NULL),                        \
+                       lurk_crumb(result, __func__, LURK_LINE_STRING, err, true, 0, NULL))
+
+#   define RETURN_ERROR_HOP_FMT(result, err, ...)                                                  \
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_crumb_site(result, &lurk_site_, true, LURK_ARGS(__VA_ARGS__)),         \
+                       lurk_crumb(result, __func__, LURK_LINE_STRING, err, true,                   \
+                                  LURK_ARGS(__VA_ARGS__)))
+#elif defined(LURK_BREADCRUMBS)
+#   define RETURN_ERROR(result, err)                                                               \
+        LURK_GATED(LURK_ENABLED_ERR, result,                                                       \
+                   lurk_crumb(result, __func__, LURK_LINE_STRING, err, false, 0, NULL))
+
+#   define RETURN_ERROR_FMT(result, err, ...)                                                      \
+        LURK_GATED(LURK_ENABLED_ERR, result,                                                       \
+                   lurk_crumb(result, __func__, LURK_LINE_STRING, err, false,                      \
+                              LURK_ARGS(__VA_ARGS__)))
+
+#   define RETURN_ERROR_HOP(result, err)                                                           \
+        LURK_GATED(LURK_ENABLED_ERR, result,                                                       \
+                   lurk_crumb(result, __func__, LURK_LINE_STRING, err, true, 0, NULL))
+
+#   define RETURN_ERROR_HOP_FMT(result, err, ...)                                                  \
+        LURK_GATED(LURK_ENABLED_ERR, result,                                                       \
+                   lurk_crumb(result, __func__, LURK_LINE_STRING, err, true,                       \
+                              LURK_ARGS(__VA_ARGS__)))
+#elif defined(LURK_HAVE_SITES) && defined(LURK_BINARY_LOG)
+#   define RETURN_ERROR(result, err)                                                               \
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_err_site_args(result, &lurk_site_, 0, NULL),                           \
+                       lurk_err_args(result, __func__, LURK_LINE_STRING, err, 0, NULL))
 
 #   define RETURN_ERROR_FMT(result, err, ...)                                                      \
-        lurk_err(result, __func__, LURK_LINE_STRING, err, __VA_ARGS__)
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_err_site_args(result, &lurk_site_, LURK_ARGS(__VA_ARGS__)),            \
+                       lurk_err_args(result, __func__, LURK_LINE_STRING, err,                      \
+                                     LURK_ARGS(__VA_ARGS__)))
+#elif defined(LURK_HAVE_SITES)
+#   define RETURN_ERROR(result, err)                                                               \
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_err_site(result, &lurk_site_),                                         \
+                       lurk_err(result, __func__, LURK_LINE_STRING, err))
+
+#   define RETURN_ERROR_FMT(result, err, ...)                                                      \
+        LURK_WITH_SITE(LURK_ENABLED_ERR, err, result,                                              \
+                       lurk_err_site(result, &lurk_site_, __VA_ARGS__),                            \
+                       lurk_err(result, __func__, LURK_LINE_STRING, err, __VA_ARGS__))
+#elif defined(LURK_BINARY_LOG)
+#   define RETURN_ERROR(result, err)                                                               \
+        LURK_GATED(LURK_ENABLED_ERR, result,                                                       \
+                   lurk_err_args(result, __func__, LURK_LINE_STRING, err, 0, NULL))
+
+#   define RETURN_ERROR_FMT(result, err, ...)                                                      \
+        LURK_GATED(LURK_ENABLED_ERR, result,                                                       \
+                   lurk_err_args(result, __func__, LURK_LINE_STRING, err,                          \
+                                 LURK_ARGS(__VA_ARGS__)))
 #else
-#   define RETURN_ERROR(result, err) result
+#   define RETURN_ERROR(result, err)                                                               \
+        LURK_GATED(LURK_ENABLED_ERR, result, lurk_err(result, __func__, LURK_LINE_STRING, err))
 
-#   define RETURN_ERROR_FMT(result, err, ...) result
+#   define RETURN_ERROR_FMT(result, err, ...)                                                      \
+        LURK_GATED(LURK_ENABLED_ERR, result,                                                       \
+                   lurk_err(result, __func__, LURK_LINE_STRING, err, __VA_ARGS__))
+#endif
+
+#ifndef RETURN_ERROR_HOP
+#   define RETURN_ERROR_HOP(result, err) RETURN_ERROR(result, err)
+
+#   define RETURN_ERROR_HOP_FMT(result, err, ...) RETURN_ERROR_FMT(result, err, __VA_ARGS__)
+#endif
+
+
+// These macros log a result with [lurk_log]. Like the error macros above, they pass a call-site
+// descriptor where available, so each logging site can be enabled and disabled on its own, and they
+// can be bypassed entirely by defining [LURK_NO_CALL_LOG].
+// ---------------------------------------------------------------------------------------------- //
+#if defined(LURK_NO_CALL_LOG)
+#   define LURK_LOG(result, msg) result
+
+#   define LURK_LOG_FMT(result, fmt, ...) result
+#elif defined(LURK_HAVE_SITES)
+#   define LURK_LOG(result, msg)                                                                   \
+        LURK_WITH_SITE(LURK_ENABLED_LOG, msg, result,                                              \
+                       lurk_log_site(result, &lurk_site_), lurk_log(result, msg))
+
+#   define LURK_LOG_FMT(result, fmt, ...)                                                          \
+        LURK_WITH_SITE(LURK_ENABLED_LOG, fmt, result,                                              \
+                       lurk_log_site(result, &lurk_site_, __VA_ARGS__),                            \
+                       lurk_log(result, fmt, __VA_ARGS__))
+#else
+#   define LURK_LOG(result, msg) LURK_GATED(LURK_ENABLED_LOG, result, lurk_log(result, msg))
+
+#   define LURK_LOG_FMT(result, fmt, ...)                                                          \
+        LURK_GATED(LURK_ENABLED_LOG, result, lurk_log(result, fmt, __VA_ARGS__))
 #endif
 
 
@@ -44,11 +170,11 @@
 #define RETURN_TRACE_ERROR_STR                                                                     \
     "Callback trace."
 #define RETURN_TRACE_ERROR(result)                                                                 \
-    RETURN_ERROR(result, RETURN_TRACE_ERROR_STR)
+    RETURN_ERROR_HOP(result, RETURN_TRACE_ERROR_STR)
 #define RETURN_TRACE_ERROR_MSG(result, msg)                                                        \
-    RETURN_ERROR(result, LURK_STR_SPACECAT(RETURN_TRACE_ERROR_STR, msg))
+    RETURN_ERROR_HOP(result, LURK_STR_SPACECAT(RETURN_TRACE_ERROR_STR, msg))
 #define RETURN_TRACE_ERROR_FMT(result, fmt, ...)                                                   \
-    RETURN_ERROR_FMT(result, LURK_STR_SPACECAT(RETURN_TRACE_ERROR_STR, fmt), __VA_ARGS__)
+    RETURN_ERROR_HOP_FMT(result, LURK_STR_SPACECAT(RETURN_TRACE_ERROR_STR, fmt), __VA_ARGS__)
 
 #define RETURN_OBJ_TRACE_ERROR(obj, memb, result)                                                  \
     DEFINE_RETURN_OBJ_MACRO(obj, memb, RETURN_TRACE_ERROR(result))
@@ -61,11 +187,11 @@
 #define RETURN_PASS_ERROR_STR                                                                      \
     "Callback trace, passing [%08x]."
 #define RETURN_PASS_ERROR(result, pass)                                                            \
-    RETURN_ERROR_FMT(result, RETURN_PASS_ERROR_STR, pass)
+    RETURN_ERROR_HOP_FMT(result, RETURN_PASS_ERROR_STR, pass)
 #define RETURN_PASS_ERROR_MSG(result, pass, msg)                                                   \
-    RETURN_ERROR_FMT(result, LURK_STR_SPACECAT(RETURN_PASS_ERROR_STR, msg), pass)
+    RETURN_ERROR_HOP_FMT(result, LURK_STR_SPACECAT(RETURN_PASS_ERROR_STR, msg), pass)
 #define RETURN_PASS_ERROR_FMT(result, pass, fmt, ...)                                              \
-    RETURN_ERROR_FMT(result, LURK_STR_SPACECAT(RETURN_PASS_ERROR_STR, fmt), pass, __VA_ARGS__)
+    RETURN_ERROR_HOP_FMT(result, LURK_STR_SPACECAT(RETURN_PASS_ERROR_STR, fmt), pass, __VA_ARGS__)
 
 #define RETURN_OBJ_PASS_ERROR(obj, memb, result, pass)                                             \
     DEFINE_RETURN_OBJ_MACRO(obj, memb, RETURN_PASS_ERROR(result, pass))
@@ -182,15 +308,16 @@
 // ---------------------------------------------------------------------------------------------- //
 #ifndef LURK_NO_CALL_GUARD_VALID_OBJECT
 #   define GUARD_VALID_OBJECT(fn, obj)                                                             \
-        if (!is_valid_object(fn(obj))) return RETURN_INVALID_OBJECT(obj)
+        if (LURK_UNLIKELY(!is_valid_object(fn(obj)))) return RETURN_INVALID_OBJECT(obj)
 #   define OBJ_GUARD_VALID_OBJECT(ret_obj, ret_memb, fn, obj)                                      \
-        if (!is_valid_object(fn(obj)))                                                             \
+        if (LURK_UNLIKELY(!is_valid_object(fn(obj))))                                              \
             return RETURN_OBJ_INVALID_OBJECT(ret_obj, ret_memb, obj)
 
 #   define GUARD_VALID_OBJECT_MEMBER(fn, obj, memb)                                                \
-        if (!is_valid_object(fn(memb))) return RETURN_INVALID_OBJECT_MEMBER(obj, memb)
+        if (LURK_UNLIKELY(!is_valid_object(fn(memb))))                                             \
+            return RETURN_INVALID_OBJECT_MEMBER(obj, memb)
 #   define OBJ_GUARD_VALID_OBJECT_MEMBER(ret_obj, ret_memb, fn, obj, memb)                         \
-        if (!is_valid_object(fn(memb)))                                                            \
+        if (LURK_UNLIKELY(!is_valid_object(fn(memb))))                                             \
             return RETURN_OBJ_INVALID_OBJECT(ret_obj, ret_memb, obj)
 #else
 #   define GUARD_VALID_OBJECT(fn, obj)
@@ -202,9 +329,9 @@
 
 
 #ifndef LURK_NO_CALL_GUARD_NULL_PARAM
-#   define GUARD_NULL_PARAM(ptr) if (ptr == NULL) return RETURN_BAD_PARAM_NULL(ptr);
+#   define GUARD_NULL_PARAM(ptr) if (LURK_UNLIKELY(ptr == NULL)) return RETURN_BAD_PARAM_NULL(ptr);
 #   define OBJ_GUARD_NULL_PARAM(obj, memb, ptr)                                                    \
-            if (ptr == NULL) return RETURN_OBJ_BAD_PARAM_NULL(obj, memb, ptr)
+            if (LURK_UNLIKELY(ptr == NULL)) return RETURN_OBJ_BAD_PARAM_NULL(obj, memb, ptr)
 #else
 #   define GUARD_NULL_PARAM(ptr)
 #   define OBJ_GUARD_NULL_PARAM(obj, memb, ptr)
@@ -215,14 +342,15 @@
 // similar to the guards defined above but cannot be disabled.
 // ---------------------------------------------------------------------------------------------- //
 #define VALIDATE_OBJECT(fn, obj)                                                                   \
-    if (!is_valid_object(fn(obj))) return RETURN_INVALID_OBJECT(obj)
+    if (LURK_UNLIKELY(!is_valid_object(fn(obj)))) return RETURN_INVALID_OBJECT(obj)
 #define OBJ_VALIDATE_OBJECT(ret_obj, ret_memb, fn, obj)                                            \
-    if (!is_valid_object(fn(obj))) return RETURN_OBJ_INVALID_OBJECT(ret_obj, ret_memb, obj)
+    if (LURK_UNLIKELY(!is_valid_object(fn(obj))))                                                  \
+        return RETURN_OBJ_INVALID_OBJECT(ret_obj, ret_memb, obj)
 
 #define VALIDATE_OBJECT_MEMBER(fn, obj, memb)                                                      \
-    if (!is_valid_object(fn(memb))) return RETURN_INVALID_OBJECT_MEMBER(obj, memb)
+    if (LURK_UNLIKELY(!is_valid_object(fn(memb)))) return RETURN_INVALID_OBJECT_MEMBER(obj, memb)
 #define OBJ_VALIDATE_OBJECT_MEMBER(ret_obj, ret_memb, fn, obj, memb)                               \
-    if (!is_valid_object(fn(memb)))                                                                \
+    if (LURK_UNLIKELY(!is_valid_object(fn(memb))))                                                 \
         return RETURN_OBJ_INVALID_OBJECT_MEMBER(ret_obj, ret_memb, obj, memb)
 
 
@@ -328,11 +456,34 @@ typedef int boolresult_t;
 //    logging (unless [fmt] contains the new line, where it is up to the programmer in that case)
 //      * the default log and err functions automatically add a new line if [result_config.postfix]
 //        is left default
+//  * the default log and err functions render each record on the calling thread and write it with
+//    a single [write] straight to the [stdout] or [stderr] file descriptor, so records from
+//    different threads never interleave; note that this bypasses the buffers of the [stdout] and
+//    [stderr] streams
 typedef void result_log_fn(result_t result, const char* fmt, va_list args);
 typedef void result_err_fn(result_t result,
                                const char* caller, const char* loc,
                                const char* fmt, va_list args);
 
+// [enum lurk_format]
+//  * how the default log and error functions (and the sinks built on them, see [async.h],
+//    [mmap.h], and [rotate.h]) lay out a record; the message and any structured fields (see
+//    [kv.h]) are the same in every format
+//  [LURK_FORMAT_TEXT]
+//      * ["<time>  <result>  [<project>:<caller>.<loc>]  <prefix><message> key=value..."], the
+//        fields encoded as in logfmt
+//  [LURK_FORMAT_JSON]
+//      * one JSON object per record, with the keys ["time"], ["result"], ["result_name"] (if the
+//        result is registered, see [domain.h]), ["project"] (unless it is empty), ["caller"] and
+//        ["loc"] (errors only), the fields, and ["msg"] (the prefix and the message) last
+//  [LURK_FORMAT_LOGFMT]
+//      * the same keys as [LURK_FORMAT_JSON] as logfmt ["key=value"] pairs
+enum lurk_format {
+    LURK_FORMAT_TEXT   = 0,
+    LURK_FORMAT_JSON   = 1,
+    LURK_FORMAT_LOGFMT = 2,
+};
+
 // [struct result_config]
 //  [.projname]
 //      * specifies the project name to be logged; the default is ["lurk"], so any program wishing
@@ -347,10 +498,12 @@ typedef void result_err_fn(result_t result,
 //          * by default this is ["\n"] so that log calls print newlines
 //  [.do_log]
 //      * determines whether calling [lurk_log] actually writes to [stdout] or not
-//      * it may be changed at any time and is useful when only certain logs are desired
+//      * it is useful when only certain logs are desired; to change it while running, set the
+//        config again with [lurk_set_result_config]
 //  [.do_err]
 //      * determines whether calling [lurk_err] actually writes to [stderr] or not
-//      * it may be changed at any time and is useful when only certain errors are desired
+//      * it is useful when only certain errors are desired; like [.do_log], a change takes effect
+//        once the config is set again
 //  [.log_fn]
 //      * a pointer to a [result_log_fn] function
 //      * if this field is not [NULL], calling [lurk_log] will in turn call the function pointed to
@@ -359,6 +512,9 @@ typedef void result_err_fn(result_t result,
 //      * a pointer to a [result_err_fn] function
 //      * if this field is not [NULL], calling [lurk_err] will in turn call the function pointed to
 //        and bypass calling the default error logging function
+//  [.format]
+//      * the [enum lurk_format] records are rendered in; [LURK_FORMAT_TEXT] by default
+//      * the postfix still ends every record, so JSON records come out one per line by default
 struct result_config {
     const char* projname;
     const char* prefix;
@@ -367,10 +523,46 @@ struct result_config {
     bool do_err;
     result_log_fn* log_fn;
     result_err_fn* err_fn;
+    enum lurk_format format;
 };
 
 typedef struct result_config result_config_t;
 
+// [lurk_enabled]
+//  * a single word mirroring [.do_log] and [.do_err] of the active config as the
+//    [LURK_ENABLED_LOG] and [LURK_ENABLED_ERR] bits; it is only written when one of them changes,
+//    so the loads of it stay cache hits
+//  * the error and logging macros load it inline before doing anything else, with or without
+//    call-site descriptors, so while logging or errors are disabled a call site costs one load and
+//    a predicted branch and never evaluates its arguments
+//  * [LURK_ENABLED_COUNT] is set while the result counters run (see [counters.h]),
+//    [LURK_ENABLED_HITS] while the call-site hit counters do (see [site.h]), and
+//    [LURK_ENABLED_RECORD] while the flight recorder does (see [recorder.h]); calls then have to
+//    reach the library to be tallied even when the other bits are clear
+//  * it is updated by [lurk_set_result_config], [lurk_counters_enable], [lurk_site_hits_enable],
+//    and [lurk_recorder_start] and must not be written directly
+#define LURK_ENABLED_LOG 0x1u
+#define LURK_ENABLED_ERR 0x2u
+#define LURK_ENABLED_COUNT 0x4u
+#define LURK_ENABLED_HITS 0x8u
+#define LURK_ENABLED_RECORD 0x10u
+#define LURK_ENABLED_TALLY (LURK_ENABLED_COUNT | LURK_ENABLED_HITS | LURK_ENABLED_RECORD)
+
+extern unsigned lurk_enabled;
+
+// [LURK_GATED] evaluates [call] unless [enable_bit] and the [LURK_ENABLED_TALLY] bits are all clear
+// in [lurk_enabled], in which case it evaluates to [result] alone; it is the gate of the macros
+// above wherever they have no call-site descriptor, and needs no compiler extension
+#if defined(__GNUC__)
+#   define LURK_ENABLED_LOAD() __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED)
+#else
+#   define LURK_ENABLED_LOAD() lurk_enabled
+#endif
+
+#define LURK_GATED(enable_bit, result, call)                                                       \
+    (LURK_UNLIKELY(!(LURK_ENABLED_LOAD() & ((enable_bit) | LURK_ENABLED_TALLY)))                   \
+        ? (result) : (call))
+
 
 // The interface for using the lurk library is below.
 // ---------------------------------------------------------------------------------------------- //
@@ -461,24 +653,68 @@ typedef struct result_config result_config_t;
 //          * only if [result] is exactly [RESULT_FALSE]
 //      [false]
 //          * otherwise
-bool is_success(result_t result);
-bool is_failure(result_t result);
-bool is_valid_object(result_t result);
-bool is_error(result_t result);
-bool is_lurk_err(result_t result);
-bool is_true(result_t result);
-bool is_false(result_t result);
+//
+// The predicates are defined inline so that a check such as [GUARD_VALID_OBJECT] compiles down to a
+// compare and a branch at the call site; [result.c] still provides an external definition of each
+// for calls the compiler does not inline and for taking their address. In C++ they are also
+// [constexpr].
+#ifdef __cplusplus
+#   define LURK_PREDICATE constexpr inline
+#else
+#   define LURK_PREDICATE inline
+#endif
+
+LURK_PREDICATE bool is_success(result_t result) {
+    return result == RESULT_SUCCESS;
+}
+
+LURK_PREDICATE bool is_failure(result_t result) {
+    return result == RESULT_FAILURE;
+}
+
+LURK_PREDICATE bool is_valid_object(result_t result) {
+    return result == RESULT_VALID_OBJECT;
+}
+
+LURK_PREDICATE bool is_error(result_t result) {
+    return result < 0;
+}
+
+LURK_PREDICATE bool is_lurk_err(result_t result) {
+    return result == RESULT_INVALID_OBJECT ||
+           result == RESULT_INTERNAL_ERROR ||
+           result == RESULT_BAD_PARAM;
+}
+
+LURK_PREDICATE bool is_true(result_t result) {
+    return result == RESULT_TRUE;
+}
+
+LURK_PREDICATE bool is_false(result_t result) {
+    return result == RESULT_FALSE;
+}
+
 
 // [lurk_set_result_config]
 //  * set the config struct to something non-default; see the documentation above for how fields can
 //    be set to pull from the default, or alternatively first use [lurk_get_defaults] to populate
 //    the config, then fill in only the fields that need to be non-default
+//  * the config is copied, so later changes to [config] have no effect until it is set again;
+//    the strings and functions it points to must stay valid for as long as it is active
+//  * it may be called while other threads are logging: every record is written entirely with
+//    either the old config or the new one
+//  * also publishes [.do_log] and [.do_err] to [lurk_enabled]
 //  == Parameters ==
 //      [config]
-//          * a pointer to the config struct to pull config options from
+//          * a pointer to the config struct to pull config options from, or [NULL] to go back to
+//            the defaults
 //  ==   Return   ==
 //      [RESULT_SUCCESS]
-//          * always
+//          * if the config was set
+//      [RESULT_BAD_PARAM]
+//          * if [.format] is not one of [enum lurk_format]; the previous config stays active
+//      [RESULT_INTERNAL_ERROR]
+//          * if the copy could not be allocated; the previous config stays active
 // [lurk_get_defalts]
 //  * populate a result config struct with the lurk defaults
 //  == Parameters ==
@@ -532,6 +768,11 @@ bool is_false(result_t result);
 result_t lurk_set_result_config(result_config_t* config);
 result_t lurk_get_defaults(result_config_t* config);
 result_t lurk_log(result_t result, const char* fmt, ...);
-result_t lurk_err(result_t result, const char* caller, const char* loc, const char* fmt, ...);
+LURK_COLD result_t lurk_err(result_t result,
+                            const char* caller, const char* loc, const char* fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // LURK_RESULT_H
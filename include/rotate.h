@@ -0,0 +1,110 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// rotate.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the rotating file sink. Records are written to numbered segments next to a base
+// path ([path.000001], [path.000002], ...), each holding about [max_size] bytes or [interval]
+// seconds worth of records. [lurk_rotate_log] and [lurk_rotate_err], set as the [.log_fn] and
+// [.err_fn] of the config, only reserve an offset in the current segment with an atomic add and
+// write the record there with a single [pwrite].
+//
+// Everything else happens on a maintenance thread: it creates and preallocates the next segment
+// before it is needed, switches producers over to it when the current one is full or old enough,
+// truncates the finished segment to what was written, and deletes the oldest segments once all of
+// them together exceed the retention budget. A producer never waits for any of this; when the next
+// segment is not ready yet, it keeps writing to the current one.
+
+
+#ifndef LURK_ROTATE_H
+#define LURK_ROTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// [LURK_ROTATE_RECORD_SIZE] is the size records are truncated to, keeping the postfix.
+// [LURK_ROTATE_PATH_MAX] is the longest base path accepted, including the nul.
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_ROTATE_RECORD_SIZE
+#   define LURK_ROTATE_RECORD_SIZE 512
+#endif
+
+#define LURK_ROTATE_PATH_MAX 4096
+
+
+// [lurk_rotate_start]
+//  * opens the first segment after any that already exist for [path] (which count towards the
+//    budget like new ones) and starts the maintenance thread
+//  == Parameters ==
+//      [path]
+//          * the base path of the segments; must not be [NULL]
+//      [max_size]
+//          * the size a segment is rotated at; a record that crosses it still goes to the segment,
+//            so segments can end up slightly larger; [0] to only rotate by time
+//      [interval]
+//          * the age in seconds a non-empty segment is rotated at; [0] to only rotate by size
+//      [budget]
+//          * the total size of all segments, including the one being written, above which the
+//            oldest finished ones are deleted; [0] to keep every segment
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the sink was started
+//      [RESULT_FAILURE]
+//          * if the sink was already running
+//      [RESULT_BAD_PARAM]
+//          * if [path] is [NULL] or too long, or [max_size] and [interval] are both [0]
+//      [RESULT_INTERNAL_ERROR]
+//          * if the first segment could not be created or the maintenance thread could not be
+//            started
+// [lurk_rotate_stop]
+//  * stops the maintenance thread, waits for records being written to finish, and closes the
+//    current segment; [lurk_rotate_log] and [lurk_rotate_err] fall back to the default functions
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the sink was stopped
+//      [RESULT_FAILURE]
+//          * if the sink was not running
+// [lurk_rotate_now]
+//  * asks the maintenance thread to rotate as soon as it can, e.g. from a [SIGHUP] handler; it is
+//    async-signal-safe and does not wait for the rotation
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if a rotation was requested
+//      [RESULT_FAILURE]
+//          * if the sink is not running
+// [lurk_rotate_rotations]
+//  * the number of rotations done since the process started
+// [lurk_rotate_dropped]
+//  * the number of records dropped because they could not be written (e.g. the disk was full)
+//    since the process started
+// [lurk_rotate_log], [lurk_rotate_err]
+//  * a [result_log_fn] and a [result_err_fn] that write to the current segment, or behave exactly
+//    like the default functions while the sink is not running
+//  * they honour [result_config.do_log] and [result_config.do_err] like the default functions
+result_t lurk_rotate_start(const char* path, size_t max_size, unsigned interval, size_t budget);
+result_t lurk_rotate_stop(void);
+result_t lurk_rotate_now(void);
+size_t lurk_rotate_rotations(void);
+size_t lurk_rotate_dropped(void);
+void lurk_rotate_log(result_t result, const char* fmt, va_list args);
+void lurk_rotate_err(result_t result, const char* caller, const char* loc,
+                     const char* fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_ROTATE_H
@@ -0,0 +1,123 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// shm.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the shared-memory sink, which lets many processes log into one ring. The ring
+// is a POSIX shared-memory object (see [shm_open]) that every process maps; [lurk_shm_log] and
+// [lurk_shm_err], set as the [.log_fn] and [.err_fn] of the config, render each record on the
+// calling thread, claim the next slot of the ring with a compare-and-swap, and copy the record in.
+// No lock is taken and no system call is made per record, and no process ever waits for another.
+//
+// [lurk-collector] (see [tools/lurk-collector.c]) drains the ring into files in the order the
+// records claimed their slots. A record takes its time right after claiming its slot, so that is
+// also the order of their times across every process, short of a producer being preempted between
+// the two. The ring outlives the processes that write to it, so the records of a worker that
+// crashed are still there for the collector, even if it only starts after the crash.
+
+
+#ifndef LURK_SHM_H
+#define LURK_SHM_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// A ring starts with a [LURK_SHM_HEADER_SIZE] byte header:
+//  * the 8 byte magic ["LURKSHM1"] and the [uint32_t] [LURK_SHM_BYTE_ORDER] mark, which is written
+//    last, once the rest of the ring is initialized
+//  * the [uint32_t] number of slots and the [uint32_t] size of a slot in bytes
+//  * at offset 64, the [uint64_t] tail, the number of slots claimed by producers so far, and the
+//    [uint64_t] number of records dropped because the ring was full
+//  * at offset 128, the [uint64_t] head, the number of slots released by the collector so far, and
+//    the [uint64_t] number of slots it skipped because their producer died while writing them
+// The slots follow the header back to back. A slot starts with a [uint64_t] sequence word, a
+// [uint32_t] process id, a [uint16_t] text length, and a [uint8_t] that is [1] for an error and [0]
+// for a log record, padded to [LURK_SHM_SLOT_HEADER] bytes, followed by the text of the record
+// exactly as the default functions write it, truncated to fit but keeping the postfix.
+//
+// The slot with index [i] of a ring of [n] slots is free for the record claiming position
+// [i + k * n] (position [p] is the tail when it was claimed) while its sequence word is [p]; the
+// producer claims it by setting its process id from [0] before moving the tail past [p], then sets
+// the text and then the word to [p + 1], and the collector, once it has written the record out,
+// clears the process id and sets the word to [p + n]. A slot whose word is still [p] when the head
+// reaches it, with the tail past [p], has been claimed but not written yet; the collector only
+// skips it once the process whose id it holds no longer exists.
+// [LURK_SHM_SLOTS] must be a power of two.
+// ---------------------------------------------------------------------------------------------- //
+#define LURK_SHM_MAGIC "LURKSHM1"
+#define LURK_SHM_BYTE_ORDER 0x01020304u
+#define LURK_SHM_HEADER_SIZE 192
+#define LURK_SHM_SLOT_HEADER 16
+
+#ifndef LURK_SHM_SLOT_SIZE
+#   define LURK_SHM_SLOT_SIZE 512
+#endif
+
+#ifndef LURK_SHM_SLOTS
+#   define LURK_SHM_SLOTS 4096
+#endif
+
+
+// [lurk_shm_start]
+//  * maps the ring named [name], creating and initializing it with [slots] slots if it does not
+//    exist yet; records written by [lurk_shm_log] and [lurk_shm_err] go to it from then on
+//  * a process forked afterwards shares the mapping and writes to the same ring without calling
+//    this again, so a prefork server only needs to start it in the parent
+//  * once the ring is full, records are dropped and counted in the ring (see [lurk_shm_dropped])
+//  == Parameters ==
+//      [name]
+//          * the name of the shared-memory object, e.g. ["/myapp-log"] (see [shm_open]); must not
+//            be [NULL]
+//      [slots]
+//          * the number of slots of a new ring; must be a power of two, or [0] to use
+//            [LURK_SHM_SLOTS]; an existing ring keeps its own
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the ring was mapped
+//      [RESULT_FAILURE]
+//          * if a ring was already mapped
+//      [RESULT_BAD_PARAM]
+//          * if [name] is [NULL] or [slots] is not a power of two
+//      [RESULT_INTERNAL_ERROR]
+//          * if the ring could not be created or mapped, or an existing object is not a ring
+// [lurk_shm_stop]
+//  * waits for records being written to finish and unmaps the ring, which stays in place for the
+//    collector and other processes; [lurk_shm_log] and [lurk_shm_err] fall back to the default
+//    functions again
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the ring was unmapped
+//      [RESULT_FAILURE]
+//          * if no ring was mapped
+// [lurk_shm_dropped]
+//  * the number of records every process dropped because the ring was full, or [0] if no ring is
+//    mapped
+// [lurk_shm_log], [lurk_shm_err]
+//  * a [result_log_fn] and a [result_err_fn] that write to the ring, or behave exactly like the
+//    default functions while none is mapped
+//  * they honour [result_config.do_log] and [result_config.do_err] like the default functions
+result_t lurk_shm_start(const char* name, size_t slots);
+result_t lurk_shm_stop(void);
+size_t lurk_shm_dropped(void);
+void lurk_shm_log(result_t result, const char* fmt, va_list args);
+void lurk_shm_err(result_t result, const char* caller, const char* loc,
+                  const char* fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_SHM_H
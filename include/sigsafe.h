@@ -0,0 +1,114 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// sigsafe.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the async-signal-safe logging path. The default functions format with
+// [vsnprintf], may allocate, and abort when a write fails, and [lurk_err] itself loads the config
+// through per-thread state it may have to set up first; none of that may happen in a signal handler
+// or in the child of a multithreaded process before it calls [exec]. [lurk_err_sigsafe] and
+// [lurk_log_sigsafe] may: they format with a small formatter of their own that only knows integers,
+// characters, pointers, and strings, render the record on the calling thread's stack, and hand it
+// to the kernel with a single [write]. Nothing is locked, allocated, or shared between callers, so
+// they are also reentrant, and a record no longer than [PIPE_BUF] never interleaves with another.
+//
+// [lurk_sigsafe_log] and [lurk_sigsafe_err], set as the [.log_fn] and [.err_fn] of the config, make
+// the whole program write through the same path, so records from crash and timeout handlers look
+// and order exactly like the rest.
+
+
+#ifndef LURK_SIGSAFE_H
+#define LURK_SIGSAFE_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// These macros log an error like [RETURN_ERROR] and [RETURN_ERROR_FMT], but through
+// [lurk_err_sigsafe], so they can be used in signal handlers. Like the other error macros, they can
+// be bypassed by defining [LURK_NO_CALL_RETURN_ERROR].
+// ---------------------------------------------------------------------------------------------- //
+#if defined(LURK_NO_CALL_RETURN_ERROR)
+#   define RETURN_ERROR_SIGSAFE(result, err) result
+
+#   define RETURN_ERROR_SIGSAFE_FMT(result, err, ...) result
+#else
+#   define RETURN_ERROR_SIGSAFE(result, err)                                                       \
+        lurk_err_sigsafe(result, __func__, LURK_LINE_STRING, err)
+
+#   define RETURN_ERROR_SIGSAFE_FMT(result, err, ...)                                              \
+        lurk_err_sigsafe(result, __func__, LURK_LINE_STRING, err, __VA_ARGS__)
+#endif
+
+// Records longer than [LURK_SIGSAFE_RECORD_SIZE] (including the time, result, tag, prefix, and
+// postfix) are truncated to fit, always keeping the postfix; the record is rendered on the stack.
+// The project name, prefix, and postfix of the config are truncated to [LURK_SIGSAFE_STRING_MAX]
+// bytes, including the nul.
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_SIGSAFE_RECORD_SIZE
+#   define LURK_SIGSAFE_RECORD_SIZE 512
+#endif
+
+#define LURK_SIGSAFE_STRING_MAX 64
+
+
+// [lurk_err_sigsafe]
+//  * like [lurk_err], but async-signal-safe: writes the record straight to [stderr] in the text
+//    format unless [.do_err] is off, whichever [result_err_fn] and format the config sets
+//  * [errno] is left as it was, and a failed write is ignored rather than aborting
+//  * the record bypasses the asynchronous writer (see [async.h]), so it may overtake records still
+//    queued there; it is not counted (see [counters.h]) or recorded (see [recorder.h])
+//  == Parameters ==
+//      [result], [caller], [loc]
+//          * see [lurk_err]
+//      [fmt], [...]
+//          * see [lurk_format_sigsafe]
+//  ==   Return   ==
+//      [result]
+//          * will always return the result passed to it
+// [lurk_log_sigsafe]
+//  * like [lurk_log], the same way [lurk_err_sigsafe] is like [lurk_err], writing to [stdout]
+// [lurk_sigsafe_log], [lurk_sigsafe_err]
+//  * a [result_log_fn] and a [result_err_fn] that write through the same path
+// [lurk_format_sigsafe]
+//  * formats [fmt] like [vsnprintf] would, but async-signal-safe
+//  * knows the flags ['-'], ['0'], ['+'], [' '], and ['#'], widths and precisions (also as ['*']),
+//    every length modifier, and the conversions [%d], [%i], [%u], [%o], [%x], [%X], [%c], [%s],
+//    [%p], and [%%]; a floating point conversion consumes its argument and renders as ["?"], and
+//    [%n] consumes its argument and does nothing
+//  == Parameters ==
+//      [buf]
+//          * the buffer to format into; may be [NULL] if [size] is [0]
+//      [size]
+//          * the size of [buf]; the output is truncated and nul-terminated to fit
+//      [fmt]
+//          * the format string; must not be [NULL]
+//      [args]
+//          * the arguments matching the conversions in [fmt]
+//  ==   Return   ==
+//      * the length of the complete output without the nul, like [vsnprintf]
+LURK_COLD result_t lurk_err_sigsafe(result_t result,
+                                    const char* caller, const char* loc, const char* fmt, ...);
+result_t lurk_log_sigsafe(result_t result, const char* fmt, ...);
+void lurk_sigsafe_log(result_t result, const char* fmt, va_list args);
+void lurk_sigsafe_err(result_t result, const char* caller, const char* loc,
+                      const char* fmt, va_list args);
+size_t lurk_format_sigsafe(char* buf, size_t size, const char* fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_SIGSAFE_H
@@ -0,0 +1,274 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// site.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines static call-site descriptors. Where the compiler supports it ([LURK_HAVE_SITES]
+// in [lurk.h]), every error and logging macro expansion (e.g. [RETURN_ERROR] and [LURK_LOG_FMT])
+// emits one [static const] descriptor holding everything about the site that is known at compile
+// time, and passes a single pointer to it in place of the caller, location, and format arguments.
+// The descriptors are placed together in the [lurk_sites] ELF section, so every call site linked
+// into the program can also be listed at runtime.
+//
+// Each site also owns a small mutable state, checked inline right after the global [lurk_enabled]
+// word. A disabled site costs a load and a predicted branch: its arguments are not evaluated and
+// nothing is called. Sites are enabled by default and can be switched by name at runtime with
+// [lurk_sites_set_enabled].
+//
+// While [lurk_site_hits_enable] is in effect, every site also counts how often it is reached,
+// whether or not anything is written. A site is given an index the first time it is hit, and each
+// thread counts into its own array of counters at that index, so a hit costs a single increment
+// of thread-local memory. [lurk_site_hits_top] ranks the sites by their counts, e.g. to find the
+// [RETURN_BAD_PARAM] that fires millions of times, and [lurk_site_hits_dump_on] prints that ranking
+// whenever the process receives a given signal.
+
+
+#ifndef LURK_SITE_H
+#define LURK_SITE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// [struct lurk_site_state]
+//  [.disabled]
+//      * nonzero when the call site is disabled; only ever read and written atomically
+//      * it is zero-initialized, so every site starts out enabled
+//  [.index]
+//      * the index of the hit counter of the call site plus one, or [0] until it is first hit
+//        while the hit counters are enabled; only ever read and written atomically
+struct lurk_site_state {
+    unsigned char disabled;
+    unsigned index;
+};
+
+// [struct lurk_site]
+//  [.caller]
+//      * the name of the function containing the call site
+//  [.loc]
+//      * the line of the call site as a string, as passed to a [result_err_fn]
+//  [.fmt]
+//      * the format string of the call site
+//  [.file]
+//      * the source file containing the call site
+//  [.line]
+//      * the line of the call site
+//  [.state]
+//      * the mutable state of the call site (see [struct lurk_site_state])
+// Notes
+//  * the result is not part of the descriptor since many macros (e.g. [RETURN_PASS_ERROR]) take it
+//    at runtime; it is passed alongside the descriptor instead
+struct lurk_site {
+    const char* caller;
+    const char* loc;
+    const char* fmt;
+    const char* file;
+    int line;
+    struct lurk_site_state* state;
+};
+
+typedef struct lurk_site lurk_site_t;
+
+
+// [LURK_WITH_SITE] defines the descriptor [lurk_site_] for the enclosing call site and evaluates
+// [call], which may refer to it, unless [enable_bit] and the [LURK_ENABLED_TALLY] bits are all
+// clear in [lurk_enabled] or the site is disabled, in which case it evaluates to [result] alone.
+// Descriptors are explicitly aligned to a pointer so the compiler never pads between them, which
+// keeps the section a plain array of [struct lurk_site].
+//
+// C does not allow a function that is [inline] but not [static] to define the modifiable state of
+// a site, so such a function is wrapped in [#define LURK_NO_SITES_HERE] (defined empty) and
+// [#undef LURK_NO_SITES_HERE]. The macro is looked up wherever a site is expanded, and while it is
+// defined [LURK_WITH_SITE] evaluates [plain], the same call without a descriptor, instead. C++
+// never uses descriptors (see [lurk.h]).
+// ---------------------------------------------------------------------------------------------- //
+#define LURK_SITE_SECTION "lurk_sites"
+
+#define LURK_SITE_ATTRIBUTES                                                                       \
+    __attribute__((section(LURK_SITE_SECTION), aligned(sizeof(void*)), used))
+
+#define LURK_SITE_CAT(a, b) LURK_SITE_CAT_(a, b)
+#define LURK_SITE_CAT_(a, b) a##b
+
+#define LURK_WITH_SITE(enable_bit, site_fmt, result, call, plain)                                  \
+    LURK_SITE_CAT(LURK_WITH_SITE_, LURK_NO_SITES_HERE)(enable_bit, site_fmt, result, call, plain)
+
+#define LURK_WITH_SITE_(enable_bit, site_fmt, result, call, plain)                                 \
+    LURK_GATED(enable_bit, result, plain)
+
+#define LURK_WITH_SITE_LURK_NO_SITES_HERE(enable_bit, site_fmt, result, call, plain)               \
+    __extension__ ({                                                                               \
+        static struct lurk_site_state lurk_site_state_;                                            \
+        static const struct lurk_site lurk_site_ LURK_SITE_ATTRIBUTES = {                          \
+            .caller = __func__,                                                                    \
+            .loc = LURK_LINE_STRING,                                                               \
+            .fmt = site_fmt,                                                                       \
+            .file = __FILE__,                                                                      \
+            .line = __LINE__,                                                                      \
+            .state = &lurk_site_state_,                                                            \
+        };                                                                                         \
+        __builtin_expect(!(LURK_ENABLED_LOAD() & ((enable_bit) | LURK_ENABLED_TALLY)) ||           \
+                         __atomic_load_n(&lurk_site_state_.disabled, __ATOMIC_RELAXED), 0)         \
+            ? (result) : (call);                                                                   \
+    })
+
+
+// [lurk_err_site]
+//  * the call-site counterpart of [lurk_err] used by the error macros; behaves exactly like
+//    [lurk_err] called with the caller, location, and format of [site]
+//  == Parameters ==
+//      [result]
+//          * the result that is being logged
+//      [site]
+//          * the descriptor of the call site; must not be [NULL]
+//      [...]
+//          * the arguments for the format string of [site]
+//  ==   Return   ==
+//      [result]
+//          * will always return the result passed to it
+// [lurk_log_site]
+//  * the call-site counterpart of [lurk_log] used by the logging macros; behaves exactly like
+//    [lurk_log] called with the format of [site]
+// [lurk_err_site_args]
+//  * the call-site counterpart of [lurk_err_args] (see [binlog.h]) used by the error macros when
+//    [LURK_BINARY_LOG] is defined
+// [lurk_get_sites]
+//  * lists the descriptors of every call site in the [lurk_sites] section of the program (or shared
+//    object) the library is linked into
+//  == Parameters ==
+//      [sites]
+//          * set to the first descriptor, or [NULL] if there are none; must not be [NULL]
+//  ==   Return   ==
+//      * the number of descriptors
+// [lurk_sites_set_enabled]
+//  * enables or disables every call site whose caller, file, or ["file:line"] matches [pattern]
+//  == Parameters ==
+//      [pattern]
+//          * a shell wildcard pattern (see [fnmatch]), e.g. ["parse_*"] or ["src/net.c:*"]; must
+//            not be [NULL]
+//      [enabled]
+//          * whether the matching sites should be enabled
+//  ==   Return   ==
+//      * the number of sites that matched
+// [lurk_site_enabled]
+//  * determines whether a call site is enabled
+//  ==   Return   ==
+//      [true]
+//          * if [site] is enabled
+//      [false]
+//          * otherwise, or if [site] is [NULL]
+struct lurk_arg;
+
+LURK_COLD result_t lurk_err_site(result_t result, const lurk_site_t* site, ...);
+result_t lurk_log_site(result_t result, const lurk_site_t* site, ...);
+LURK_COLD result_t lurk_err_site_args(result_t result, const lurk_site_t* site,
+                                      size_t nargs, const struct lurk_arg* args);
+size_t lurk_get_sites(const lurk_site_t** sites);
+size_t lurk_sites_set_enabled(const char* pattern, bool enabled);
+bool lurk_site_enabled(const lurk_site_t* site);
+
+
+// [LURK_SITE_HITS_MAX] is the number of call sites whose hits can be counted; sites hit for the
+// first time after that many are not counted.
+// ---------------------------------------------------------------------------------------------- //
+#define LURK_SITE_HITS_MAX 65536
+
+// [struct lurk_site_hits]
+//  [.site]
+//      * the call site
+//  [.hits]
+//      * the number of times it was reached while the hit counters were enabled, by any thread
+//  [.rate]
+//      * its hits per second since the previous ranking (or since the hit counters were first
+//        enabled)
+struct lurk_site_hits {
+    const lurk_site_t* site;
+    uint64_t hits;
+    double rate;
+};
+
+
+// [lurk_site_hits_enable]
+//  * starts or stops counting the hits of every call site; counts are kept while it is stopped
+//  * every error, breadcrumb, and logging macro expansion that has a descriptor is counted, even
+//    when [.do_log] or [.do_err] is off or the record is dropped
+//  == Parameters ==
+//      [enable]
+//          * whether to count
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * always
+// [lurk_site_hits_top]
+//  * ranks the call sites hit so far by their counts, adding the counters of every thread up, and
+//    starts a new period for the rates
+//  == Parameters ==
+//      [top]
+//          * where to store the ranking, most hit first; may be [NULL] if [n] is [0]
+//      [n]
+//          * the number of sites to rank
+//  ==   Return   ==
+//      * the number of sites stored in [top], which is less than [n] if fewer were ever hit
+// [lurk_site_hits_format]
+//  * renders a ranking made by [lurk_site_hits_top] as text, one site per line with its rank, hits,
+//    rate, caller, and ["file:line"]
+//  == Parameters ==
+//      [buf]
+//          * the buffer to render into; may be [NULL] if [size] is [0]
+//      [size]
+//          * the size of [buf]; the output is truncated and nul-terminated to fit
+//      [top]
+//          * the ranking; must not be [NULL]
+//      [n]
+//          * the number of sites in [top]
+//  ==   Return   ==
+//      * the length of the complete output without the nul, like [snprintf]
+// [lurk_site_hits_dump_on]
+//  * installs a handler for [signo] that has a background thread write the report of the [n] most
+//    hit sites to [stderr], e.g. on [SIGUSR1]; the handler itself only posts a semaphore
+//  == Parameters ==
+//      [signo]
+//          * the signal to dump on
+//      [n]
+//          * the number of sites to report; must not be [0]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the handler was installed
+//      [RESULT_FAILURE]
+//          * if a handler is already installed
+//      [RESULT_BAD_PARAM]
+//          * if [n] is [0]
+//      [RESULT_INTERNAL_ERROR]
+//          * if the handler could not be installed (e.g. [signo] is not a valid signal) or the
+//            thread could not be created
+// [lurk_site_hits_dump_off]
+//  * restores the previous handler of the signal and stops the thread
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the handler was removed
+//      [RESULT_FAILURE]
+//          * if no handler was installed
+result_t lurk_site_hits_enable(bool enable);
+size_t lurk_site_hits_top(struct lurk_site_hits* top, size_t n);
+size_t lurk_site_hits_format(char* buf, size_t size,
+                             const struct lurk_site_hits* top, size_t n);
+result_t lurk_site_hits_dump_on(int signo, size_t n);
+result_t lurk_site_hits_dump_off(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_SITE_H
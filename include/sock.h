@@ -0,0 +1,121 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// sock.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines the socket sink, which streams records to a log collector over a Unix-domain or
+// TCP stream socket. [lurk_sock_log] and [lurk_sock_err], set as the [.log_fn] and [.err_fn] of the
+// config, render each record into a slot of a bounded, lock-free ring like the asynchronous mode
+// does (see [async.h]); a background sender thread coalesces the records waiting in the ring into
+// frames of up to [LURK_SOCK_BATCH] records, each sent with a single non-blocking [sendmsg].
+//
+// The producing threads never block and never touch the socket. While the collector is slow or
+// unreachable, records wait in the ring, and once it is full new records are dropped and counted.
+// The sender reconnects on its own after the connection fails or is refused, backing off from
+// [LURK_SOCK_BACKOFF_MIN_MS] to [LURK_SOCK_BACKOFF_MAX_MS] between attempts; a record that was only
+// partly sent when the connection broke is sent again in full on the next one.
+//
+// The records are sent exactly as the default functions write them, so the stream is plain text.
+// [lurk-agent] (see [tools/lurk-agent.c]) is a stand-in collector that accepts such streams.
+
+
+#ifndef LURK_SOCK_H
+#define LURK_SOCK_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Records larger than [LURK_SOCK_RECORD_SIZE] are truncated to fit, always keeping the postfix.
+// [LURK_SOCK_DEFAULT_CAPACITY] is the number of records the ring holds when no capacity is given to
+// [lurk_sock_start]. [lurk_sock_stop] waits at most [LURK_SOCK_STOP_TIMEOUT_MS] for the records
+// still in the ring to be sent.
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_SOCK_RECORD_SIZE
+#   define LURK_SOCK_RECORD_SIZE 512
+#endif
+
+#ifndef LURK_SOCK_DEFAULT_CAPACITY
+#   define LURK_SOCK_DEFAULT_CAPACITY 4096
+#endif
+
+#define LURK_SOCK_BATCH 64
+#define LURK_SOCK_BACKOFF_MIN_MS 10
+#define LURK_SOCK_BACKOFF_MAX_MS 1000
+#define LURK_SOCK_STOP_TIMEOUT_MS 1000
+
+
+// [lurk_sock_start]
+//  * allocates the ring and starts the sender thread, which connects to [address]; the connection
+//    is made in the background, so the collector does not have to be up yet
+//  * a forked child starts out with the sink stopped and an empty ring, like the asynchronous mode
+//  == Parameters ==
+//      [address]
+//          * ["unix:<path>"] for a Unix-domain socket, or ["tcp:<host>:<port>"] for TCP, where the
+//            host may be a name or an address (IPv6 addresses in brackets); must not be [NULL]
+//      [capacity]
+//          * the number of records the ring can hold; must be a power of two, or [0] to use
+//            [LURK_SOCK_DEFAULT_CAPACITY]
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the sender was started
+//      [RESULT_FAILURE]
+//          * if the sink was already running
+//      [RESULT_BAD_PARAM]
+//          * if [address] is [NULL], malformed, or cannot be resolved, or [capacity] is not a power
+//            of two
+//      [RESULT_INTERNAL_ERROR]
+//          * if the ring could not be allocated or the sender thread could not be created
+// [lurk_sock_stop]
+//  * stops taking records, sends the ones still in the ring if it can within
+//    [LURK_SOCK_STOP_TIMEOUT_MS] (dropping the rest), and stops the sender and closes the socket;
+//    [lurk_sock_log] and [lurk_sock_err] fall back to the default functions again
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the sink was stopped
+//      [RESULT_FAILURE]
+//          * if it was not running
+// [lurk_sock_flush]
+//  * blocks until every record pushed before the call has been sent, which includes waiting for
+//    the sender to reconnect if the connection is down
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if the ring was flushed
+//      [RESULT_FAILURE]
+//          * if the sink was not running, or was stopped while waiting
+// [lurk_sock_connected]
+//  * determines whether the sender is connected to the collector right now
+// [lurk_sock_dropped]
+//  * the number of records dropped since the process started, because the ring was full or because
+//    [lurk_sock_stop] could not send them in time; the sender also reports drops on [stderr]
+// [lurk_sock_log], [lurk_sock_err]
+//  * a [result_log_fn] and a [result_err_fn] that queue the record for the socket, or behave
+//    exactly like the default functions while the sink is not running
+//  * they honour [result_config.do_log] and [result_config.do_err] like the default functions
+result_t lurk_sock_start(const char* address, size_t capacity);
+result_t lurk_sock_stop(void);
+result_t lurk_sock_flush(void);
+bool lurk_sock_connected(void);
+size_t lurk_sock_dropped(void);
+void lurk_sock_log(result_t result, const char* fmt, va_list args);
+void lurk_sock_err(result_t result, const char* caller, const char* loc,
+                   const char* fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_SOCK_H
@@ -0,0 +1,130 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// timestamp.h
+// ---------------------------------------------------------------------------------------------- //
+// This file defines how lurk reads the clock and renders the time at the start of every record. A
+// timestamp is a UTC ISO-8601 date and time with microseconds, e.g. "2023-06-01T12:34:56.789012Z".
+// Rendering keeps the "YYYY-MM-DDTHH:MM:SS" part of the last second it saw in a thread-local cache,
+// so a record within the same second only converts its microseconds; the date itself is computed
+// arithmetically and never calls into the C library's time zone code.
+//
+// Records are stamped when they are produced and only converted to wall-clock time when they are
+// written. By default a stamp already is the wall-clock time in nanoseconds, but on x86-64 machines
+// with an invariant TSC, [lurk_tsc_start] switches producers to storing the raw TSC instead: the
+// asynchronous writer (see [async.h]) or [lurk-decode] (for binary logs, see [binlog.h]) converts
+// it later with a calibration against [LURK_TIMESTAMP_CLOCK] that is refreshed periodically.
+
+
+#ifndef LURK_TIMESTAMP_H
+#define LURK_TIMESTAMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "result.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// [LURK_TIMESTAMP_CLOCK] is the clock read by [lurk_timestamp]. The default [CLOCK_REALTIME] is
+// served from the vDSO on Linux; [CLOCK_REALTIME_COARSE] is cheaper still, but only advances once
+// per scheduler tick, so the microseconds it renders are only as fine as that tick. It takes effect
+// when building the library. [LURK_TIMESTAMP_SIZE] is the size of a rendered timestamp, including
+// the nul.
+// ---------------------------------------------------------------------------------------------- //
+#ifndef LURK_TIMESTAMP_CLOCK
+#   define LURK_TIMESTAMP_CLOCK CLOCK_REALTIME
+#endif
+
+#define LURK_TIMESTAMP_SIZE 28
+
+// A stamp with [LURK_STAMP_TSC] set holds a TSC reading in its other bits; any other stamp is
+// nanoseconds since the epoch. [LURK_TSC_RECALIBRATE_NS] is how often the calibration is refreshed
+// while stamps are being converted.
+// ---------------------------------------------------------------------------------------------- //
+#define LURK_STAMP_TSC (UINT64_C(1) << 63)
+
+#ifndef LURK_TSC_RECALIBRATE_NS
+#   define LURK_TSC_RECALIBRATE_NS 1000000000u
+#endif
+
+// [struct lurk_tsc_calibration]
+//  [.tsc], [.ns]
+//      * a TSC reading and the time in nanoseconds since the epoch it was taken at
+//  [.mult], [.shift]
+//      * the length of a tick in nanoseconds as a fixed-point number with [.shift] fraction bits
+struct lurk_tsc_calibration {
+    uint64_t tsc;
+    uint64_t ns;
+    uint64_t mult;
+    uint32_t shift;
+};
+
+
+// [lurk_timestamp]
+//  * reads [LURK_TIMESTAMP_CLOCK]
+//  ==   Return   ==
+//      * the time in nanoseconds since the epoch
+// [lurk_format_timestamp]
+//  * renders a time as ["YYYY-MM-DDTHH:MM:SS.uuuuuuZ"]
+//  == Parameters ==
+//      [buf]
+//          * the buffer to render into; must hold at least [LURK_TIMESTAMP_SIZE] bytes
+//      [ns]
+//          * the time in nanoseconds since the epoch, as returned by [lurk_timestamp]
+//  ==   Return   ==
+//      * the length of the timestamp without the nul, which is always [LURK_TIMESTAMP_SIZE - 1]
+// [lurk_tsc_start]
+//  * checks that the TSC is invariant (it ticks at a constant rate in every power state, and the
+//    kernel still trusts it as a clock source), calibrates it against [LURK_TIMESTAMP_CLOCK] over
+//    about 10ms, and then makes [lurk_stamp] read the TSC
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if stamps now read the TSC
+//      [RESULT_FAILURE]
+//          * if they already did, or if the TSC is missing or not invariant; stamps keep reading
+//            [LURK_TIMESTAMP_CLOCK] in that case
+// [lurk_tsc_stop]
+//  * makes [lurk_stamp] read [LURK_TIMESTAMP_CLOCK] again; stamps already taken from the TSC can
+//    still be converted
+//  ==   Return   ==
+//      [RESULT_SUCCESS]
+//          * if stamps no longer read the TSC
+//      [RESULT_FAILURE]
+//          * if they did not
+// [lurk_tsc_running]
+//  * determines whether [lurk_stamp] currently reads the TSC
+// [lurk_stamp]
+//  * stamps a record: reads the TSC if [lurk_tsc_start] succeeded, or [LURK_TIMESTAMP_CLOCK]
+//    otherwise; never converts anything
+// [lurk_stamp_to_ns]
+//  * converts a stamp to nanoseconds since the epoch using the live calibration, refreshing it
+//    first when it is more than [LURK_TSC_RECALIBRATE_NS] old
+// [lurk_tsc_to_ns]
+//  * converts a stamp to nanoseconds since the epoch using the calibration [cal] (e.g. one read
+//    back from a binary log); stamps without [LURK_STAMP_TSC] are returned as they are
+uint64_t lurk_timestamp(void);
+size_t lurk_format_timestamp(char* buf, uint64_t ns);
+result_t lurk_tsc_start(void);
+result_t lurk_tsc_stop(void);
+bool lurk_tsc_running(void);
+uint64_t lurk_stamp(void);
+uint64_t lurk_stamp_to_ns(uint64_t stamp);
+uint64_t lurk_tsc_to_ns(const struct lurk_tsc_calibration* cal, uint64_t stamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LURK_TIMESTAMP_H
@@ -0,0 +1,485 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "async.h"
+#include "internal.h"
+
+#define ASYNC_BATCH_MAX 64
+#define ASYNC_CACHE_LINE 64
+
+// the top bit of [head] marks the ring as closed; producers never reserve a slot while it is set,
+// which is also how they tell whether the asynchronous mode is running at all
+#define ASYNC_CLOSED ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 1))
+
+// Each slot carries a sequence number (Vyukov's bounded queue): it equals the slot's position when
+// the slot is free for the producer reserving that position, and the position plus one once the
+// record is published and ready for the writer. The writer hands the slot back to the producers
+// for the next lap by setting it to the position plus the capacity.
+//
+// Text records are stamped by the producer, but the writer fills in their time just before writing
+// them, so converting a TSC stamp (see [timestamp.h]) never happens on the producing thread.
+struct async_slot {
+    atomic_size_t seq;
+    int fd;
+    size_t len;
+    uint64_t stamp; // [0] for records that are written as they are
+    char data[LURK_ASYNC_RECORD_SIZE];
+};
+
+static struct async_slot* slots = NULL;
+static size_t mask = 0;
+
+static _Alignas(ASYNC_CACHE_LINE) atomic_size_t head = ASYNC_CLOSED;
+static _Alignas(ASYNC_CACHE_LINE) size_t tail = 0;
+static _Alignas(ASYNC_CACHE_LINE) atomic_size_t written = 0;
+static atomic_size_t dropped = 0;
+static size_t dropped_reported = 0;
+
+static atomic_bool writer_idle = false;
+static sem_t wake;
+static pthread_t writer;
+
+static atomic_int flushers = 0;
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool hooks_registered = false;
+
+// With io_uring (see [uring.c]) one batch is in flight while the writer gathers the next, so the
+// slots of the batch in flight are only handed back once it completes: [tail] is where the next
+// batch starts and [released] where the slots still owned by the writer start.
+static bool use_uring = true;
+static size_t released = 0;
+static struct iovec inflight[ASYNC_BATCH_MAX];
+static int inflight_count = 0;
+static int inflight_fd = -1;
+
+enum async_reserve {
+    ASYNC_RESERVED,
+    ASYNC_FULL,
+    ASYNC_NOT_RUNNING,
+};
+
+static enum async_reserve async_reserve(size_t* pos) {
+    size_t p = atomic_load_explicit(&head, memory_order_acquire);
+
+    for (;;) {
+        if (p & ASYNC_CLOSED) return ASYNC_NOT_RUNNING;
+
+        struct async_slot* slot = &slots[p & mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - p);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&head, &p, p + 1,
+                                                      memory_order_acq_rel,
+                                                      memory_order_acquire)) {
+                *pos = p;
+                return ASYNC_RESERVED;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return ASYNC_FULL;
+        } else {
+            p = atomic_load_explicit(&head, memory_order_acquire);
+        }
+    }
+}
+
+// The producer stores the sequence number and then loads [writer_idle], while the writer stores
+// [writer_idle] and then loads the sequence number. Each side needs a full fence between the two,
+// or both may read the old values, and the writer would go to sleep on a published record.
+static void async_publish(size_t pos) {
+    atomic_store_explicit(&slots[pos & mask].seq, pos + 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load(&writer_idle) && atomic_exchange(&writer_idle, false)) sem_post(&wake);
+}
+
+bool async_push_log(const struct config_snapshot* config,
+                    result_t result, const char* restrict fmt, va_list args) {
+    size_t pos;
+    switch (async_reserve(&pos)) {
+        case (ASYNC_NOT_RUNNING): return false;
+        case (ASYNC_FULL): return true;
+        case (ASYNC_RESERVED): break;
+    }
+
+    struct async_slot* slot = &slots[pos & mask];
+    slot->fd = STDOUT_FILENO;
+    slot->stamp = lurk_stamp();
+    size_t len = render_log(slot->data, sizeof(slot->data), config, result, fmt, args);
+    slot->len = len < sizeof(slot->data) ? len : sizeof(slot->data) - 1;
+
+    async_publish(pos);
+    return true;
+}
+
+bool async_push_err(const struct config_snapshot* config, result_t result,
+                    const char* caller, const char* loc,
+                    const char* restrict fmt, va_list args) {
+    size_t pos;
+    switch (async_reserve(&pos)) {
+        case (ASYNC_NOT_RUNNING): return false;
+        case (ASYNC_FULL): return true;
+        case (ASYNC_RESERVED): break;
+    }
+
+    struct async_slot* slot = &slots[pos & mask];
+    slot->fd = STDERR_FILENO;
+    slot->stamp = lurk_stamp();
+    size_t len = render_err(slot->data, sizeof(slot->data), config, result,
+                            caller, loc, fmt, args);
+    slot->len = len < sizeof(slot->data) ? len : sizeof(slot->data) - 1;
+
+    async_publish(pos);
+    return true;
+}
+
+bool async_push_bytes(int fd, const void* data, size_t len) {
+    size_t pos;
+    switch (async_reserve(&pos)) {
+        case (ASYNC_NOT_RUNNING): return false;
+        case (ASYNC_FULL): return true;
+        case (ASYNC_RESERVED): break;
+    }
+
+    struct async_slot* slot = &slots[pos & mask];
+    if (len > sizeof(slot->data)) len = sizeof(slot->data);
+
+    slot->fd = fd;
+    slot->len = len;
+    slot->stamp = 0;
+    memcpy(slot->data, data, len);
+
+    async_publish(pos);
+    return true;
+}
+
+// writes the whole batch, resuming after partial writes; on a real output error the rest of the
+// batch is dropped since there is nobody on this thread to report it to
+static void async_write(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return;
+        }
+
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+// hands the slots before [pos] back to the producers
+static void async_release(size_t pos) {
+    for (size_t p = released; p != pos; p++)
+        atomic_store_explicit(&slots[p & mask].seq, p + mask + 1, memory_order_release);
+
+    released = pos;
+    atomic_store(&written, pos);
+
+    if (atomic_load(&flushers) > 0) {
+        pthread_mutex_lock(&flush_lock);
+        pthread_cond_broadcast(&flush_cond);
+        pthread_mutex_unlock(&flush_lock);
+    }
+}
+
+// waits for the batch in flight, writes whatever it left over, and hands its slots back
+static void async_complete(void) {
+    if (inflight_count == 0) return;
+
+    int done = uring_wait(inflight);
+    if (done < inflight_count) async_write(inflight_fd, inflight + done, inflight_count - done);
+
+    inflight_count = 0;
+    async_release(tail);
+}
+
+static void async_report_drops(void) {
+    size_t total = atomic_load_explicit(&dropped, memory_order_relaxed);
+    if (total == dropped_reported) return;
+
+    char notice[96];
+    int n = snprintf(notice, sizeof(notice), "lurk: async ring full, dropped %zu records\n",
+                     total - dropped_reported);
+    dropped_reported = total;
+
+    // the notice must not overtake records already submitted
+    async_complete();
+
+    struct iovec iov = { .iov_base = notice, .iov_len = (size_t)n };
+    if (n > 0) async_write(STDERR_FILENO, &iov, 1);
+}
+
+static bool async_pending(void) {
+    size_t seq = atomic_load_explicit(&slots[tail & mask].seq, memory_order_acquire);
+    return seq == tail + 1;
+}
+
+// writes out one batch of consecutive published records going to the same descriptor and returns
+// the number of records in it; with io_uring, the batch is only submitted and the one before it
+// completed, and once there is nothing left to submit the last one is completed too
+static size_t async_drain(void) {
+    struct iovec iov[ASYNC_BATCH_MAX];
+    int count = 0;
+    int fd = -1;
+    size_t pos = tail;
+
+    while (count < ASYNC_BATCH_MAX) {
+        struct async_slot* slot = &slots[pos & mask];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) break;
+        if (count > 0 && slot->fd != fd) break;
+
+        if (slot->stamp != 0) render_stamp(slot->data, slot->stamp);
+
+        fd = slot->fd;
+        iov[count].iov_base = slot->data;
+        iov[count].iov_len = slot->len;
+        count++;
+        pos++;
+    }
+
+    if (count == 0) {
+        async_complete();
+        return 0;
+    }
+
+    if (uring_running()) {
+        async_complete();
+
+        memcpy(inflight, iov, (size_t)count * sizeof(*iov));
+        inflight_count = count;
+        inflight_fd = fd;
+        uring_write(fd, inflight, count);
+
+        tail = pos;
+    } else {
+        async_write(fd, iov, count);
+
+        tail = pos;
+        async_release(pos);
+    }
+
+    return (size_t)count;
+}
+
+static void* async_writer(void* arg) {
+    (void)arg;
+
+    for (;;) {
+        if (async_drain() > 0) {
+            async_report_drops();
+            continue;
+        }
+
+        size_t h = atomic_load(&head);
+        if (h & ASYNC_CLOSED) {
+            // no more slots can be reserved, so once everything reserved is written we are done;
+            // otherwise a producer is still rendering into the slot at [tail]
+            if (tail == (h & ~ASYNC_CLOSED)) break;
+            sched_yield();
+            continue;
+        }
+
+        atomic_store(&writer_idle, true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (async_pending() || (atomic_load(&head) & ASYNC_CLOSED)) {
+            atomic_store(&writer_idle, false);
+            continue;
+        }
+
+        while (sem_wait(&wake) != 0 && errno == EINTR) {}
+        atomic_store(&writer_idle, false);
+    }
+
+    async_report_drops();
+    return NULL;
+}
+
+static void async_atexit(void) {
+    lurk_async_stop();
+}
+
+static void async_prefork(void) {
+    pthread_mutex_lock(&control_lock);
+}
+
+static void async_postfork_parent(void) {
+    pthread_mutex_unlock(&control_lock);
+}
+
+// the writer thread does not exist in the child and slots reserved by other parent threads will
+// never be published there, so the child starts over with an empty, stopped ring
+static void async_postfork_child(void) {
+    if (slots != NULL) {
+        for (size_t i = 0; i <= mask; i++) atomic_init(&slots[i].seq, i);
+    }
+
+    // the ring's mappings were copied into the child, but nothing will ever complete there
+    uring_stop();
+    inflight_count = 0;
+
+    atomic_init(&head, ASYNC_CLOSED);
+    tail = 0;
+    released = 0;
+    atomic_init(&written, 0);
+    atomic_init(&writer_idle, false);
+    atomic_init(&flushers, 0);
+
+    sem_init(&wake, 0, 0);
+    pthread_mutex_init(&flush_lock, NULL);
+    pthread_cond_init(&flush_cond, NULL);
+    pthread_mutex_init(&control_lock, NULL);
+}
+
+result_t lurk_async_start(size_t capacity) {
+    if ((capacity & (capacity - 1)) != 0)
+        return RETURN_BAD_PARAM_MSG(capacity, "Must be a power of two.");
+
+    pthread_mutex_lock(&control_lock);
+
+    if (capacity == 0) capacity = (slots != NULL) ? mask + 1 : LURK_ASYNC_DEFAULT_CAPACITY;
+
+    if (!(atomic_load(&head) & ASYNC_CLOSED)) {
+        pthread_mutex_unlock(&control_lock);
+        return RESULT_FAILURE;
+    }
+
+    // producers may still be looking at the ring after a stop, so it is kept for the life of the
+    // process once allocated and its capacity is fixed from then on
+    if (slots != NULL && capacity != mask + 1) {
+        pthread_mutex_unlock(&control_lock);
+        return RETURN_BAD_PARAM_MSG(capacity, "Must match the capacity of the first start.");
+    }
+
+    if (slots == NULL) {
+        struct async_slot* s = malloc(capacity * sizeof(*s));
+        if (s == NULL) {
+            pthread_mutex_unlock(&control_lock);
+            return RETURN_INTERNAL_ERROR_MSG("Could not allocate the async ring.");
+        }
+
+        for (size_t i = 0; i < capacity; i++) atomic_init(&s[i].seq, i);
+
+        slots = s;
+        mask = capacity - 1;
+    }
+
+    // the semaphore is never destroyed: a producer that published the last record before a stop
+    // may still be posting to it after the writer is gone
+    if (!hooks_registered) {
+        sem_init(&wake, 0, 0);
+        if (atexit(&async_atexit) != 0 ||
+            pthread_atfork(&async_prefork, &async_postfork_parent, &async_postfork_child) != 0) {
+            pthread_mutex_unlock(&control_lock);
+            return RETURN_INTERNAL_ERROR_MSG("Could not register the async exit and fork hooks.");
+        }
+        hooks_registered = true;
+    }
+
+    atomic_store(&writer_idle, false);
+
+    if (use_uring) uring_start(slots, (mask + 1) * sizeof(*slots));
+
+    size_t pos = tail;
+    atomic_store(&head, pos);
+
+    if (pthread_create(&writer, NULL, &async_writer, NULL) != 0) {
+        atomic_store(&head, pos | ASYNC_CLOSED);
+        uring_stop();
+        pthread_mutex_unlock(&control_lock);
+        return RETURN_INTERNAL_ERROR_MSG("Could not create the async writer thread.");
+    }
+
+    pthread_mutex_unlock(&control_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_async_stop(void) {
+    pthread_mutex_lock(&control_lock);
+
+    size_t h = atomic_fetch_or(&head, ASYNC_CLOSED);
+    if (h & ASYNC_CLOSED) {
+        pthread_mutex_unlock(&control_lock);
+        return RESULT_FAILURE;
+    }
+
+    sem_post(&wake);
+    pthread_join(writer, NULL);
+    uring_stop();
+
+    pthread_mutex_unlock(&control_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_async_set_io_uring(bool enabled) {
+    pthread_mutex_lock(&control_lock);
+
+    if (!(atomic_load(&head) & ASYNC_CLOSED)) {
+        pthread_mutex_unlock(&control_lock);
+        return RESULT_FAILURE;
+    }
+
+    use_uring = enabled;
+
+    pthread_mutex_unlock(&control_lock);
+    return RESULT_SUCCESS;
+}
+
+bool lurk_async_io_uring(void) {
+    pthread_mutex_lock(&control_lock);
+    bool running = !(atomic_load(&head) & ASYNC_CLOSED) && uring_running();
+    pthread_mutex_unlock(&control_lock);
+
+    return running;
+}
+
+result_t lurk_async_flush(void) {
+    size_t target = atomic_load(&head);
+    if (target & ASYNC_CLOSED) return RESULT_FAILURE;
+
+    atomic_fetch_add(&flushers, 1);
+
+    // the writer may have gone idle without seeing the last records, so wake it to look again
+    sem_post(&wake);
+
+    pthread_mutex_lock(&flush_lock);
+    while (atomic_load(&written) < target && !(atomic_load(&head) & ASYNC_CLOSED))
+        pthread_cond_wait(&flush_cond, &flush_lock);
+    pthread_mutex_unlock(&flush_lock);
+
+    atomic_fetch_sub(&flushers, 1);
+    return RESULT_SUCCESS;
+}
+
+bool lurk_async_running(void) {
+    return !(atomic_load(&head) & ASYNC_CLOSED);
+}
+
+size_t lurk_async_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
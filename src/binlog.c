@@ -0,0 +1,369 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lurk.h"
+#include "binlog.h"
+#include "timestamp.h"
+#include "internal.h"
+
+// generations are even; the low bit marks a site whose definition is being written
+#define GEN_BUSY 1u
+
+// the top bit of [binlog_users] marks the binary log as stopped; every producer counts itself in the
+// other bits while it writes, so [lurk_binlog_stop] knows when the descriptor is no longer used,
+// like in [mmap.c]
+#define BINLOG_CLOSED ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 1))
+
+#define BINLOG_CACHE_LINE 64
+
+enum site_state {
+    SITE_EMPTY,
+    SITE_CLAIMED,
+    SITE_READY,
+};
+
+// Call sites are interned into a fixed open-addressing table keyed by their caller, location, and
+// format pointers (the format alone is not enough since identical literals are merged). A site's
+// identifier is its index plus one. [emitted] holds the generation of the binary log its definition
+// was last written to, so every new log gets the definitions it needs.
+struct site {
+    atomic_uint state;
+    atomic_uint emitted;
+    const char* caller;
+    const char* loc;
+    const char* fmt;
+};
+
+static struct site sites[LURK_BINLOG_SITES];
+
+static _Alignas(BINLOG_CACHE_LINE) atomic_size_t binlog_users = BINLOG_CLOSED;
+static int binlog_fd = -1;
+static atomic_uint binlog_gen = 0;
+// the log generation and TSC calibration generation of the last calibration written to the log
+static _Atomic uint64_t clock_emitted = 0;
+static pthread_mutex_t binlog_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool binlog_enter(void) {
+    if (atomic_fetch_add_explicit(&binlog_users, 1, memory_order_acquire) & BINLOG_CLOSED) {
+        atomic_fetch_sub_explicit(&binlog_users, 1, memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+static void binlog_exit(void) {
+    atomic_fetch_sub_explicit(&binlog_users, 1, memory_order_release);
+}
+
+struct record {
+    unsigned char buf[LURK_ASYNC_RECORD_SIZE];
+    size_t len;
+};
+
+static void put(struct record* r, const void* data, size_t n) {
+    if (n > sizeof(r->buf) - r->len) n = sizeof(r->buf) - r->len;
+    memcpy(r->buf + r->len, data, n);
+    r->len += n;
+}
+
+static void put_u8(struct record* r, uint8_t v) { put(r, &v, sizeof(v)); }
+static void put_u16(struct record* r, uint16_t v) { put(r, &v, sizeof(v)); }
+static void put_u32(struct record* r, uint32_t v) { put(r, &v, sizeof(v)); }
+static void put_u64(struct record* r, uint64_t v) { put(r, &v, sizeof(v)); }
+
+// strings are truncated to what is left of the record
+static void put_str(struct record* r, const char* s) {
+    if (s == NULL) s = "(null)";
+
+    size_t n = strlen(s);
+    size_t room = sizeof(r->buf) - r->len;
+    room = room > sizeof(uint16_t) ? room - sizeof(uint16_t) : 0;
+    if (n > room) n = room;
+    if (n > UINT16_MAX) n = UINT16_MAX;
+
+    put_u16(r, (uint16_t)n);
+    put(r, s, n);
+}
+
+static void record_begin(struct record* r, enum lurk_binlog_kind kind) {
+    r->len = sizeof(uint16_t);
+    put_u8(r, (uint8_t)kind);
+}
+
+static void record_end(struct record* r) {
+    uint16_t size = (uint16_t)r->len;
+    memcpy(r->buf, &size, sizeof(size));
+}
+
+static size_t site_hash(const char* caller, const char* loc, const char* fmt) {
+    uintptr_t h = (uintptr_t)caller * 31u + (uintptr_t)loc;
+    h = h * 31u + (uintptr_t)fmt;
+    h ^= h >> 17;
+    h *= 0x9e3779b97f4a7c15u;
+    return (size_t)(h ^ (h >> 29));
+}
+
+// returns the identifier of the site, or [0] if the table is full
+static uint32_t site_intern(const char* caller, const char* loc, const char* fmt) {
+    size_t i = site_hash(caller, loc, fmt) % LURK_BINLOG_SITES;
+
+    for (size_t probe = 0; probe < LURK_BINLOG_SITES; probe++) {
+        struct site* s = &sites[i];
+        unsigned state = atomic_load_explicit(&s->state, memory_order_acquire);
+
+        if (state == SITE_EMPTY) {
+            if (atomic_compare_exchange_strong(&s->state, &state, SITE_CLAIMED)) {
+                s->caller = caller;
+                s->loc = loc;
+                s->fmt = fmt;
+                atomic_store_explicit(&s->state, SITE_READY, memory_order_release);
+                return (uint32_t)i + 1;
+            }
+        }
+
+        while (state == SITE_CLAIMED) {
+            sched_yield();
+            state = atomic_load_explicit(&s->state, memory_order_acquire);
+        }
+
+        if (state == SITE_READY && s->caller == caller && s->loc == loc && s->fmt == fmt)
+            return (uint32_t)i + 1;
+
+        if (state != SITE_EMPTY) i = (i + 1) % LURK_BINLOG_SITES;
+    }
+
+    return 0;
+}
+
+// makes sure the definition of site [id] has been written to the current log before any event
+// referencing it; the first thread to get here writes it while any others wait. It goes through
+// the asynchronous ring like the events, so it is queued ahead of the events using it and never
+// lands in the middle of a batch the writer is sending. Returns false if the ring was full: the
+// site is not marked as written, and the caller's event carries its site inline instead.
+static bool site_define(int fd, unsigned gen, uint32_t id) {
+    struct site* s = &sites[id - 1];
+    unsigned emitted = atomic_load_explicit(&s->emitted, memory_order_acquire);
+
+    while (emitted != gen) {
+        if (!(emitted & GEN_BUSY) &&
+            atomic_compare_exchange_strong(&s->emitted, &emitted, gen | GEN_BUSY)) {
+            struct record r;
+            record_begin(&r, LURK_BINLOG_SITE);
+            put_u32(&r, id);
+            put_str(&r, s->caller);
+            put_str(&r, s->loc);
+            put_str(&r, s->fmt);
+            record_end(&r);
+
+            size_t dropped = lurk_async_dropped();
+            bool defined = true;
+            if (!async_push_bytes(fd, r.buf, r.len)) write_record(fd, (const char*)r.buf, r.len);
+            else defined = lurk_async_dropped() == dropped;
+
+            atomic_store_explicit(&s->emitted, defined ? gen : emitted, memory_order_release);
+            return defined;
+        }
+
+        sched_yield();
+        emitted = atomic_load_explicit(&s->emitted, memory_order_acquire);
+    }
+
+    return true;
+}
+
+// arguments that no longer fit in the record are left out, and the count is patched to match
+static void put_args(struct record* r, size_t nargs, const struct lurk_arg* args) {
+    size_t count_at = r->len;
+    uint8_t count = 0;
+    put_u8(r, 0);
+
+    for (size_t i = 0; i < nargs && count < UINT8_MAX; i++) {
+        if (sizeof(r->buf) - r->len < sizeof(uint8_t) + sizeof(uint64_t)) break;
+
+        put_u8(r, (uint8_t)args[i].type);
+
+        switch (args[i].type) {
+            case (LURK_ARG_INT): put_u64(r, (uint64_t)args[i].i); break;
+            case (LURK_ARG_UINT): put_u64(r, args[i].u); break;
+            case (LURK_ARG_DOUBLE): put(r, &args[i].d, sizeof(args[i].d)); break;
+            case (LURK_ARG_STR): put_str(r, args[i].s); break;
+            case (LURK_ARG_PTR): put_u64(r, (uint64_t)(uintptr_t)args[i].p); break;
+        }
+
+        count++;
+    }
+
+    r->buf[count_at] = count;
+}
+
+// makes sure a calibration for TSC stamps has been written to the current log since the TSC was
+// last recalibrated; writing it twice from racing threads is harmless. Like a site definition it
+// goes through the asynchronous ring with the events: the decoder converts every event with the
+// last calibration before it, so it must not overtake events still queued under the previous one.
+// If the ring was full it is not marked as written, and the next event tries again.
+static void clock_define(int fd, unsigned gen, uint64_t stamp) {
+    struct lurk_tsc_calibration cal;
+    unsigned tsc_gen = tsc_refresh(stamp, &cal);
+
+    uint64_t key = (uint64_t)gen << 32 | tsc_gen;
+    if (atomic_load_explicit(&clock_emitted, memory_order_acquire) == key) return;
+
+    struct record r;
+    record_begin(&r, LURK_BINLOG_CLOCK);
+    put_u64(&r, cal.tsc);
+    put_u64(&r, cal.ns);
+    put_u64(&r, cal.mult);
+    put_u32(&r, cal.shift);
+    record_end(&r);
+
+    size_t dropped = lurk_async_dropped();
+    if (!async_push_bytes(fd, r.buf, r.len)) write_record(fd, (const char*)r.buf, r.len);
+    else if (lurk_async_dropped() != dropped) return;
+
+    atomic_store_explicit(&clock_emitted, key, memory_order_release);
+}
+
+static void binlog_event(int fd, unsigned gen, result_t result,
+                         const char* caller, const char* loc,
+                         const char* fmt, size_t nargs, const struct lurk_arg* args) {
+    uint64_t now = lurk_stamp();
+    uint32_t id = site_intern(caller, loc, fmt);
+
+    if (now & LURK_STAMP_TSC) clock_define(fd, gen, now);
+
+    struct record r;
+    if (id != 0 && site_define(fd, gen, id)) {
+        record_begin(&r, LURK_BINLOG_EVENT);
+        put_u32(&r, id);
+    } else {
+        record_begin(&r, LURK_BINLOG_INLINE_EVENT);
+        put_str(&r, caller);
+        put_str(&r, loc);
+        put_str(&r, fmt);
+    }
+
+    put_u32(&r, (uint32_t)result);
+    put_u64(&r, now);
+    put_args(&r, nargs, args);
+    record_end(&r);
+
+    if (!async_push_bytes(fd, r.buf, r.len)) write_record(fd, (const char*)r.buf, r.len);
+}
+
+// hands already formatted text to an error function, which only takes a format and its arguments
+static void call_err_fn(result_err_fn* err_fn, result_t result,
+                        const char* caller, const char* loc, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    (*err_fn)(result, caller, loc, fmt, args);
+    va_end(args);
+}
+
+result_t lurk_err_args(result_t result,
+                       const char* caller, const char* loc,
+                       const char* fmt, size_t nargs, const struct lurk_arg* args) {
+    if (fmt == NULL) return result;
+
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (enabled & LURK_ENABLED_COUNT) counters_bump(result, true);
+    if (enabled & LURK_ENABLED_RECORD) recorder_record_args(result, caller, loc, fmt, nargs, args);
+    if (!(enabled & LURK_ENABLED_ERR)) return result;
+
+    const struct config_snapshot* config = config_enter();
+    if (!config->do_err) {
+        config_exit();
+        return result;
+    }
+
+    if (binlog_enter()) {
+        unsigned gen = atomic_load_explicit(&binlog_gen, memory_order_relaxed);
+        binlog_event(binlog_fd, gen, result, caller, loc, fmt, nargs, args);
+        binlog_exit();
+        config_exit();
+        return result;
+    }
+
+    char stack[LURK_ASYNC_RECORD_SIZE];
+    char* msg = stack;
+
+    size_t len = lurk_format_args(stack, sizeof(stack), fmt, nargs, args);
+    if (len >= sizeof(stack)) {
+        char* heap = malloc(len + 1);
+        if (heap != NULL) {
+            lurk_format_args(heap, len + 1, fmt, nargs, args);
+            msg = heap;
+        }
+    }
+
+    call_err_fn(config->err_fn, result, caller, loc, "%s", msg);
+    config_exit();
+
+    if (msg != stack) free(msg);
+    return result;
+}
+
+result_t lurk_err_site_args(result_t result, const lurk_site_t* site,
+                            size_t nargs, const struct lurk_arg* args) {
+    if (site == NULL) return result;
+
+    if (__atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED) & LURK_ENABLED_HITS) site_hit(site);
+    return lurk_err_args(result, site->caller, site->loc, site->fmt, nargs, args);
+}
+
+result_t lurk_binlog_start(int fd) {
+    if (fd < 0) return RETURN_BAD_PARAM_MSG(fd, "Must not be negative.");
+
+    pthread_mutex_lock(&binlog_lock);
+
+    if (!(atomic_load(&binlog_users) & BINLOG_CLOSED)) {
+        pthread_mutex_unlock(&binlog_lock);
+        return RESULT_FAILURE;
+    }
+
+    struct record r;
+    record_begin(&r, LURK_BINLOG_HEADER);
+    put(&r, LURK_BINLOG_MAGIC, strlen(LURK_BINLOG_MAGIC));
+    put_u32(&r, LURK_BINLOG_BYTE_ORDER);
+    const struct config_snapshot* config = config_enter();
+    put_str(&r, config->projname);
+    put_str(&r, config->prefix);
+    put_str(&r, config->postfix);
+    config_exit();
+    record_end(&r);
+
+    write_record(fd, (const char*)r.buf, r.len);
+
+    binlog_fd = fd;
+    atomic_fetch_add(&binlog_gen, 2);
+
+    // clearing the closed bit is what lets producers in
+    atomic_fetch_and_explicit(&binlog_users, ~BINLOG_CLOSED, memory_order_release);
+
+    pthread_mutex_unlock(&binlog_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_binlog_stop(void) {
+    pthread_mutex_lock(&binlog_lock);
+
+    if (atomic_fetch_or(&binlog_users, BINLOG_CLOSED) & BINLOG_CLOSED) {
+        pthread_mutex_unlock(&binlog_lock);
+        return RESULT_FAILURE;
+    }
+
+    // a producer that got in before the closed bit was set may still be writing to the descriptor
+    while (atomic_load(&binlog_users) != BINLOG_CLOSED) sched_yield();
+    binlog_fd = -1;
+
+    pthread_mutex_unlock(&binlog_lock);
+
+    lurk_async_flush();
+    return RESULT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lurk.h"
+#include "breadcrumb.h"
+#include "internal.h"
+
+static _Thread_local struct lurk_breadcrumbs chain = {0};
+
+// copies a string argument into the text of the chain, truncating it to what is left
+static const char* keep_string(struct lurk_breadcrumbs* c, const char* s) {
+    if (s == NULL) s = "(null)";
+
+    size_t room = sizeof(c->text) - c->textlen;
+    if (room == 0) return "";
+
+    size_t n = strlen(s);
+    if (n > room - 1) n = room - 1;
+
+    char* copy = c->text + c->textlen;
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    c->textlen += n + 1;
+
+    return copy;
+}
+
+result_t lurk_crumb(result_t result, const char* caller, const char* loc, const char* fmt,
+                    bool hop, size_t nargs, const struct lurk_arg* args) {
+    if (fmt == NULL) return result;
+
+    // while counting or recording, the chain is kept even if errors are disabled, and counted and
+    // recorded once it is logged
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (!(enabled & (LURK_ENABLED_ERR | LURK_ENABLED_COUNT | LURK_ENABLED_RECORD))) return result;
+
+    struct lurk_breadcrumbs* c = &chain;
+
+    if (!hop) {
+        c->depth = 0;
+        c->dropped = 0;
+        c->textlen = 0;
+    }
+
+    if (c->depth == LURK_BREADCRUMB_DEPTH) {
+        c->dropped++;
+        return result;
+    }
+
+    struct lurk_breadcrumb* frame = &c->frames[c->depth++];
+    frame->result = result;
+    frame->caller = caller;
+    frame->loc = loc;
+    frame->fmt = fmt;
+    frame->nargs = nargs < LURK_BREADCRUMB_ARGS ? nargs : LURK_BREADCRUMB_ARGS;
+
+    for (size_t i = 0; i < frame->nargs; i++) {
+        frame->args[i] = args[i];
+        if (args[i].type == LURK_ARG_STR) frame->args[i].s = keep_string(c, args[i].s);
+    }
+
+    return result;
+}
+
+result_t lurk_crumb_site(result_t result, const lurk_site_t* site,
+                         bool hop, size_t nargs, const struct lurk_arg* args) {
+    if (site == NULL) return result;
+
+    if (__atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED) & LURK_ENABLED_HITS) site_hit(site);
+    return lurk_crumb(result, site->caller, site->loc, site->fmt, hop, nargs, args);
+}
+
+const struct lurk_breadcrumbs* lurk_last_error(void) {
+    return &chain;
+}
+
+// like [lurk_format_args], but appends at [len] and advances it by the complete output length
+static void append_args(char* buf, size_t size, size_t* len,
+                        const char* fmt, size_t nargs, const struct lurk_arg* args) {
+    size_t at = *len < size ? *len : size;
+    *len += lurk_format_args(size > at ? buf + at : NULL, size - at, fmt, nargs, args);
+}
+
+size_t lurk_format_error(char* buf, size_t size) {
+    const struct lurk_breadcrumbs* c = &chain;
+    size_t len = 0;
+
+    if (size > 0) buf[0] = '\0';
+
+    for (size_t i = 0; i < c->depth; i++) {
+        const struct lurk_breadcrumb* frame = &c->frames[i];
+
+        if (i > 0) {
+            struct lurk_arg hop[3] = {
+                lurk_arg_uint((unsigned)frame->result),
+                lurk_arg_str(frame->caller != NULL ? frame->caller : "(unknown)"),
+                lurk_arg_str(frame->loc != NULL ? frame->loc : "???"),
+            };
+            append_args(buf, size, &len, " <- %08x [%s.%s] ", 3, hop);
+        }
+
+        append_args(buf, size, &len, frame->fmt, frame->nargs, frame->args);
+    }
+
+    if (c->dropped > 0) {
+        struct lurk_arg dropped = lurk_arg_uint(c->dropped);
+        append_args(buf, size, &len, " <- (%zu more)", 1, &dropped);
+    }
+
+    return len;
+}
+
+result_t lurk_log_error(void) {
+    struct lurk_breadcrumbs* c = &chain;
+    if (c->depth == 0) return RESULT_SUCCESS;
+
+    char stack[LURK_ASYNC_RECORD_SIZE];
+    char* msg = stack;
+
+    size_t len = lurk_format_error(stack, sizeof(stack));
+    if (len >= sizeof(stack)) {
+        char* heap = malloc(len + 1);
+        if (heap != NULL) {
+            lurk_format_error(heap, len + 1);
+            msg = heap;
+        }
+    }
+
+    const struct lurk_breadcrumb* first = &c->frames[0];
+    result_t last = c->frames[c->depth - 1].result;
+
+    // the chain is cleared first, so a custom [result_err_fn] using the error macros starts afresh
+    result_t result = first->result;
+    const char* caller = first->caller;
+    const char* loc = first->loc;
+    lurk_clear_error();
+
+    lurk_err(result, caller, loc, "%s", msg);
+
+    if (msg != stack) free(msg);
+    return last;
+}
+
+void lurk_clear_error(void) {
+    chain.depth = 0;
+    chain.dropped = 0;
+    chain.textlen = 0;
+}
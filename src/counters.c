@@ -0,0 +1,369 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "counters.h"
+#include "internal.h"
+
+#define COUNTERS_CACHE_LINE 64
+#define COUNTERS_SLOTS (2 * LURK_COUNTERS_CODES)
+#define COUNTERS_OTHER LURK_COUNTERS_CODES
+
+// A code is mapped to the index of its counter by an open-addressed table of words holding the code
+// in the upper half and the index plus one in the lower half, [0] marking a free slot. Slots are
+// only ever filled, under [counter_lock], so the lookup on the counting path is lock-free and the
+// table stays read-only once every code in use has been seen. Codes beyond [LURK_COUNTERS_CODES]
+// still get a slot, mapped to the shared [COUNTERS_OTHER] counter, so they do not take the lock
+// every time either.
+static uint64_t counter_slots[COUNTERS_SLOTS];
+static result_t counter_codes[LURK_COUNTERS_CODES];
+static atomic_size_t counter_ncodes = 0;
+static pthread_mutex_t counter_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Each thread counts in a shard of its own that only it writes, so an increment is a plain load
+// and store. Shards are never freed: the shard of an exited thread keeps its counts and is taken
+// over by the next thread that starts counting.
+struct counter_shard {
+    _Alignas(COUNTERS_CACHE_LINE) uint64_t counts[LURK_COUNTERS_CODES + 1][2];
+    struct counter_shard* next;
+    atomic_bool in_use;
+};
+
+static _Atomic(struct counter_shard*) counter_shards = NULL;
+static _Thread_local struct counter_shard* counter_shard = NULL;
+static pthread_key_t counter_key;
+static pthread_once_t counter_once = PTHREAD_ONCE_INIT;
+
+static char export_path[LURK_COUNTERS_PATH_MAX];
+static unsigned export_period = 0;
+static bool export_running = false;
+static pthread_t export_thread;
+static pthread_mutex_t export_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t export_cond = PTHREAD_COND_INITIALIZER;
+
+// serializes starting and stopping the exporter; [export_lock] only guards [export_running]
+static pthread_mutex_t export_control = PTHREAD_MUTEX_INITIALIZER;
+
+static void counter_release_shard(void* shard) {
+    struct counter_shard* s = shard;
+
+    if (counter_shard == s) counter_shard = NULL;
+    atomic_store_explicit(&s->in_use, false, memory_order_release);
+}
+
+// a forked child only has the forking thread, so the shards of every other thread are free again
+static void counter_postfork_child(void) {
+    struct counter_shard* own = counter_shard;
+
+    for (struct counter_shard* s = atomic_load(&counter_shards); s != NULL; s = s->next) {
+        if (s != own) counter_release_shard(s);
+    }
+
+    pthread_mutex_init(&counter_lock, NULL);
+}
+
+static void counter_init_key(void) {
+    if (pthread_key_create(&counter_key, &counter_release_shard) != 0) abort();
+    if (pthread_atfork(NULL, NULL, &counter_postfork_child) != 0) abort();
+}
+
+// claims a free shard for the calling thread, taking over those of exited threads
+static struct counter_shard* counter_register(void) {
+    pthread_once(&counter_once, &counter_init_key);
+
+    struct counter_shard* s = atomic_load_explicit(&counter_shards, memory_order_acquire);
+    for (; s != NULL; s = s->next) {
+        bool unused = false;
+        if (atomic_compare_exchange_strong(&s->in_use, &unused, true)) break;
+    }
+
+    if (s == NULL) {
+        s = aligned_alloc(COUNTERS_CACHE_LINE, sizeof(*s));
+        if (s == NULL) abort();
+
+        memset(s->counts, 0, sizeof(s->counts));
+        atomic_init(&s->in_use, true);
+        s->next = atomic_load_explicit(&counter_shards, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&counter_shards, &s->next, s,
+                                                      memory_order_release,
+                                                      memory_order_relaxed)) {}
+    }
+
+    pthread_setspecific(counter_key, s);
+    return s;
+}
+
+static size_t counter_hash(result_t result) {
+    return (size_t)((uint32_t)result * UINT32_C(0x9e3779b1) >> 8) % COUNTERS_SLOTS;
+}
+
+// the index of the counter of [result] if it has a slot, or [SIZE_MAX] with the free slot to fill
+// in [*free] if it has none yet ([COUNTERS_SLOTS] if the table is full)
+static size_t counter_find(result_t result, size_t* free) {
+    size_t i = counter_hash(result);
+
+    for (size_t probes = 0; probes < COUNTERS_SLOTS; probes++) {
+        uint64_t slot = __atomic_load_n(&counter_slots[i], __ATOMIC_ACQUIRE);
+        if (slot == 0) {
+            *free = i;
+            return SIZE_MAX;
+        }
+        if ((uint32_t)(slot >> 32) == (uint32_t)result) return (size_t)(uint32_t)slot - 1;
+
+        i = (i + 1) % COUNTERS_SLOTS;
+    }
+
+    *free = COUNTERS_SLOTS;
+    return SIZE_MAX;
+}
+
+static size_t counter_index(result_t result) {
+    size_t free;
+    size_t index = counter_find(result, &free);
+    if (index != SIZE_MAX) return index;
+    if (free == COUNTERS_SLOTS) return COUNTERS_OTHER;
+
+    pthread_mutex_lock(&counter_lock);
+
+    // another thread may have added the code meanwhile
+    index = counter_find(result, &free);
+    if (index == SIZE_MAX) {
+        index = atomic_load_explicit(&counter_ncodes, memory_order_relaxed);
+        if (index < LURK_COUNTERS_CODES) {
+            counter_codes[index] = result;
+            atomic_store_explicit(&counter_ncodes, index + 1, memory_order_release);
+        } else {
+            index = COUNTERS_OTHER;
+        }
+
+        if (free < COUNTERS_SLOTS) {
+            uint64_t slot = (uint64_t)(uint32_t)result << 32 | (uint64_t)(index + 1);
+            __atomic_store_n(&counter_slots[free], slot, __ATOMIC_RELEASE);
+        }
+    }
+
+    pthread_mutex_unlock(&counter_lock);
+    return index;
+}
+
+void counters_bump(result_t result, bool err) {
+    struct counter_shard* s = counter_shard;
+    if (s == NULL) s = counter_shard = counter_register();
+
+    uint64_t* count = &s->counts[counter_index(result)][err];
+    __atomic_store_n(count, __atomic_load_n(count, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+result_t lurk_counters_enable(bool enable) {
+    config_set_tally(LURK_ENABLED_COUNT, enable);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_counters_snapshot(struct lurk_counters* snapshot) {
+    if (snapshot == NULL) return RETURN_BAD_PARAM_NULL(snapshot);
+
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    size_t n = atomic_load_explicit(&counter_ncodes, memory_order_acquire);
+    snapshot->count = n;
+    for (size_t i = 0; i < n; i++) snapshot->codes[i].result = counter_codes[i];
+
+    struct counter_shard* s = atomic_load_explicit(&counter_shards, memory_order_acquire);
+    for (; s != NULL; s = s->next) {
+        for (size_t i = 0; i < n; i++) {
+            snapshot->codes[i].logs += __atomic_load_n(&s->counts[i][0], __ATOMIC_RELAXED);
+            snapshot->codes[i].errs += __atomic_load_n(&s->counts[i][1], __ATOMIC_RELAXED);
+        }
+        snapshot->other.logs += __atomic_load_n(&s->counts[COUNTERS_OTHER][0], __ATOMIC_RELAXED);
+        snapshot->other.errs += __atomic_load_n(&s->counts[COUNTERS_OTHER][1], __ATOMIC_RELAXED);
+    }
+
+    return RESULT_SUCCESS;
+}
+
+// like [snprintf] into the rest of [buf] past [*len], advancing [*len] by the complete output
+static void counter_append(char* buf, size_t size, size_t* len, const char* fmt, ...) {
+    size_t at = *len < size ? *len : size;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(size > at ? buf + at : NULL, size - at, fmt, args);
+    va_end(args);
+
+    if (n > 0) *len += (size_t)n;
+}
+
+// appends the label value [value], escaped as OpenMetrics requires
+static void counter_append_label(char* buf, size_t size, size_t* len, const char* value) {
+    for (; *value != '\0'; value++) {
+        if (*value == '\\') counter_append(buf, size, len, "\\\\");
+        else if (*value == '"') counter_append(buf, size, len, "\\\"");
+        else if (*value == '\n') counter_append(buf, size, len, "\\n");
+        else counter_append(buf, size, len, "%c", *value);
+    }
+}
+
+static void counter_append_samples(char* buf, size_t size, size_t* len,
+                                   const struct lurk_counter* counter, bool other) {
+    static const char* const kinds[2] = { "log", "err" };
+
+    for (int k = 0; k < 2; k++) {
+        counter_append(buf, size, len, "lurk_results_total{kind=\"%s\",result=\"", kinds[k]);
+        if (other) {
+            counter_append(buf, size, len, "other\"");
+        } else {
+            counter_append(buf, size, len, "%d\"", (int)counter->result);
+
+            const char* name = lurk_result_name(counter->result);
+            if (name != NULL) {
+                counter_append(buf, size, len, ",name=\"");
+                counter_append_label(buf, size, len, name);
+                counter_append(buf, size, len, "\"");
+            }
+        }
+
+        uint64_t value = k == 0 ? counter->logs : counter->errs;
+        counter_append(buf, size, len, "} %llu\n", (unsigned long long)value);
+    }
+}
+
+size_t lurk_counters_format(char* buf, size_t size, const struct lurk_counters* snapshot) {
+    size_t len = 0;
+    if (size > 0) buf[0] = '\0';
+    if (snapshot == NULL) return 0;
+
+    counter_append(buf, size, &len,
+                   "# HELP lurk_results Records logged and errors raised, by result code.\n"
+                   "# TYPE lurk_results counter\n");
+
+    for (size_t i = 0; i < snapshot->count; i++)
+        counter_append_samples(buf, size, &len, &snapshot->codes[i], false);
+    if (snapshot->other.logs > 0 || snapshot->other.errs > 0)
+        counter_append_samples(buf, size, &len, &snapshot->other, true);
+
+    counter_append(buf, size, &len, "# EOF\n");
+    return len;
+}
+
+// writes a snapshot to a temporary file and moves it over [export_path]; an export that fails (e.g.
+// because the disk is full) is simply skipped, and the next one tries again
+static void export_once(void) {
+    struct lurk_counters* snapshot = malloc(sizeof(*snapshot));
+    if (snapshot == NULL) return;
+    lurk_counters_snapshot(snapshot);
+
+    size_t len = lurk_counters_format(NULL, 0, snapshot);
+    char* text = malloc(len + 1);
+    if (text == NULL) {
+        free(snapshot);
+        return;
+    }
+    lurk_counters_format(text, len + 1, snapshot);
+    free(snapshot);
+
+    char tmp[LURK_COUNTERS_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", export_path);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        free(text);
+        return;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, text + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    free(text);
+
+    if (close(fd) != 0 || done < len || rename(tmp, export_path) != 0) unlink(tmp);
+}
+
+static void* export_main(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&export_lock);
+
+    while (export_running) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += export_period / 1000;
+        until.tv_nsec += (long)(export_period % 1000) * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+
+        int waited = 0;
+        while (export_running && waited != ETIMEDOUT)
+            waited = pthread_cond_timedwait(&export_cond, &export_lock, &until);
+        if (!export_running) break;
+
+        pthread_mutex_unlock(&export_lock);
+        export_once();
+        pthread_mutex_lock(&export_lock);
+    }
+
+    pthread_mutex_unlock(&export_lock);
+    return NULL;
+}
+
+result_t lurk_counters_export_start(const char* path, unsigned period_ms) {
+    if (path == NULL) return RETURN_BAD_PARAM_NULL(path);
+    if (strlen(path) >= sizeof(export_path)) return RETURN_BAD_PARAM_MSG(path, "Too long.");
+    if (period_ms == 0) return RETURN_BAD_PARAM_MSG(period_ms, "Must not be zero.");
+
+    pthread_mutex_lock(&export_control);
+
+    if (export_running) {
+        pthread_mutex_unlock(&export_control);
+        return RESULT_FAILURE;
+    }
+
+    strcpy(export_path, path);
+    export_period = period_ms;
+    export_running = true;
+
+    if (pthread_create(&export_thread, NULL, &export_main, NULL) != 0) {
+        export_running = false;
+        pthread_mutex_unlock(&export_control);
+        return RETURN_ERROR(RESULT_INTERNAL_ERROR, "Could not create the export thread.");
+    }
+
+    pthread_mutex_unlock(&export_control);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_counters_export_stop(void) {
+    pthread_mutex_lock(&export_control);
+
+    if (!export_running) {
+        pthread_mutex_unlock(&export_control);
+        return RESULT_FAILURE;
+    }
+
+    pthread_mutex_lock(&export_lock);
+    export_running = false;
+    pthread_cond_signal(&export_cond);
+    pthread_mutex_unlock(&export_lock);
+    pthread_join(export_thread, NULL);
+
+    export_once();
+
+    pthread_mutex_unlock(&export_control);
+    return RESULT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lurk.h"
+#include "domain.h"
+
+// The table holds an entry for every code from the lowest to the highest reserved one, so a lookup
+// is an index into it. Reserving a domain outside of the current span replaces the table with a
+// larger copy; readers may still be using the old one, so it is never freed, but it stays linked
+// from the new one. A code's name is stored last, with release order, so a reader that sees it also
+// sees its category.
+struct domain_entry {
+    const char* name;
+    uint8_t category;
+    uint16_t domain; // the index of the domain plus one, or [0] for a code in no domain
+};
+
+struct domain_table {
+    int64_t min;
+    size_t count;
+    struct domain_entry* entries;
+    const struct domain_table* previous;
+};
+
+struct domain {
+    const char* name;
+    int64_t first;
+    size_t count;
+};
+
+#define DOMAIN_LURK_FIRST RESULT_INTERNAL_ERROR
+#define DOMAIN_LURK_COUNT (RESULT_DONE - RESULT_INTERNAL_ERROR + 1)
+
+#define DOMAIN_LURK_ENTRY(result, category)                                                        \
+    [result - DOMAIN_LURK_FIRST] = { #result, LURK_CATEGORY_##category, 1 }
+
+static struct domain_entry domain_lurk_entries[DOMAIN_LURK_COUNT] = {
+    DOMAIN_LURK_ENTRY(RESULT_INTERNAL_ERROR, ERROR),
+    DOMAIN_LURK_ENTRY(RESULT_INVALID_OBJECT, ERROR),
+    DOMAIN_LURK_ENTRY(RESULT_BAD_PARAM, ERROR),
+    DOMAIN_LURK_ENTRY(RESULT_SUCCESS, SUCCESS),
+    DOMAIN_LURK_ENTRY(RESULT_FAILURE, STATUS),
+    DOMAIN_LURK_ENTRY(RESULT_DONE, STATUS),
+};
+
+static const struct domain_table domain_lurk_table = {
+    .min = DOMAIN_LURK_FIRST,
+    .count = DOMAIN_LURK_COUNT,
+    .entries = domain_lurk_entries,
+    .previous = NULL,
+};
+
+static const struct domain_table* domain_current = &domain_lurk_table;
+
+// only touched while holding [domain_lock]
+static struct domain domains[LURK_DOMAINS_MAX] = {
+    { .name = "lurk", .first = DOMAIN_LURK_FIRST, .count = DOMAIN_LURK_COUNT },
+};
+static size_t domain_count = 1;
+static pthread_mutex_t domain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct domain_entry* domain_lookup(result_t result) {
+    const struct domain_table* t = __atomic_load_n(&domain_current, __ATOMIC_ACQUIRE);
+
+    size_t i = (size_t)((int64_t)result - t->min);
+    return i < t->count ? &t->entries[i] : NULL;
+}
+
+// marks the codes of domain [index] in [t], which must cover them
+static void domain_mark(const struct domain_table* t, size_t index) {
+    const struct domain* d = &domains[index];
+
+    for (size_t i = 0; i < d->count; i++) {
+        struct domain_entry* e = &t->entries[d->first - t->min + (int64_t)i];
+        __atomic_store_n(&e->domain, (uint16_t)(index + 1), __ATOMIC_RELEASE);
+    }
+}
+
+// replaces the table with one spanning [min] to [max]; called with [domain_lock] held
+static bool domain_grow(int64_t min, int64_t max) {
+    const struct domain_table* old = domain_current;
+
+    struct domain_table* t = malloc(sizeof(*t));
+    struct domain_entry* entries = calloc((size_t)(max - min + 1), sizeof(*entries));
+    if (t == NULL || entries == NULL) {
+        free(t);
+        free(entries);
+        return false;
+    }
+
+    memcpy(entries + (old->min - min), old->entries, old->count * sizeof(*entries));
+
+    t->min = min;
+    t->count = (size_t)(max - min + 1);
+    t->entries = entries;
+    t->previous = old;
+
+    __atomic_store_n(&domain_current, t, __ATOMIC_RELEASE);
+    return true;
+}
+
+result_t lurk_domain_reserve(const char* name, result_t first, size_t count) {
+    if (name == NULL) return RETURN_BAD_PARAM_NULL(name);
+    if (count == 0) return RETURN_BAD_PARAM_MSG(count, "Must not be zero.");
+
+    int64_t last = (int64_t)first + (int64_t)(count - 1);
+    if (count > (size_t)LURK_DOMAIN_SPAN_MAX || last > INT32_MAX)
+        return RETURN_BAD_PARAM_MSG(count, "Does not fit in a result.");
+
+    pthread_mutex_lock(&domain_lock);
+
+    if (domain_count == LURK_DOMAINS_MAX) {
+        pthread_mutex_unlock(&domain_lock);
+        return RESULT_FAILURE;
+    }
+
+    for (size_t i = 0; i < domain_count; i++) {
+        int64_t other_last = domains[i].first + (int64_t)domains[i].count - 1;
+        if (first <= other_last && last >= domains[i].first) {
+            pthread_mutex_unlock(&domain_lock);
+            return RESULT_FAILURE;
+        }
+    }
+
+    const struct domain_table* t = domain_current;
+    int64_t min = first < t->min ? first : t->min;
+    int64_t max = t->min + (int64_t)t->count - 1;
+    if (last > max) max = last;
+
+    if (max - min + 1 > LURK_DOMAIN_SPAN_MAX) {
+        pthread_mutex_unlock(&domain_lock);
+        return RETURN_BAD_PARAM_FMT(first, "The domains would span more than %d codes.",
+                                    LURK_DOMAIN_SPAN_MAX);
+    }
+
+    if ((min < t->min || max > t->min + (int64_t)t->count - 1) && !domain_grow(min, max)) {
+        pthread_mutex_unlock(&domain_lock);
+        return RETURN_ERROR(RESULT_INTERNAL_ERROR, "Could not grow the result table.");
+    }
+
+    domains[domain_count] = (struct domain){ .name = name, .first = first, .count = count };
+    domain_mark(domain_current, domain_count);
+    domain_count++;
+
+    pthread_mutex_unlock(&domain_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_result_register(result_t result, const char* name, enum lurk_category category) {
+    if (name == NULL) return RETURN_BAD_PARAM_NULL(name);
+    if ((unsigned)category > LURK_CATEGORY_BOOLEAN)
+        return RETURN_BAD_PARAM_MSG(category, "Unknown category.");
+
+    pthread_mutex_lock(&domain_lock);
+
+    // the table can only be replaced while holding the lock, so the entry is the current one
+    struct domain_entry* e = (struct domain_entry*)domain_lookup(result);
+    if (e == NULL || e->domain == 0 || e->name != NULL) {
+        pthread_mutex_unlock(&domain_lock);
+        return RESULT_FAILURE;
+    }
+
+    __atomic_store_n(&e->category, (uint8_t)category, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->name, name, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&domain_lock);
+    return RESULT_SUCCESS;
+}
+
+const char* lurk_result_name(result_t result) {
+    const struct domain_entry* e = domain_lookup(result);
+    return e != NULL ? __atomic_load_n(&e->name, __ATOMIC_ACQUIRE) : NULL;
+}
+
+enum lurk_category lurk_result_category(result_t result) {
+    const struct domain_entry* e = domain_lookup(result);
+    if (e != NULL && __atomic_load_n(&e->name, __ATOMIC_ACQUIRE) != NULL)
+        return (enum lurk_category)__atomic_load_n(&e->category, __ATOMIC_RELAXED);
+
+    if (result < 0) return LURK_CATEGORY_ERROR;
+    return result == 0 ? LURK_CATEGORY_SUCCESS : LURK_CATEGORY_STATUS;
+}
+
+const char* lurk_result_domain(result_t result) {
+    const struct domain_entry* e = domain_lookup(result);
+    uint16_t domain = e != NULL ? __atomic_load_n(&e->domain, __ATOMIC_ACQUIRE) : 0;
+    if (domain == 0) return NULL;
+
+    // domains are only ever added, and an entry is marked after its domain is filled in
+    return domains[domain - 1].name;
+}
@@ -0,0 +1,219 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "binlog.h"
+
+// This file has no dependencies on the rest of the library so that [lurk-decode] can be built from
+// it alone.
+
+#define SPEC_MAX 32
+
+struct out {
+    char* buf;
+    size_t size;
+    size_t len;
+};
+
+static void out_bytes(struct out* o, const char* s, size_t n) {
+    if (o->len < o->size) {
+        size_t room = o->size - o->len;
+        memcpy(o->buf + o->len, s, n < room ? n : room);
+    }
+    o->len += n;
+}
+
+// formats one conversion with [snprintf] straight into the output, which already knows how to
+// measure and truncate
+#define OUT_PRINTF(o, spec, ...)                                                                   \
+    do {                                                                                           \
+        size_t room_ = (o)->len < (o)->size ? (o)->size - (o)->len : 0;                            \
+        int n_ = snprintf(room_ ? (o)->buf + (o)->len : NULL, room_, spec, __VA_ARGS__);           \
+        if (n_ > 0) (o)->len += (size_t)n_;                                                        \
+    } while (0)
+
+static long long arg_as_int(const struct lurk_arg* a) {
+    switch (a->type) {
+        case (LURK_ARG_INT): return a->i;
+        case (LURK_ARG_UINT): return (long long)a->u;
+        case (LURK_ARG_DOUBLE): return (long long)a->d;
+        case (LURK_ARG_STR): return (long long)(size_t)a->s;
+        case (LURK_ARG_PTR): return (long long)(size_t)a->p;
+    }
+    return 0;
+}
+
+static double arg_as_double(const struct lurk_arg* a) {
+    switch (a->type) {
+        case (LURK_ARG_INT): return (double)a->i;
+        case (LURK_ARG_UINT): return (double)a->u;
+        case (LURK_ARG_DOUBLE): return a->d;
+        default: break;
+    }
+    return 0.0;
+}
+
+// integers are narrowed to the type the length modifier names before printing, so the output
+// matches what printf makes of the original argument (e.g. a negative [int] printed with [%x])
+static unsigned long long narrow_unsigned(unsigned long long v, const char* len) {
+    if (strcmp(len, "hh") == 0) return (unsigned char)v;
+    if (strcmp(len, "h") == 0) return (unsigned short)v;
+    if (strcmp(len, "l") == 0) return (unsigned long)v;
+    if (strcmp(len, "z") == 0) return (size_t)v;
+    if (len[0] == '\0') return (unsigned int)v;
+    return v;
+}
+
+static long long narrow_signed(long long v, const char* len) {
+    if (strcmp(len, "hh") == 0) return (signed char)v;
+    if (strcmp(len, "h") == 0) return (short)v;
+    if (strcmp(len, "l") == 0) return (long)v;
+    if (strcmp(len, "t") == 0) return (ptrdiff_t)v;
+    if (len[0] == '\0') return (int)v;
+    return v;
+}
+
+// formats a single conversion; [spec] is the conversion without its length modifier [len], and
+// [conv] is its final character
+static void format_one(struct out* o, char* spec, size_t speclen, const char* len, char conv,
+                       int width, int precision, const struct lurk_arg* a) {
+    // the widened argument types always print with the "ll" length modifier
+    char full[SPEC_MAX + 4];
+    memcpy(full, spec, speclen - 1);
+    size_t n = speclen - 1;
+
+    switch (conv) {
+        case ('d'): case ('i'):
+        case ('o'): case ('u'): case ('x'): case ('X'):
+            full[n++] = 'l';
+            full[n++] = 'l';
+            break;
+        default:
+            break;
+    }
+
+    full[n++] = conv;
+    full[n] = '\0';
+
+    switch (conv) {
+        case ('d'): case ('i'):
+            OUT_PRINTF(o, full, width, precision, narrow_signed(arg_as_int(a), len));
+            break;
+        case ('o'): case ('u'): case ('x'): case ('X'):
+            OUT_PRINTF(o, full, width, precision,
+                       narrow_unsigned((unsigned long long)arg_as_int(a), len));
+            break;
+        case ('c'):
+            OUT_PRINTF(o, full, width, -1, (int)arg_as_int(a));
+            break;
+        case ('e'): case ('E'): case ('f'): case ('F'):
+        case ('g'): case ('G'): case ('a'): case ('A'):
+            OUT_PRINTF(o, full, width, precision, arg_as_double(a));
+            break;
+        case ('s'):
+            if (a->type == LURK_ARG_STR) {
+                OUT_PRINTF(o, full, width, precision, a->s != NULL ? a->s : "(null)");
+            } else {
+                full[n - 1] = 'p';
+                OUT_PRINTF(o, full, width, -1, a->p);
+            }
+            break;
+        case ('p'):
+            OUT_PRINTF(o, full, width, -1, a->p);
+            break;
+        default:
+            break;
+    }
+}
+
+size_t lurk_format_args(char* buf, size_t size,
+                        const char* fmt, size_t nargs, const struct lurk_arg* args) {
+    struct out o = { .buf = buf, .size = size, .len = 0 };
+    size_t next = 0;
+
+    while (*fmt != '\0') {
+        const char* pct = strchr(fmt, '%');
+        if (pct == NULL) {
+            out_bytes(&o, fmt, strlen(fmt));
+            break;
+        }
+
+        out_bytes(&o, fmt, (size_t)(pct - fmt));
+        fmt = pct + 1;
+
+        if (*fmt == '%') {
+            out_bytes(&o, "%", 1);
+            fmt++;
+            continue;
+        }
+
+        // every conversion is rewritten as "%<flags>*.*<conv>" so width and precision can always be
+        // passed as arguments, whether they came from the format or from a '*'
+        char spec[SPEC_MAX];
+        size_t speclen = 0;
+        spec[speclen++] = '%';
+
+        while (*fmt != '\0' && strchr("-+ #0", *fmt) != NULL) {
+            if (speclen < SPEC_MAX - 8) spec[speclen++] = *fmt;
+            fmt++;
+        }
+
+        int width = -1;
+        bool left = false;
+        if (*fmt == '*') {
+            width = next < nargs ? (int)arg_as_int(&args[next++]) : 0;
+            if (width < 0) {
+                left = true;
+                width = -width;
+            }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') {
+                width = (width < 0 ? 0 : width * 10) + (*fmt - '0');
+                fmt++;
+            }
+        }
+        if (left && speclen < SPEC_MAX - 8) spec[speclen++] = '-';
+
+        int precision = -1;
+        if (*fmt == '.') {
+            fmt++;
+            precision = 0;
+            if (*fmt == '*') {
+                precision = next < nargs ? (int)arg_as_int(&args[next++]) : -1;
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') {
+                    precision = precision * 10 + (*fmt - '0');
+                    fmt++;
+                }
+            }
+        }
+
+        char len[4] = {0};
+        for (size_t i = 0; *fmt != '\0' && strchr("hljztLq", *fmt) != NULL; fmt++) {
+            if (i < sizeof(len) - 1) len[i++] = *fmt;
+        }
+
+        char conv = *fmt;
+        if (conv == '\0') break;
+        fmt++;
+
+        spec[speclen++] = '*';
+        spec[speclen++] = '.';
+        spec[speclen++] = '*';
+        spec[speclen++] = conv;
+
+        if (width < 0) width = 0;
+
+        if (next >= nargs) {
+            out_bytes(&o, "(missing)", 9);
+            continue;
+        }
+
+        format_one(&o, spec, speclen, len, conv, width, precision, &args[next++]);
+    }
+
+    if (size > 0) buf[o.len < size ? o.len : size - 1] = '\0';
+    return o.len;
+}
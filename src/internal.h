@@ -0,0 +1,224 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// internal.h
+// ---------------------------------------------------------------------------------------------- //
+// Declarations shared between the lurk sources. Nothing here is part of the public interface.
+
+
+#ifndef LURK_INTERNAL_H
+#define LURK_INTERNAL_H
+
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "binlog.h"
+#include "result.h"
+#include "site.h"
+#include "timestamp.h"
+
+
+// result.c
+// ---------------------------------------------------------------------------------------------- //
+// [struct config_snapshot]
+//  * an immutable copy of a [struct result_config] made by [lurk_set_result_config], with every
+//    unset field already replaced by its default and the length of the postfix precomputed
+struct config_snapshot {
+    const char* projname;
+    const char* prefix;
+    const char* postfix;
+    size_t postlen;
+    bool do_log;
+    bool do_err;
+    result_log_fn* log_fn;
+    result_err_fn* err_fn;
+    enum lurk_format format;
+};
+
+// [config_enter]
+//  * loads the active config for the record about to be written; it stays valid, even if the
+//    config is replaced meanwhile, until the matching [config_exit]
+//  * calls may nest on a thread (e.g. a custom [result_err_fn] that logs); nested calls return the
+//    snapshot of the outermost one
+// [config_exit]
+//  * releases the snapshot returned by the matching [config_enter]
+const struct config_snapshot* config_enter(void);
+void config_exit(void);
+
+// [config_set_tally]
+//  * sets or clears one of the [LURK_ENABLED_TALLY] bits of [lurk_enabled], which are kept across
+//    config changes
+void config_set_tally(unsigned bit, bool enable);
+
+// [log_default], [err_default]
+//  * the default [result_log_fn] and [result_err_fn], for sinks that fall back to them
+void log_default(result_t result, const char* restrict fmt, va_list args);
+void err_default(result_t result, const char* caller, const char* loc,
+                 const char* restrict fmt, va_list args);
+
+// [render_log], [render_err]
+//  * render a complete record exactly as the default log and error functions print it into [buf],
+//    except for the time, which is left blank for [render_stamp]
+//  * the message is truncated to fit in [size] bytes (which must be at least
+//    [LURK_TIMESTAMP_SIZE]), but the postfix is always kept and the output is always nul-terminated
+//  * like [snprintf], the length of the complete record without the nul is returned, so a return
+//    of [size] or more means the record was truncated
+size_t render_log(char* buf, size_t size, const struct config_snapshot* config,
+                  result_t result, const char* restrict fmt, va_list args);
+size_t render_err(char* buf, size_t size, const struct config_snapshot* config, result_t result,
+                  const char* caller, const char* loc,
+                  const char* restrict fmt, va_list args);
+
+// [render_stamp]
+//  * fills in the time of a record rendered by [render_log] or [render_err] from [stamp] (see
+//    [lurk_stamp]), converting it to wall-clock time
+//  * the time starts the record in the text format and follows [RENDER_JSON_TIME] or
+//    [RENDER_LOGFMT_TIME] in the others; the first character tells them apart
+void render_stamp(char* buf, uint64_t stamp);
+
+// [write_record]
+//  * writes all of [buf] to [fd], resuming after partial writes and aborting on errors like the
+//    default log and error functions
+void write_record(int fd, const char* buf, size_t len);
+
+
+// kv.c
+// ---------------------------------------------------------------------------------------------- //
+// [RENDER_JSON_TIME], [RENDER_LOGFMT_TIME]
+//  * what a record in the JSON or logfmt format starts with, up to its time
+#define RENDER_JSON_TIME "{\"time\":\""
+#define RENDER_LOGFMT_TIME "time="
+
+// [render_fields]
+//  * renders the fields of a record (see [kv.h]) as the text format appends them to the message,
+//    given the format its [result_log_fn] or [result_err_fn] was called with
+//  * like [snprintf], the length of the complete output without the nul is returned; it is [0] for
+//    a record without fields
+size_t render_fields(char* buf, size_t size, const char* restrict fmt);
+
+// [render_structured]
+//  * renders a record like [render_log] (if [err] is [false]) or [render_err] in the JSON or logfmt
+//    format of [config], with the same guarantees; only the message is ever truncated
+size_t render_structured(char* buf, size_t size, const struct config_snapshot* config,
+                         result_t result, bool err, const char* caller, const char* loc,
+                         const char* restrict fmt, va_list args);
+
+
+// counters.c
+// ---------------------------------------------------------------------------------------------- //
+// [counters_bump]
+//  * counts a record logged ([err] is [false]) or an error raised with [result] in the shard of the
+//    calling thread; only called while [LURK_ENABLED_COUNT] is set
+void counters_bump(result_t result, bool err);
+
+
+// recorder.c
+// ---------------------------------------------------------------------------------------------- //
+// [recorder_record]
+//  * keeps a record logged ([err] is [false]) or an error raised in the flight recorder ring of the
+//    calling thread, capturing its arguments from [args] without formatting them; [args] is left
+//    untouched; only called while [LURK_ENABLED_RECORD] is set
+// [recorder_record_args]
+//  * like [recorder_record], for an error whose arguments are already captured
+void recorder_record(result_t result, bool err, const char* caller, const char* loc,
+                     const char* fmt, va_list args);
+void recorder_record_args(result_t result, const char* caller, const char* loc,
+                          const char* fmt, size_t nargs, const struct lurk_arg* args);
+
+
+// sigsafe.c
+// ---------------------------------------------------------------------------------------------- //
+// [sigsafe_publish]
+//  * copies the project name, prefix, and postfix of [snapshot] where the async-signal-safe path
+//    can read them without loading the config; called with [config_lock] held
+void sigsafe_publish(const struct config_snapshot* snapshot);
+
+
+// site.c
+// ---------------------------------------------------------------------------------------------- //
+// [site_hit]
+//  * counts a hit of [site] in the shard of the calling thread, registering the site on its first
+//    hit; only called while [LURK_ENABLED_HITS] is set
+void site_hit(const lurk_site_t* site);
+
+
+// async.c
+// ---------------------------------------------------------------------------------------------- //
+// [async_push_log], [async_push_err]
+//  * render a record into the asynchronous ring if the asynchronous mode is running
+//  * [args] is left untouched when [false] is returned, so the caller can still use it
+//  == Return ==
+//      [true]
+//          * if the record was pushed, or dropped because the ring was full
+//      [false]
+//          * if the asynchronous mode is not running and the caller should write the record itself
+bool async_push_log(const struct config_snapshot* config,
+                    result_t result, const char* restrict fmt, va_list args);
+bool async_push_err(const struct config_snapshot* config, result_t result,
+                    const char* caller, const char* loc,
+                    const char* restrict fmt, va_list args);
+
+// [async_push_bytes]
+//  * like [async_push_log], but queues [len] already encoded bytes (at most
+//    [LURK_ASYNC_RECORD_SIZE]) to be written to [fd]
+bool async_push_bytes(int fd, const void* data, size_t len);
+
+
+// uring.c
+// ---------------------------------------------------------------------------------------------- //
+// [uring_start]
+//  * sets up an io_uring for the asynchronous writer and registers [buf] (the record ring) and
+//    [stdout] and [stderr] with it where the kernel allows
+//  == Return ==
+//      [true]
+//          * if the ring is ready
+//      [false]
+//          * if io_uring is not available (not built in, not supported, or not permitted), in which
+//            case the writer keeps using [writev]
+// [uring_stop]
+//  * tears the ring down; no batch may be in flight
+// [uring_running]
+//  * determines whether the ring is set up
+// [uring_write]
+//  * submits the [count] records of [iov] to [fd] as one write, without waiting for it; [iov] must
+//    stay untouched until the matching [uring_wait]
+// [uring_wait]
+//  * waits for the batch submitted last to complete
+//  == Return ==
+//      * the index of the first record that was not fully written, with its [iovec] advanced past
+//        the part that was; the caller writes it and the ones after it itself
+bool uring_start(void* buf, size_t size);
+void uring_stop(void);
+bool uring_running(void);
+void uring_write(int fd, const struct iovec* iov, int count);
+int uring_wait(struct iovec* iov);
+
+
+// timestamp.c
+// ---------------------------------------------------------------------------------------------- //
+// [tsc_calibration]
+//  * reads a consistent copy of the live TSC calibration into [cal]
+//  == Return ==
+//      * the generation of the calibration, which changes every time it is refreshed and is [0]
+//        until the TSC is first calibrated
+// [tsc_refresh]
+//  * like [tsc_calibration], but first refreshes the calibration when [stamp] is a TSC stamp taken
+//    [LURK_TSC_RECALIBRATE_NS] or more after the calibration was last anchored
+unsigned tsc_calibration(struct lurk_tsc_calibration* cal);
+unsigned tsc_refresh(uint64_t stamp, struct lurk_tsc_calibration* cal);
+
+// [timestamp_render]
+//  * like [lurk_format_timestamp], but without the per-thread cache of the current second, so it
+//    touches nothing but [buf] and is async-signal-safe
+size_t timestamp_render(char* buf, uint64_t ns);
+
+#endif // LURK_INTERNAL_H
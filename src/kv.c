@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lurk.h"
+#include "kv.h"
+#include "internal.h"
+
+// Fields reach the renderers through a thread-local pointer that is only set while the record they
+// belong to is being written. The sinks are called with [kv_format] as the format, and a record
+// only has fields if its format is that very array, so a record logged from inside a sink (or any
+// other ["%s"] record) never picks them up by mistake.
+struct kv_record {
+    size_t count;
+    const struct lurk_kv* fields;
+};
+
+static const char kv_format[] = "%s";
+
+static _Thread_local struct kv_record kv_record = {0};
+
+// Like [snprintf], the output measures everything written to it but only stores what fits.
+struct kv_out {
+    char* buf;
+    size_t size;
+    size_t len;
+};
+
+static void kv_put(struct kv_out* o, const char* s, size_t n) {
+    if (o->len < o->size) {
+        size_t room = o->size - o->len;
+        memcpy(o->buf + o->len, s, n < room ? n : room);
+    }
+    o->len += n;
+}
+
+static void kv_puts(struct kv_out* o, const char* s) {
+    kv_put(o, s, strlen(s));
+}
+
+// the escape sequence for [c] inside a quoted string, which is the same in JSON and logfmt
+static size_t kv_escape(unsigned char c, char seq[8]) {
+    switch (c) {
+        case ('"'): memcpy(seq, "\\\"", 2); return 2;
+        case ('\\'): memcpy(seq, "\\\\", 2); return 2;
+        case ('\n'): memcpy(seq, "\\n", 2); return 2;
+        case ('\r'): memcpy(seq, "\\r", 2); return 2;
+        case ('\t'): memcpy(seq, "\\t", 2); return 2;
+        default: break;
+    }
+
+    if (c < 0x20 || c == 0x7f) return (size_t)snprintf(seq, 8, "\\u%04x", c);
+
+    seq[0] = (char)c;
+    return 1;
+}
+
+static bool kv_plain(unsigned char c) {
+    return c >= 0x20 && c != '"' && c != '\\' && c != 0x7f;
+}
+
+// runs of characters that need no escaping are copied as a whole
+static void kv_put_escaped(struct kv_out* o, const char* s) {
+    while (*s != '\0') {
+        const char* run = s;
+        while (kv_plain((unsigned char)*s)) s++;
+        kv_put(o, run, (size_t)(s - run));
+
+        if (*s == '\0') break;
+
+        char seq[8];
+        kv_put(o, seq, kv_escape((unsigned char)*s, seq));
+        s++;
+    }
+}
+
+static void kv_put_quoted(struct kv_out* o, const char* s) {
+    kv_put(o, "\"", 1);
+    kv_put_escaped(o, s);
+    kv_put(o, "\"", 1);
+}
+
+// logfmt values are only quoted when they would not read back as a single bare value
+static bool kv_needs_quotes(const char* s) {
+    if (*s == '\0') return true;
+
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c <= ' ' || c == '=' || c == '"' || c == 0x7f) return true;
+    }
+    return false;
+}
+
+static void kv_put_string(struct kv_out* o, enum lurk_format format, const char* s) {
+    if (format == LURK_FORMAT_JSON || kv_needs_quotes(s)) kv_put_quoted(o, s);
+    else kv_puts(o, s);
+}
+
+// logfmt keys cannot be quoted, so anything that would end them is replaced
+static void kv_put_key(struct kv_out* o, enum lurk_format format, const char* key) {
+    if (key == NULL || *key == '\0') key = "_";
+
+    if (format == LURK_FORMAT_JSON) {
+        kv_put_quoted(o, key);
+        kv_put(o, ":", 1);
+        return;
+    }
+
+    for (; *key != '\0'; key++) {
+        unsigned char c = (unsigned char)*key;
+        char out = c <= ' ' || c == '=' || c == '"' || c == 0x7f ? '_' : (char)c;
+        kv_put(o, &out, 1);
+    }
+    kv_put(o, "=", 1);
+}
+
+// integers are the most common values, and converting them by hand is much cheaper than [snprintf]
+static void kv_put_uint(struct kv_out* o, unsigned long long v) {
+    char digits[24];
+    char* at = digits + sizeof(digits);
+
+    do {
+        *--at = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    kv_put(o, at, (size_t)(digits + sizeof(digits) - at));
+}
+
+static void kv_put_value(struct kv_out* o, enum lurk_format format, const struct lurk_arg* a) {
+    char text[32];
+    int n = 0;
+
+    switch (a->type) {
+        case (LURK_ARG_INT):
+            if (a->i < 0) {
+                kv_put(o, "-", 1);
+                kv_put_uint(o, -(unsigned long long)a->i);
+            } else {
+                kv_put_uint(o, (unsigned long long)a->i);
+            }
+            return;
+        case (LURK_ARG_UINT):
+            kv_put_uint(o, a->u);
+            return;
+        case (LURK_ARG_DOUBLE):
+            // JSON has no infinities or NaN; otherwise the shortest precision that reads back as
+            // the same double
+            if (format == LURK_FORMAT_JSON && !isfinite(a->d)) {
+                n = snprintf(text, sizeof(text), "null");
+                break;
+            }
+            for (int digits = 15; digits <= 17; digits++) {
+                n = snprintf(text, sizeof(text), "%.*g", digits, a->d);
+                if (strtod(text, NULL) == a->d) break;
+            }
+            break;
+        case (LURK_ARG_STR):
+            kv_put_string(o, format, a->s != NULL ? a->s : "(null)");
+            return;
+        case (LURK_ARG_PTR):
+            n = snprintf(text, sizeof(text), "%p", a->p);
+            if (n > 0 && format == LURK_FORMAT_JSON) {
+                kv_put_quoted(o, text);
+                return;
+            }
+            break;
+    }
+
+    if (n > 0) kv_put(o, text, (size_t)n);
+}
+
+// a complete field, with the separator in front of it unless it is the first
+static void kv_put_field(struct kv_out* o, enum lurk_format format, bool first,
+                         const char* key, const struct lurk_arg* value) {
+    if (!first) kv_put(o, format == LURK_FORMAT_JSON ? "," : " ", 1);
+    kv_put_key(o, format, key);
+    kv_put_value(o, format, value);
+}
+
+static void kv_put_header(struct kv_out* o, enum lurk_format format,
+                          const char* key, const char* value) {
+    struct lurk_arg arg = lurk_arg_str(value);
+    kv_put_field(o, format, false, key, &arg);
+}
+
+static size_t kv_fields(const char* fmt, const struct lurk_kv** fields) {
+    if (fmt != kv_format) {
+        *fields = NULL;
+        return 0;
+    }
+
+    *fields = kv_record.fields;
+    return kv_record.count;
+}
+
+// escapes the first [n] characters of [s] where they are, keeping as many as fit in [cap] bytes
+// once escaped; [*need] is set to the escaped length of all [n], and the length kept is returned
+static size_t kv_escape_in_place(char* s, size_t n, size_t cap, size_t* need) {
+    size_t plain = 0;
+    while (plain < n && kv_plain((unsigned char)s[plain])) plain++;
+
+    // most messages need no escaping at all
+    if (plain == n) {
+        *need = n;
+        return n < cap ? n : cap;
+    }
+
+    size_t total = plain;
+    size_t kept = plain < cap ? plain : cap;
+    size_t keptlen = kept;
+
+    for (size_t i = plain; i < n; i++) {
+        char seq[8];
+        total += kv_escape((unsigned char)s[i], seq);
+        if (total <= cap) {
+            kept = i + 1;
+            keptlen = total;
+        }
+    }
+    *need = total;
+
+    // escaping only ever grows the text, so filling it in from the back never overwrites a
+    // character that has yet to be moved
+    size_t at = keptlen;
+    for (size_t i = kept; i-- > plain;) {
+        char seq[8];
+        size_t len = kv_escape((unsigned char)s[i], seq);
+        at -= len;
+        memcpy(s + at, seq, len);
+    }
+
+    return keptlen;
+}
+
+size_t render_fields(char* buf, size_t size, const char* restrict fmt) {
+    const struct lurk_kv* fields;
+    size_t count = kv_fields(fmt, &fields);
+    if (count == 0) return 0;
+
+    struct kv_out o = { .buf = buf, .size = size, .len = 0 };
+    for (size_t i = 0; i < count; i++)
+        kv_put_field(&o, LURK_FORMAT_LOGFMT, false, fields[i].key, &fields[i].value);
+
+    if (size > 0) buf[o.len < size ? o.len : size - 1] = '\0';
+    return o.len;
+}
+
+size_t render_structured(char* buf, size_t size, const struct config_snapshot* config,
+                         result_t result, bool err, const char* caller, const char* loc,
+                         const char* restrict fmt, va_list args) {
+    enum lurk_format format = config->format;
+    bool json = format == LURK_FORMAT_JSON;
+    struct kv_out o = { .buf = buf, .size = size, .len = 0 };
+
+    kv_puts(&o, json ? RENDER_JSON_TIME : RENDER_LOGFMT_TIME);
+    for (int i = 0; i < LURK_TIMESTAMP_SIZE - 1; i++) kv_put(&o, " ", 1);
+
+    char code[16];
+    snprintf(code, sizeof(code), "%08x", (unsigned)result);
+    kv_puts(&o, json ? "\",\"result\":\"" : " result=");
+    kv_puts(&o, code);
+    if (json) kv_put(&o, "\"", 1);
+
+    const char* name = lurk_result_name(result);
+    if (name != NULL) kv_put_header(&o, format, "result_name", name);
+    if (config->projname[0] != '\0') kv_put_header(&o, format, "project", config->projname);
+    if (err) {
+        kv_put_header(&o, format, "caller", caller != NULL ? caller : "(unknown)");
+        kv_put_header(&o, format, "loc", loc != NULL ? loc : "???");
+    }
+
+    // the message always comes last and is the only part that gets truncated, so the record stays
+    // well-formed; a field that does not fit in front of it is left out as a whole, but still
+    // counted in the returned length so a sink that can grow its buffer gets it on the retry
+    const char* open = json ? ",\"msg\":\"" : " msg=\"";
+    const char* close = json ? "\"}" : "\"";
+    size_t reserve = strlen(open) + strlen(close) + config->postlen;
+    size_t dropped = 0;
+
+    const struct lurk_kv* fields;
+    size_t count = kv_fields(fmt, &fields);
+    for (size_t i = 0; i < count; i++) {
+        size_t before = o.len;
+        kv_put_field(&o, format, false, fields[i].key, &fields[i].value);
+        if (o.len + reserve >= size) {
+            dropped += o.len - before;
+            o.len = before;
+        }
+    }
+
+    kv_puts(&o, open);
+    kv_put_escaped(&o, config->prefix);
+
+    size_t tail = strlen(close) + config->postlen;
+    size_t at = o.len;
+    size_t room = at + tail < size ? size - at - tail : 0;
+
+    int n = vsnprintf(room > 0 ? buf + at : NULL, room, fmt, args);
+    if (n < 0) abort();
+
+    size_t shown = room == 0 ? 0 : (size_t)n < room ? (size_t)n : room - 1;
+    size_t escaped;
+    o.len += kv_escape_in_place(buf + at, shown, room > 0 ? room - 1 : 0, &escaped);
+
+    // the part of the message that did not fit is counted as is, since it was never seen
+    size_t missing = escaped - (o.len - at) + ((size_t)n - shown) + dropped;
+
+    // the sinks take all of a truncated record's buffer, so the gap left by a field or an escape
+    // sequence that did not fit is padded with spaces between the record and the postfix
+    kv_puts(&o, close);
+    if (missing > 0) {
+        while (o.len + config->postlen < size - 1) kv_put(&o, " ", 1);
+    }
+    kv_put(&o, config->postfix, config->postlen);
+
+    if (size > 0) buf[o.len < size ? o.len : size - 1] = '\0';
+    return o.len + missing;
+}
+
+result_t lurk_log_fields(result_t result, const char* msg,
+                         size_t nfields, const struct lurk_kv* fields) {
+    if (msg == NULL) return result;
+
+    // the record is counted and recorded by [lurk_log]
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (!(enabled & (LURK_ENABLED_LOG | LURK_ENABLED_COUNT | LURK_ENABLED_RECORD))) return result;
+
+    struct kv_record outer = kv_record;
+    kv_record = (struct kv_record){ .count = nfields, .fields = fields };
+
+    lurk_log(result, kv_format, msg);
+
+    kv_record = outer;
+    return result;
+}
+
+result_t lurk_err_fields(result_t result, const char* caller, const char* loc,
+                         const char* msg, size_t nfields, const struct lurk_kv* fields) {
+    if (msg == NULL) return result;
+
+    // the record is counted and recorded by [lurk_err]
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (!(enabled & (LURK_ENABLED_ERR | LURK_ENABLED_COUNT | LURK_ENABLED_RECORD))) return result;
+
+    struct kv_record outer = kv_record;
+    kv_record = (struct kv_record){ .count = nfields, .fields = fields };
+
+    lurk_err(result, caller, loc, kv_format, msg);
+
+    kv_record = outer;
+    return result;
+}
+
+size_t lurk_fields(const char* fmt, const struct lurk_kv** fields) {
+    if (fields == NULL) return 0;
+    return kv_fields(fmt, fields);
+}
+
+size_t lurk_encode_fields(char* buf, size_t size, enum lurk_format format,
+                          size_t nfields, const struct lurk_kv* fields) {
+    struct kv_out o = { .buf = buf, .size = size, .len = 0 };
+
+    for (size_t i = 0; i < nfields; i++)
+        kv_put_field(&o, format, i == 0, fields[i].key, &fields[i].value);
+
+    if (size > 0) buf[o.len < size ? o.len : size - 1] = '\0';
+    return o.len;
+}
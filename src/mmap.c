@@ -0,0 +1,301 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "mmap.h"
+#include "internal.h"
+
+// the top bit of [mmap_users] marks the mapping as closed; every producer counts itself in the
+// other bits while it writes, so [lurk_mmap_stop] knows when it is safe to unmap
+#define MMAP_CLOSED ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 1))
+
+#define MMAP_CACHE_LINE 64
+
+static unsigned char* map = NULL;
+static size_t map_size = 0;
+static int map_fd = -1;
+
+static _Alignas(MMAP_CACHE_LINE) atomic_size_t mmap_users = MMAP_CLOSED;
+static _Alignas(MMAP_CACHE_LINE) atomic_size_t mmap_tail = 0;
+static atomic_size_t mmap_dropped = 0;
+static size_t mmap_dropped_reported = 0;
+
+static unsigned sync_interval = 0;
+static bool sync_running = false;
+static int sync_error = 0;
+static pthread_t sync_thread;
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sync_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_mutex_t mmap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool mmap_enter(void) {
+    if (atomic_fetch_add_explicit(&mmap_users, 1, memory_order_acquire) & MMAP_CLOSED) {
+        atomic_fetch_sub_explicit(&mmap_users, 1, memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+static void mmap_exit(void) {
+    atomic_fetch_sub_explicit(&mmap_users, 1, memory_order_release);
+}
+
+// the end of the last record reserved, which may be past the end of the file once it is full
+static size_t mmap_used(void) {
+    size_t used = atomic_load_explicit(&mmap_tail, memory_order_acquire);
+    return used < map_size ? used : map_size;
+}
+
+static void mmap_write(const char* buf, size_t len) {
+    size_t frame = (sizeof(uint32_t) + len + LURK_MMAP_ALIGN - 1) & ~(size_t)(LURK_MMAP_ALIGN - 1);
+    size_t at = atomic_fetch_add_explicit(&mmap_tail, frame, memory_order_relaxed);
+
+    if (at >= map_size || frame > map_size - at) {
+        atomic_fetch_add_explicit(&mmap_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    // the length goes in first so a reader can skip a record that was never finished, and the
+    // committed bit last, after the text it vouches for
+    _Atomic uint32_t* word = (_Atomic uint32_t*)(map + at);
+    atomic_store_explicit(word, (uint32_t)len, memory_order_relaxed);
+    memcpy(map + at + sizeof(uint32_t), buf, len);
+    atomic_store_explicit(word, (uint32_t)len | LURK_MMAP_COMMITTED, memory_order_release);
+}
+
+// returns the [errno] of a failed [msync], or [0]
+static int mmap_sync_range(size_t used) {
+    return msync(map, used, MS_SYNC) == 0 ? 0 : errno;
+}
+
+// the sink has no caller to return a failure to outside of [lurk_mmap_sync] and
+// [lurk_mmap_stop], so the sync thread reports them on [stderr], once for each new [errno]
+static void mmap_report_sync(int err) {
+    if (err == sync_error) return;
+    sync_error = err;
+    if (err == 0) return;
+
+    char notice[96];
+    int n = snprintf(notice, sizeof(notice), "lurk: could not sync the mapped file (errno %d)\n",
+                     err);
+    if (n > 0) write_record(STDERR_FILENO, notice, (size_t)n);
+}
+
+// reports the records dropped since the last report on [stderr], since a full file is otherwise
+// silent
+static void mmap_report_drops(void) {
+    size_t total = atomic_load_explicit(&mmap_dropped, memory_order_relaxed);
+    if (total == mmap_dropped_reported) return;
+
+    char notice[96];
+    int n = snprintf(notice, sizeof(notice), "lurk: mapped file full, dropped %zu records\n",
+                     total - mmap_dropped_reported);
+    mmap_dropped_reported = total;
+
+    if (n > 0) write_record(STDERR_FILENO, notice, (size_t)n);
+}
+
+static void* sync_main(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&sync_lock);
+
+    while (sync_running) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += sync_interval / 1000;
+        until.tv_nsec += (long)(sync_interval % 1000) * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+
+        int waited = 0;
+        while (sync_running && waited != ETIMEDOUT)
+            waited = pthread_cond_timedwait(&sync_cond, &sync_lock, &until);
+        if (!sync_running) break;
+
+        pthread_mutex_unlock(&sync_lock);
+        mmap_report_sync(mmap_sync_range(mmap_used()));
+        mmap_report_drops();
+        pthread_mutex_lock(&sync_lock);
+    }
+
+    pthread_mutex_unlock(&sync_lock);
+    return NULL;
+}
+
+result_t lurk_mmap_start(const char* path, size_t size, unsigned sync_ms) {
+    if (path == NULL) return RETURN_BAD_PARAM_NULL(path);
+    if (size <= LURK_MMAP_HEADER_SIZE) return RETURN_BAD_PARAM_MSG(size, "Too small.");
+
+    pthread_mutex_lock(&mmap_lock);
+
+    if (!(atomic_load(&mmap_users) & MMAP_CLOSED)) {
+        pthread_mutex_unlock(&mmap_lock);
+        return RESULT_FAILURE;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        pthread_mutex_unlock(&mmap_lock);
+        return RETURN_ERROR_FMT(RESULT_INTERNAL_ERROR, "Could not open %s.", path);
+    }
+
+    int err = posix_fallocate(fd, 0, (off_t)size);
+    void* mapped = err == 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : NULL;
+    if (mapped == NULL || mapped == MAP_FAILED) {
+        close(fd);
+        pthread_mutex_unlock(&mmap_lock);
+        return RETURN_ERROR_FMT(RESULT_INTERNAL_ERROR, "Could not allocate and map %s.", path);
+    }
+
+    map = mapped;
+    map_size = size;
+    map_fd = fd;
+
+    uint32_t order = LURK_MMAP_BYTE_ORDER;
+    memcpy(map, LURK_MMAP_MAGIC, strlen(LURK_MMAP_MAGIC));
+    memcpy(map + strlen(LURK_MMAP_MAGIC), &order, sizeof(order));
+    atomic_store(&mmap_tail, LURK_MMAP_HEADER_SIZE);
+
+    sync_error = 0;
+    sync_interval = sync_ms;
+    sync_running = sync_ms > 0;
+    if (sync_running && pthread_create(&sync_thread, NULL, &sync_main, NULL) != 0) {
+        sync_running = false;
+        munmap(map, map_size);
+        close(fd);
+        map = NULL;
+        pthread_mutex_unlock(&mmap_lock);
+        return RETURN_ERROR(RESULT_INTERNAL_ERROR, "Could not create the sync thread.");
+    }
+
+    // clearing the closed bit is what lets producers in
+    atomic_fetch_and_explicit(&mmap_users, ~MMAP_CLOSED, memory_order_release);
+
+    pthread_mutex_unlock(&mmap_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_mmap_stop(void) {
+    pthread_mutex_lock(&mmap_lock);
+
+    if (atomic_fetch_or(&mmap_users, MMAP_CLOSED) & MMAP_CLOSED) {
+        pthread_mutex_unlock(&mmap_lock);
+        return RESULT_FAILURE;
+    }
+
+    while (atomic_load(&mmap_users) != MMAP_CLOSED) sched_yield();
+
+    if (sync_running) {
+        pthread_mutex_lock(&sync_lock);
+        sync_running = false;
+        pthread_cond_signal(&sync_cond);
+        pthread_mutex_unlock(&sync_lock);
+        pthread_join(sync_thread, NULL);
+    }
+
+    // the file is closed either way; a failure only means some records may not be on disk, or
+    // that the file keeps its preallocated size, which a reader skips as uncommitted records
+    size_t used = mmap_used();
+    int err = mmap_sync_range(used);
+    munmap(map, map_size);
+    if (ftruncate(map_fd, (off_t)used) != 0 && err == 0) err = errno;
+    close(map_fd);
+
+    map = NULL;
+    map_size = 0;
+    map_fd = -1;
+
+    mmap_report_drops();
+    pthread_mutex_unlock(&mmap_lock);
+
+    if (err != 0) {
+        return RETURN_ERROR_FMT(RESULT_INTERNAL_ERROR,
+                                "Could not sync or truncate the mapped file (errno %d).", err);
+    }
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_mmap_sync(void) {
+    if (!mmap_enter()) return RESULT_FAILURE;
+
+    int err = mmap_sync_range(mmap_used());
+
+    mmap_exit();
+    if (err != 0) {
+        return RETURN_ERROR_FMT(RESULT_INTERNAL_ERROR, "Could not sync the mapped file (errno %d).",
+                                err);
+    }
+    return RESULT_SUCCESS;
+}
+
+size_t lurk_mmap_dropped(void) {
+    return atomic_load_explicit(&mmap_dropped, memory_order_relaxed);
+}
+
+void lurk_mmap_log(result_t result, const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    if (!mmap_enter()) {
+        log_default(result, fmt, args);
+        return;
+    }
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_log) {
+        char buf[LURK_MMAP_RECORD_SIZE];
+        uint64_t stamp = lurk_stamp();
+
+        size_t len = render_log(buf, sizeof(buf), config, result, fmt, args);
+        if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+
+        render_stamp(buf, stamp);
+        mmap_write(buf, len);
+    }
+
+    config_exit();
+    mmap_exit();
+}
+
+void lurk_mmap_err(result_t result, const char* caller, const char* loc,
+                   const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    if (!mmap_enter()) {
+        err_default(result, caller, loc, fmt, args);
+        return;
+    }
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_err) {
+        char buf[LURK_MMAP_RECORD_SIZE];
+        uint64_t stamp = lurk_stamp();
+
+        size_t len = render_err(buf, sizeof(buf), config, result, caller, loc, fmt, args);
+        if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+
+        render_stamp(buf, stamp);
+        mmap_write(buf, len);
+    }
+
+    config_exit();
+    mmap_exit();
+}
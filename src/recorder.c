@@ -0,0 +1,608 @@
+#define _POSIX_C_SOURCE 200809L
+#ifndef _DEFAULT_SOURCE
+#   define _DEFAULT_SOURCE // syscall
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "recorder.h"
+#include "internal.h"
+
+#define RECORDER_STRING_MAX 64
+#define RECORDER_DUMP_BUFFER 4096
+
+_Static_assert((LURK_RECORDER_SLOTS & (LURK_RECORDER_SLOTS - 1)) == 0,
+               "LURK_RECORDER_SLOTS must be a power of two");
+_Static_assert(LURK_RECORDER_SLOT_SIZE % 8 == 0 && LURK_RECORDER_SLOT_SIZE >= 64 &&
+               LURK_RECORDER_SLOT_SIZE - sizeof(uint64_t) <= UINT16_MAX,
+               "LURK_RECORDER_SLOT_SIZE must be a multiple of 8 between 64 and 65536");
+
+// The header is laid out exactly as [recorder.h] describes it. The owning thread is the only one
+// that ever writes a ring; the dump reads it from any thread (or a signal handler on the owning
+// one), so every slot is guarded like a seqlock by its sequence word, which is cleared before the
+// record is touched and set once it is complete.
+struct recorder_header {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t slots;
+    uint32_t slot_size;
+    uint32_t tid;
+    _Atomic uint64_t head;
+    uint64_t tsc;
+    uint64_t ns;
+    uint64_t mult;
+    uint32_t shift;
+    uint32_t reserved;
+};
+
+_Static_assert(sizeof(struct recorder_header) == LURK_RECORDER_HEADER_SIZE,
+               "the ring header must match LURK_RECORDER_HEADER_SIZE");
+
+// rings are never freed, so the dump can walk the list at any time
+struct recorder_ring {
+    _Alignas(64) struct recorder_header header; // must stay first
+    unsigned char slots[LURK_RECORDER_SLOTS][LURK_RECORDER_SLOT_SIZE];
+    atomic_bool in_use;
+    unsigned clock_gen;
+    struct recorder_ring* next;
+};
+
+static _Atomic(struct recorder_ring*) recorder_rings = NULL;
+static atomic_size_t recorder_ring_count = 0;
+static _Thread_local struct recorder_ring* recorder_thread = NULL;
+static pthread_key_t recorder_key;
+static pthread_once_t recorder_once = PTHREAD_ONCE_INIT;
+
+// only touched while holding [recorder_lock]
+static pthread_mutex_t recorder_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool recorder_running = false;
+static int recorder_dump_signal = 0;
+static struct sigaction recorder_previous_dump;
+
+static const int recorder_crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+#define RECORDER_CRASH_SIGNALS (sizeof(recorder_crash_signals) / sizeof(recorder_crash_signals[0]))
+static struct sigaction recorder_previous[RECORDER_CRASH_SIGNALS];
+
+// read by the handlers; written by [lurk_recorder_start] before they are installed
+static char recorder_path[LURK_RECORDER_PATH_MAX];
+static char recorder_projname[RECORDER_STRING_MAX] = "lurk";
+static char recorder_prefix[RECORDER_STRING_MAX] = "";
+static char recorder_postfix[RECORDER_STRING_MAX] = "\n";
+static atomic_flag recorder_crashed = ATOMIC_FLAG_INIT;
+
+
+// Records are encoded straight into their slot, or into a buffer on the stack for the dump.
+// ---------------------------------------------------------------------------------------------- //
+struct recorder_out {
+    unsigned char* buf;
+    size_t size;
+    size_t len;
+};
+
+static void recorder_put(struct recorder_out* o, const void* data, size_t n) {
+    if (n > o->size - o->len) n = o->size - o->len;
+    memcpy(o->buf + o->len, data, n);
+    o->len += n;
+}
+
+static void recorder_put_u8(struct recorder_out* o, uint8_t v) { recorder_put(o, &v, sizeof(v)); }
+static void recorder_put_u16(struct recorder_out* o, uint16_t v) { recorder_put(o, &v, sizeof(v)); }
+static void recorder_put_u32(struct recorder_out* o, uint32_t v) { recorder_put(o, &v, sizeof(v)); }
+static void recorder_put_u64(struct recorder_out* o, uint64_t v) { recorder_put(o, &v, sizeof(v)); }
+
+static void recorder_put_str(struct recorder_out* o, const char* s) {
+    if (s == NULL) s = "(null)";
+
+    size_t n = strlen(s);
+    size_t room = o->size - o->len;
+    room = room > sizeof(uint16_t) ? room - sizeof(uint16_t) : 0;
+    if (n > room) n = room;
+
+    recorder_put_u16(o, (uint16_t)n);
+    recorder_put(o, s, n);
+}
+
+static void recorder_begin(struct recorder_out* o, enum lurk_binlog_kind kind) {
+    o->len = sizeof(uint16_t);
+    recorder_put_u8(o, (uint8_t)kind);
+}
+
+static void recorder_end(struct recorder_out* o) {
+    uint16_t size = (uint16_t)o->len;
+    memcpy(o->buf, &size, sizeof(size));
+}
+
+// like [put_args] of the binary log: arguments that no longer fit are left out
+static void recorder_put_args(struct recorder_out* o, size_t nargs, const struct lurk_arg* args) {
+    size_t count_at = o->len;
+    uint8_t count = 0;
+    recorder_put_u8(o, 0);
+
+    for (size_t i = 0; i < nargs && count < UINT8_MAX; i++) {
+        if (o->size - o->len < sizeof(uint8_t) + sizeof(uint64_t)) break;
+
+        recorder_put_u8(o, (uint8_t)args[i].type);
+
+        switch (args[i].type) {
+            case (LURK_ARG_INT): recorder_put_u64(o, (uint64_t)args[i].i); break;
+            case (LURK_ARG_UINT): recorder_put_u64(o, args[i].u); break;
+            case (LURK_ARG_DOUBLE): recorder_put(o, &args[i].d, sizeof(args[i].d)); break;
+            case (LURK_ARG_STR): recorder_put_str(o, args[i].s); break;
+            case (LURK_ARG_PTR): recorder_put_u64(o, (uint64_t)(uintptr_t)args[i].p); break;
+        }
+
+        count++;
+    }
+
+    if (o->len > count_at) o->buf[count_at] = count;
+}
+
+// reads the arguments of [fmt] off [args] with the types printf would read them as, so they can be
+// stored without formatting them; conversions after one it does not know are left out
+static size_t recorder_capture(const char* fmt, va_list* args, struct lurk_arg* out, size_t max) {
+    size_t n = 0;
+
+    while (n < max && (fmt = strchr(fmt, '%')) != NULL) {
+        fmt++;
+        if (*fmt == '%') {
+            fmt++;
+            continue;
+        }
+
+        fmt += strspn(fmt, "-+ #0");
+        if (*fmt == '*') {
+            out[n++] = lurk_arg_int(va_arg(*args, int));
+            fmt++;
+        } else {
+            fmt += strspn(fmt, "0123456789");
+        }
+
+        if (*fmt == '.') {
+            fmt++;
+            if (*fmt == '*') {
+                if (n < max) out[n++] = lurk_arg_int(va_arg(*args, int));
+                fmt++;
+            } else {
+                fmt += strspn(fmt, "0123456789");
+            }
+        }
+
+        const char* len = fmt;
+        fmt += strspn(fmt, "hljztLq");
+        bool wide = (len[0] == 'l' && len[1] == 'l') || len[0] == 'q';
+        char size = len == fmt ? '\0' : wide ? 'q' : len[0];
+
+        if (n >= max) break;
+
+        switch (*fmt++) {
+            case ('d'): case ('i'):
+                switch (size) {
+                    case ('l'): out[n++] = lurk_arg_int(va_arg(*args, long)); break;
+                    case ('q'): out[n++] = lurk_arg_int(va_arg(*args, long long)); break;
+                    case ('j'): out[n++] = lurk_arg_int(va_arg(*args, intmax_t)); break;
+                    case ('z'): out[n++] = lurk_arg_int((long long)va_arg(*args, size_t)); break;
+                    case ('t'): out[n++] = lurk_arg_int(va_arg(*args, ptrdiff_t)); break;
+                    default: out[n++] = lurk_arg_int(va_arg(*args, int)); break;
+                }
+                break;
+            case ('o'): case ('u'): case ('x'): case ('X'):
+                switch (size) {
+                    case ('l'): out[n++] = lurk_arg_uint(va_arg(*args, unsigned long)); break;
+                    case ('q'): out[n++] = lurk_arg_uint(va_arg(*args, unsigned long long)); break;
+                    case ('j'): out[n++] = lurk_arg_uint(va_arg(*args, uintmax_t)); break;
+                    case ('z'): out[n++] = lurk_arg_uint(va_arg(*args, size_t)); break;
+                    case ('t'): out[n++] = lurk_arg_uint((size_t)va_arg(*args, ptrdiff_t)); break;
+                    default: out[n++] = lurk_arg_uint(va_arg(*args, unsigned)); break;
+                }
+                break;
+            case ('c'):
+                out[n++] = lurk_arg_int(va_arg(*args, int));
+                break;
+            case ('e'): case ('E'): case ('f'): case ('F'):
+            case ('g'): case ('G'): case ('a'): case ('A'):
+                if (size == 'L') out[n++] = lurk_arg_double(va_arg(*args, long double));
+                else out[n++] = lurk_arg_double(va_arg(*args, double));
+                break;
+            case ('s'):
+                out[n++] = lurk_arg_str(va_arg(*args, const char*));
+                break;
+            case ('p'): case ('n'):
+                out[n++] = lurk_arg_ptr(va_arg(*args, void*));
+                break;
+            default:
+                return n;
+        }
+    }
+
+    return n;
+}
+
+
+// Recording.
+// ---------------------------------------------------------------------------------------------- //
+static void recorder_release(void* ring) {
+    struct recorder_ring* r = ring;
+
+    // another thread-specific destructor may still log on this thread after this one has run, in
+    // which case it takes a ring again instead of writing to one that is no longer its own
+    if (recorder_thread == r) recorder_thread = NULL;
+
+    atomic_store_explicit(&r->in_use, false, memory_order_release);
+}
+
+// a forked child only has the forking thread, so the rings of every other thread are free again,
+// though they keep their records until they are taken over
+static void recorder_postfork_child(void) {
+    struct recorder_ring* own = recorder_thread;
+
+    for (struct recorder_ring* r = atomic_load(&recorder_rings); r != NULL; r = r->next) {
+        if (r != own) atomic_store_explicit(&r->in_use, false, memory_order_release);
+    }
+
+    pthread_mutex_init(&recorder_lock, NULL);
+}
+
+static void recorder_init_key(void) {
+    if (pthread_key_create(&recorder_key, &recorder_release) != 0) abort();
+    if (pthread_atfork(NULL, NULL, &recorder_postfork_child) != 0) abort();
+}
+
+// claims a ring for the calling thread, taking over one of an exited thread only once there are
+// [LURK_RECORDER_RINGS] of them
+static struct recorder_ring* recorder_claim(void) {
+    pthread_once(&recorder_once, &recorder_init_key);
+
+    struct recorder_ring* r = NULL;
+    if (atomic_load_explicit(&recorder_ring_count, memory_order_relaxed) >= LURK_RECORDER_RINGS) {
+        r = atomic_load_explicit(&recorder_rings, memory_order_acquire);
+        for (; r != NULL; r = r->next) {
+            bool unused = false;
+            if (atomic_compare_exchange_strong(&r->in_use, &unused, true)) break;
+        }
+    }
+
+    if (r == NULL) {
+        r = aligned_alloc(_Alignof(struct recorder_ring), sizeof(*r));
+        if (r == NULL) return NULL;
+
+        memset(r, 0, sizeof(*r));
+        memcpy(r->header.magic, LURK_RECORDER_MAGIC, sizeof(r->header.magic));
+        r->header.byte_order = LURK_RECORDER_BYTE_ORDER;
+        r->header.slots = LURK_RECORDER_SLOTS;
+        r->header.slot_size = LURK_RECORDER_SLOT_SIZE;
+        atomic_init(&r->in_use, true);
+        atomic_fetch_add_explicit(&recorder_ring_count, 1, memory_order_relaxed);
+
+        r->next = atomic_load_explicit(&recorder_rings, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&recorder_rings, &r->next, r,
+                                                      memory_order_release,
+                                                      memory_order_relaxed)) {}
+    } else {
+        // the records of the previous owner are dropped; the head goes back first so that a
+        // concurrent dump never pairs it with the slots of the new owner
+        atomic_store_explicit(&r->header.head, 0, memory_order_release);
+        for (size_t i = 0; i < LURK_RECORDER_SLOTS; i++)
+            atomic_store_explicit((_Atomic uint64_t*)r->slots[i], 0, memory_order_relaxed);
+
+        r->header.tsc = r->header.ns = r->header.mult = 0;
+        r->header.shift = 0;
+        r->clock_gen = 0;
+    }
+
+    r->header.tid = (uint32_t)syscall(SYS_gettid);
+    pthread_setspecific(recorder_key, r);
+
+    recorder_thread = r;
+    return r;
+}
+
+// keeps the calibration of the TSC stamps in [ring] current
+static void recorder_clock(struct recorder_ring* ring, uint64_t stamp) {
+    struct lurk_tsc_calibration cal;
+    unsigned gen = tsc_refresh(stamp, &cal);
+    if (gen == ring->clock_gen) return;
+
+    ring->header.tsc = cal.tsc;
+    ring->header.ns = cal.ns;
+    ring->header.mult = cal.mult;
+    ring->header.shift = cal.shift;
+    ring->clock_gen = gen;
+}
+
+static void recorder_store(result_t result, bool err, const char* caller, const char* loc,
+                           const char* fmt, size_t nargs, const struct lurk_arg* args) {
+    struct recorder_ring* ring = recorder_thread;
+    if (ring == NULL && (ring = recorder_claim()) == NULL) return;
+
+    uint64_t stamp = lurk_stamp();
+    if (stamp & LURK_STAMP_TSC) recorder_clock(ring, stamp);
+
+    uint64_t n = atomic_load_explicit(&ring->header.head, memory_order_relaxed);
+    unsigned char* slot = ring->slots[n & (LURK_RECORDER_SLOTS - 1)];
+    _Atomic uint64_t* seq = (_Atomic uint64_t*)slot;
+
+    atomic_store_explicit(seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    struct recorder_out o = {
+        .buf = slot + sizeof(uint64_t),
+        .size = LURK_RECORDER_SLOT_SIZE - sizeof(uint64_t),
+    };
+
+    if (err) {
+        recorder_begin(&o, LURK_BINLOG_INLINE_EVENT);
+        recorder_put_str(&o, caller);
+        recorder_put_str(&o, loc);
+    } else {
+        recorder_begin(&o, LURK_BINLOG_INLINE_LOG);
+    }
+
+    recorder_put_str(&o, fmt);
+    recorder_put_u32(&o, (uint32_t)result);
+    recorder_put_u64(&o, stamp);
+    recorder_put_args(&o, nargs, args);
+    recorder_end(&o);
+
+    atomic_store_explicit(seq, n + 1, memory_order_release);
+    atomic_store_explicit(&ring->header.head, n + 1, memory_order_release);
+}
+
+void recorder_record(result_t result, bool err, const char* caller, const char* loc,
+                     const char* fmt, va_list args) {
+    struct lurk_arg captured[LURK_ARGS_MAX];
+
+    va_list copy;
+    va_copy(copy, args);
+    size_t nargs = recorder_capture(fmt, &copy, captured, LURK_ARGS_MAX);
+    va_end(copy);
+
+    recorder_store(result, err, caller, loc, fmt, nargs, captured);
+}
+
+void recorder_record_args(result_t result, const char* caller, const char* loc,
+                          const char* fmt, size_t nargs, const struct lurk_arg* args) {
+    recorder_store(result, true, caller, loc, fmt, nargs, args);
+}
+
+
+// Dumping. Everything from here on may run in a signal handler, so it only uses async-signal-safe
+// calls and never takes a lock or allocates.
+// ---------------------------------------------------------------------------------------------- //
+struct recorder_dump {
+    int fd;
+    bool ok;
+    size_t len;
+    unsigned char buf[RECORDER_DUMP_BUFFER];
+};
+
+static void recorder_flush(struct recorder_dump* d) {
+    const unsigned char* p = d->buf;
+    size_t len = d->len;
+    d->len = 0;
+
+    while (d->ok && len > 0) {
+        ssize_t n = write(d->fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            d->ok = false;
+            break;
+        }
+
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+static void recorder_emit(struct recorder_dump* d, const void* record, size_t len) {
+    if (len > sizeof(d->buf) - d->len) recorder_flush(d);
+    memcpy(d->buf + d->len, record, len);
+    d->len += len;
+}
+
+static void recorder_dump_ring(struct recorder_dump* d, struct recorder_ring* ring) {
+    unsigned char record[LURK_RECORDER_SLOT_SIZE];
+    struct recorder_out o = { .buf = record, .size = sizeof(record) };
+
+    uint64_t head = atomic_load_explicit(&ring->header.head, memory_order_acquire);
+    if (head == 0) return;
+
+    if (ring->header.mult != 0) {
+        recorder_begin(&o, LURK_BINLOG_CLOCK);
+        recorder_put_u64(&o, ring->header.tsc);
+        recorder_put_u64(&o, ring->header.ns);
+        recorder_put_u64(&o, ring->header.mult);
+        recorder_put_u32(&o, ring->header.shift);
+        recorder_end(&o);
+        recorder_emit(d, record, o.len);
+    }
+
+    for (uint64_t n = head > LURK_RECORDER_SLOTS ? head - LURK_RECORDER_SLOTS : 0; n < head; n++) {
+        unsigned char* slot = ring->slots[n & (LURK_RECORDER_SLOTS - 1)];
+        _Atomic uint64_t* seq = (_Atomic uint64_t*)slot;
+
+        if (atomic_load_explicit(seq, memory_order_acquire) != n + 1) continue;
+
+        uint16_t size;
+        memcpy(&size, slot + sizeof(uint64_t), sizeof(size));
+        if (size < sizeof(size) + 1 || size > sizeof(record)) continue;
+        memcpy(record, slot + sizeof(uint64_t), size);
+
+        // the owner may have started over this slot while it was copied
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(seq, memory_order_relaxed) != n + 1) continue;
+
+        recorder_emit(d, record, size);
+    }
+}
+
+result_t lurk_recorder_dump(int fd) {
+    if (fd < 0) return RESULT_BAD_PARAM;
+
+    struct recorder_dump d = { .fd = fd, .ok = true, .len = 0 };
+
+    unsigned char header[4 * RECORDER_STRING_MAX];
+    struct recorder_out o = { .buf = header, .size = sizeof(header) };
+    recorder_begin(&o, LURK_BINLOG_HEADER);
+    recorder_put(&o, LURK_BINLOG_MAGIC, strlen(LURK_BINLOG_MAGIC));
+    recorder_put_u32(&o, LURK_BINLOG_BYTE_ORDER);
+    recorder_put_str(&o, recorder_projname);
+    recorder_put_str(&o, recorder_prefix);
+    recorder_put_str(&o, recorder_postfix);
+    recorder_end(&o);
+    recorder_emit(&d, header, o.len);
+
+    struct recorder_ring* r = atomic_load_explicit(&recorder_rings, memory_order_acquire);
+    for (; r != NULL; r = r->next) recorder_dump_ring(&d, r);
+
+    recorder_flush(&d);
+    return d.ok ? RESULT_SUCCESS : RESULT_INTERNAL_ERROR;
+}
+
+static void recorder_dump_to_path(void) {
+    int saved = errno;
+
+    int fd = open(recorder_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        lurk_recorder_dump(fd);
+        close(fd);
+    }
+
+    errno = saved;
+}
+
+// the first crash dumps; the signal then takes its previous course. A fault raised by the kernel
+// ([si_code] above zero) is left to happen again: returning restarts the faulting instruction,
+// which now reaches the previous handler with the real [siginfo] (the address, the code). Any
+// other signal ([SIGABRT], or one sent with [kill]) would not come back, so it is raised again,
+// to be delivered as soon as this handler returns since it is blocked until then.
+static void recorder_on_crash(int signo, siginfo_t* info, void* context) {
+    (void)context;
+
+    if (!atomic_flag_test_and_set(&recorder_crashed)) recorder_dump_to_path();
+
+    for (size_t i = 0; i < RECORDER_CRASH_SIGNALS; i++) {
+        if (recorder_crash_signals[i] == signo) sigaction(signo, &recorder_previous[i], NULL);
+    }
+
+    if (signo != SIGABRT && info != NULL && info->si_code > 0) return;
+    raise(signo);
+}
+
+static void recorder_on_demand(int signo) {
+    (void)signo;
+    recorder_dump_to_path();
+}
+
+
+// Starting and stopping.
+// ---------------------------------------------------------------------------------------------- //
+static void recorder_copy(char* dst, const char* src) {
+    size_t n = strlen(src);
+    if (n > RECORDER_STRING_MAX - 1) n = RECORDER_STRING_MAX - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+// restores the first [count] crash handlers and the dump handler; called with [recorder_lock] held
+static void recorder_restore(size_t count) {
+    for (size_t i = 0; i < count; i++)
+        sigaction(recorder_crash_signals[i], &recorder_previous[i], NULL);
+    if (recorder_dump_signal != 0) sigaction(recorder_dump_signal, &recorder_previous_dump, NULL);
+    recorder_dump_signal = 0;
+}
+
+static bool recorder_valid_dump_signal(int signo) {
+    if (signo == 0) return true;
+    if (signo == SIGKILL || signo == SIGSTOP) return false;
+
+    for (size_t i = 0; i < RECORDER_CRASH_SIGNALS; i++) {
+        if (recorder_crash_signals[i] == signo) return false;
+    }
+
+    sigset_t set;
+    sigemptyset(&set);
+    return sigaddset(&set, signo) == 0;
+}
+
+result_t lurk_recorder_start(const char* path, int dump_signal) {
+    if (path == NULL) return RETURN_BAD_PARAM_NULL(path);
+    if (strlen(path) >= LURK_RECORDER_PATH_MAX) return RETURN_BAD_PARAM_MSG(path, "Too long.");
+    if (!recorder_valid_dump_signal(dump_signal))
+        return RETURN_BAD_PARAM_MSG(dump_signal, "Not a signal that can dump.");
+
+    pthread_mutex_lock(&recorder_lock);
+
+    if (recorder_running) {
+        pthread_mutex_unlock(&recorder_lock);
+        return RESULT_FAILURE;
+    }
+
+    memcpy(recorder_path, path, strlen(path) + 1);
+
+    const struct config_snapshot* config = config_enter();
+    recorder_copy(recorder_projname, config->projname);
+    recorder_copy(recorder_prefix, config->prefix);
+    recorder_copy(recorder_postfix, config->postfix);
+    config_exit();
+
+    atomic_flag_clear(&recorder_crashed);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_ONSTACK | SA_SIGINFO;
+    action.sa_sigaction = &recorder_on_crash;
+
+    for (size_t i = 0; i < RECORDER_CRASH_SIGNALS; i++) {
+        if (sigaction(recorder_crash_signals[i], &action, &recorder_previous[i]) != 0) {
+            recorder_restore(i);
+            pthread_mutex_unlock(&recorder_lock);
+            return RETURN_INTERNAL_ERROR_MSG("Could not install the crash handlers.");
+        }
+    }
+
+    if (dump_signal != 0) {
+        action.sa_flags = SA_ONSTACK | SA_RESTART;
+        action.sa_handler = &recorder_on_demand;
+
+        if (sigaction(dump_signal, &action, &recorder_previous_dump) != 0) {
+            recorder_restore(RECORDER_CRASH_SIGNALS);
+            pthread_mutex_unlock(&recorder_lock);
+            return RETURN_INTERNAL_ERROR_MSG("Could not install the dump handler.");
+        }
+
+        recorder_dump_signal = dump_signal;
+    }
+
+    recorder_running = true;
+    config_set_tally(LURK_ENABLED_RECORD, true);
+
+    pthread_mutex_unlock(&recorder_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_recorder_stop(void) {
+    pthread_mutex_lock(&recorder_lock);
+
+    if (!recorder_running) {
+        pthread_mutex_unlock(&recorder_lock);
+        return RESULT_FAILURE;
+    }
+
+    config_set_tally(LURK_ENABLED_RECORD, false);
+    recorder_restore(RECORDER_CRASH_SIGNALS);
+    recorder_running = false;
+
+    pthread_mutex_unlock(&recorder_lock);
+    return RESULT_SUCCESS;
+}
@@ -1,12 +1,18 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "lurk.h"
 #include "result.h"
+#include "internal.h"
 
-void log_default(result_t result, const char* restrict fmt, va_list args);
-void err_default(result_t result, const char* caller, const char* loc, const char* restrict fmt, va_list args);
 
 static const result_config_t result_config_default = {
     .projname = "lurk",
@@ -16,116 +22,238 @@ static const result_config_t result_config_default = {
     .do_err = true,
     .log_fn = &log_default,
     .err_fn = &err_default,
+    .format = LURK_FORMAT_TEXT,
 };
 
-static const result_config_t* result_config = NULL;
+_Alignas(64) unsigned lurk_enabled = LURK_ENABLED_LOG | LURK_ENABLED_ERR;
+
+// The active config is an immutable snapshot with every default already resolved, published through
+// [config_current]. A record loads it once with [config_enter] and uses it until [config_exit], so
+// a concurrent [lurk_set_result_config] can never tear a record between two configs.
+//
+// Snapshots are reclaimed by epochs: every thread that has entered owns a reader slot announcing
+// the epoch it entered in (or [0] while it holds no snapshot). Replacing the snapshot retires the
+// old one tagged with the epoch it was replaced in, and it is freed once no slot announces that
+// epoch or an older one. Readers never wait and never write a shared cache line; only the setter
+// scans the slots.
+// ---------------------------------------------------------------------------------------------- //
+#define CONFIG_CACHE_LINE 64
+
+struct config_node {
+    struct config_snapshot snapshot; // must stay first
+    unsigned retired;
+    struct config_node* next;
+};
 
-struct tm get_time() {
-    time_t traw = time(NULL);
-    struct tm t = {0};
-    struct tm* tp = gmtime(&traw);
-    if (tp != NULL) t = *tp;
-    return t;
-}
+struct config_reader {
+    _Alignas(CONFIG_CACHE_LINE) atomic_uint epoch;
+    atomic_bool in_use;
+    struct config_reader* next;
+};
 
-const char* get_config_projname() {
-    if (result_config == NULL) return result_config_default.projname;
+struct config_thread {
+    struct config_reader* reader;
+    const struct config_snapshot* snapshot;
+    unsigned depth;
+};
 
-    const char* projname = result_config->projname;
-    if (projname == NULL) return result_config_default.projname;
+static const struct config_snapshot config_default = {
+    .projname = "lurk",
+    .prefix = "",
+    .postfix = "\n",
+    .postlen = 1,
+    .do_log = true,
+    .do_err = true,
+    .log_fn = &log_default,
+    .err_fn = &err_default,
+    .format = LURK_FORMAT_TEXT,
+};
 
-    return projname;
-}
+static _Atomic(const struct config_snapshot*) config_current = &config_default;
+static atomic_uint config_epoch = 1;
+static _Atomic(struct config_reader*) config_readers = NULL;
+
+// only touched while holding [config_lock]
+static struct config_node* config_retired = NULL;
+static pthread_mutex_t config_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned config_tally = 0; // only touched while holding [config_lock]
 
-const char* get_config_prefix() {
-    if (result_config == NULL) return result_config_default.prefix;
+static _Thread_local struct config_thread config_thread = {0};
+static pthread_key_t config_key;
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
 
-    const char* prefix = result_config->prefix;
-    if (prefix == NULL) return result_config_default.prefix;
+static void config_release_reader(void* reader) {
+    struct config_reader* r = reader;
 
-    return prefix;
+    // another thread-specific destructor may still log on this thread after this one has run, in
+    // which case it registers again instead of using a slot that is no longer its own
+    if (config_thread.reader == r) config_thread.reader = NULL;
+
+    atomic_store_explicit(&r->epoch, 0, memory_order_release);
+    atomic_store_explicit(&r->in_use, false, memory_order_release);
 }
 
-const char* get_config_postfix() {
-    if (result_config == NULL) return result_config_default.postfix;
+// a forked child only has the forking thread, so the slots of every other thread are free again
+// (one of them may have been in the middle of a record, which would otherwise pin its epoch)
+static void config_postfork_child(void) {
+    struct config_reader* own = config_thread.reader;
 
-    const char* postfix = result_config->postfix;
-    if (postfix == NULL) return result_config_default.postfix;
+    for (struct config_reader* r = atomic_load(&config_readers); r != NULL; r = r->next) {
+        if (r != own) config_release_reader(r);
+    }
 
-    return postfix;
+    pthread_mutex_init(&config_lock, NULL);
 }
 
-bool get_config_do_log() {
-    if (result_config == NULL) return result_config_default.do_log;
-    return result_config->do_log;
+static void config_init_key(void) {
+    if (pthread_key_create(&config_key, &config_release_reader) != 0) abort();
+    if (pthread_atfork(NULL, NULL, &config_postfork_child) != 0) abort();
 }
 
-bool get_config_do_err() {
-    if (result_config == NULL) return result_config_default.do_err;
-    return result_config->do_err;
-}
+// claims a free reader slot for the calling thread, reusing the slots of exited threads
+static struct config_reader* config_register(void) {
+    pthread_once(&config_once, &config_init_key);
 
-result_log_fn* get_config_log_fn() {
-    if (result_config == NULL) return result_config_default.log_fn;
+    struct config_reader* r = atomic_load_explicit(&config_readers, memory_order_acquire);
+    for (; r != NULL; r = r->next) {
+        bool unused = false;
+        if (atomic_compare_exchange_strong(&r->in_use, &unused, true)) break;
+    }
 
-    result_log_fn* log_fn = result_config->log_fn;
-    if (log_fn == NULL) return result_config_default.log_fn;
+    if (r == NULL) {
+        r = aligned_alloc(CONFIG_CACHE_LINE, sizeof(*r));
+        if (r == NULL) abort();
 
-    return log_fn;
+        atomic_init(&r->epoch, 0);
+        atomic_init(&r->in_use, true);
+        r->next = atomic_load_explicit(&config_readers, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&config_readers, &r->next, r,
+                                                      memory_order_release,
+                                                      memory_order_relaxed)) {}
+    }
+
+    pthread_setspecific(config_key, r);
+    return r;
 }
 
-result_err_fn* get_config_err_fn() {
-    if (result_config == NULL) return result_config_default.err_fn;
+const struct config_snapshot* config_enter(void) {
+    struct config_thread* t = &config_thread;
+    if (t->depth++ > 0) return t->snapshot; // a record nested in another one shares its snapshot
 
-    result_err_fn* err_fn = result_config->err_fn;
-    if (err_fn == NULL) return result_config_default.err_fn;
+    if (t->reader == NULL) t->reader = config_register();
 
-    return err_fn;
-}
+    // the announcement must be visible before the snapshot is loaded, so that a setter that
+    // replaces the snapshot afterwards sees this thread when deciding what it can free
+    unsigned epoch = atomic_load_explicit(&config_epoch, memory_order_acquire);
+    atomic_store_explicit(&t->reader->epoch, epoch, memory_order_seq_cst);
 
-bool is_success(result_t result) {
-    if (result == RESULT_SUCCESS) return true;
-    return false;
+    t->snapshot = atomic_load_explicit(&config_current, memory_order_seq_cst);
+    return t->snapshot;
 }
 
-bool is_failure(result_t result) {
-    if (result == RESULT_FAILURE) return true;
-    return false;
-}
+void config_exit(void) {
+    struct config_thread* t = &config_thread;
+    if (--t->depth > 0) return;
 
-bool is_valid_object(result_t result) {
-    if (result == RESULT_VALID_OBJECT) return true;
-    return false;
+    t->snapshot = NULL;
+    atomic_store_explicit(&t->reader->epoch, 0, memory_order_release);
 }
 
-bool is_error(result_t result) {
-    return result < 0;
-}
+// frees every retired snapshot that no reader can still hold; called with [config_lock] held
+static void config_reclaim(void) {
+    unsigned oldest = UINT_MAX;
+
+    for (struct config_reader* r = atomic_load(&config_readers); r != NULL; r = r->next) {
+        unsigned epoch = atomic_load_explicit(&r->epoch, memory_order_seq_cst);
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
 
-bool is_lurk_err(result_t result) {
-    switch (result) {
-        case (RESULT_INVALID_OBJECT):
-        case (RESULT_INTERNAL_ERROR):
-        case (RESULT_BAD_PARAM):
-            return true;
-        default:
-            break;
+    struct config_node** link = &config_retired;
+    while (*link != NULL) {
+        struct config_node* node = *link;
+        if (node->retired < oldest) {
+            *link = node->next;
+            free(node);
+        } else {
+            link = &node->next;
+        }
     }
-    return false;
 }
 
-bool is_true(result_t result) {
-    if (result == RESULT_TRUE) return true;
-    return false;
+// the external definitions of the predicates inlined from [result.h]
+extern inline bool is_success(result_t result);
+extern inline bool is_failure(result_t result);
+extern inline bool is_valid_object(result_t result);
+extern inline bool is_error(result_t result);
+extern inline bool is_lurk_err(result_t result);
+extern inline bool is_true(result_t result);
+extern inline bool is_false(result_t result);
+
+// mirrors [snapshot] and the tally bits in [lurk_enabled], and [snapshot] in the async-signal-safe
+// path; called with [config_lock] held
+static void config_publish(const struct config_snapshot* snapshot) {
+    unsigned enabled = config_tally;
+    if (snapshot->do_log) enabled |= LURK_ENABLED_LOG;
+    if (snapshot->do_err) enabled |= LURK_ENABLED_ERR;
+    __atomic_store_n(&lurk_enabled, enabled, __ATOMIC_RELAXED);
+
+    sigsafe_publish(snapshot);
 }
 
-bool is_false(result_t result) {
-    if (result == RESULT_FALSE) return true;
-    return false;
+void config_set_tally(unsigned bit, bool enable) {
+    pthread_mutex_lock(&config_lock);
+
+    if (enable) config_tally |= bit;
+    else config_tally &= ~bit;
+    config_publish(atomic_load(&config_current));
+
+    pthread_mutex_unlock(&config_lock);
 }
 
 result_t lurk_set_result_config(result_config_t* config) {
-    result_config = config;
+    const struct config_snapshot* snapshot = &config_default;
+
+    if (config != NULL) {
+        if ((unsigned)config->format > LURK_FORMAT_LOGFMT)
+            return RETURN_BAD_PARAM_MSG(config->format, "Unknown format.");
+
+        struct config_node* node = malloc(sizeof(*node));
+        if (node == NULL) return RETURN_INTERNAL_ERROR_MSG("Could not allocate the config.");
+
+        struct config_snapshot* s = &node->snapshot;
+        *s = config_default;
+        if (config->projname != NULL) s->projname = config->projname;
+        if (config->prefix != NULL) s->prefix = config->prefix;
+        if (config->postfix != NULL) s->postfix = config->postfix;
+        if (config->log_fn != NULL) s->log_fn = config->log_fn;
+        if (config->err_fn != NULL) s->err_fn = config->err_fn;
+        s->postlen = strlen(s->postfix);
+        s->do_log = config->do_log;
+        s->do_err = config->do_err;
+        s->format = config->format;
+
+        snapshot = s;
+    }
+
+    pthread_mutex_lock(&config_lock);
+
+    const struct config_snapshot* old = atomic_exchange(&config_current, snapshot);
+
+    config_publish(snapshot);
+
+    // readers that entered up to this epoch may still hold [old]
+    unsigned epoch = atomic_fetch_add(&config_epoch, 1);
+
+    if (old != &config_default) {
+        struct config_node* node = (struct config_node*)old;
+        node->retired = epoch;
+        node->next = config_retired;
+        config_retired = node;
+    }
+
+    config_reclaim();
+    pthread_mutex_unlock(&config_lock);
+
     return RESULT_SUCCESS;
 }
 
@@ -139,17 +267,31 @@ result_t lurk_get_defaults(result_config_t* config) {
 result_t lurk_log(result_t result, const char* fmt, ...) {
     if (fmt == NULL) return result;
 
-    if (!get_config_do_log()) return result;
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (enabled & LURK_ENABLED_COUNT) counters_bump(result, false);
+    if (enabled & LURK_ENABLED_RECORD) {
+        va_list args;
+        va_start(args, fmt);
+        recorder_record(result, false, NULL, NULL, fmt, args);
+        va_end(args);
+    }
+    if (!(enabled & LURK_ENABLED_LOG)) return result;
 
-    result_log_fn* log_fn = get_config_log_fn();
+    const struct config_snapshot* config = config_enter();
 
-    va_list args;
+    if (config->do_log) {
+        result_log_fn* log_fn = config->log_fn;
 
-    va_start(args, fmt);
+        va_list args;
 
-    (*log_fn)(result, fmt, args);
+        va_start(args, fmt);
 
-    va_end(args);
+        (*log_fn)(result, fmt, args);
+
+        va_end(args);
+    }
+
+    config_exit();
 
     return result;
 }
@@ -157,70 +299,303 @@ result_t lurk_log(result_t result, const char* fmt, ...) {
 result_t lurk_err(result_t result, const char* caller, const char* loc, const char* fmt, ...) {
     if (fmt == NULL) return result;
 
-    if (!get_config_do_err()) return result;
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (enabled & LURK_ENABLED_COUNT) counters_bump(result, true);
+    if (enabled & LURK_ENABLED_RECORD) {
+        va_list args;
+        va_start(args, fmt);
+        recorder_record(result, true, caller, loc, fmt, args);
+        va_end(args);
+    }
+    if (!(enabled & LURK_ENABLED_ERR)) return result;
 
-    result_err_fn* err_fn = get_config_err_fn();
+    const struct config_snapshot* config = config_enter();
 
-    va_list args;
+    if (config->do_err) {
+        result_err_fn* err_fn = config->err_fn;
 
-    va_start(args, fmt);
+        va_list args;
 
-    (*err_fn)(result, caller, loc, fmt, args);
+        va_start(args, fmt);
 
-    va_end(args);
+        (*err_fn)(result, caller, loc, fmt, args);
+
+        va_end(args);
+    }
+
+    config_exit();
 
     return result;
 }
 
-void log_default(result_t result, const char* restrict fmt, va_list args) {
-    if (fmt == NULL) return;
+// finishes a record whose header has already been rendered into [buf] with [n] characters (as
+// returned by [snprintf]) by appending the message and the postfix; like [snprintf], the length the
+// complete record needs is returned even when it had to be truncated
+static size_t render_finish(char* buf, size_t size, const struct config_snapshot* config, int n,
+                            const char* restrict fmt, va_list args) {
+    if (n < 0) abort(); // this *shouldn't* ever happen, but just in case
 
-    if (!get_config_do_log()) return;
+    size_t need = (size_t)n;
+    size_t len = need < size ? need : size - 1;
 
-    const char* projname = get_config_projname();
-    const char* prefix = get_config_prefix();
-    const char* postfix = get_config_postfix();
+    n = vsnprintf(buf + len, size - len, fmt, args);
+    if (n < 0) abort();
 
-    struct tm t = get_time();
+    need += (size_t)n;
+    len = (size_t)n < size - len ? len + (size_t)n : size - 1;
 
-    int n;
+    // structured fields (see [kv.h]) go between the message and the postfix, but only if all of
+    // them fit; the message is truncated to make room for them
+    const char* postfix = config->postfix;
+    size_t postlen = config->postlen;
+    size_t fieldlen = render_fields(NULL, 0, fmt);
+    need += fieldlen + postlen;
 
-    n = fprintf(stdout, "%02d:%02d:%02d  %08x  [%s]  %s",
-                    t.tm_hour, t.tm_min, t.tm_sec, result, projname, prefix);
+    if (postlen > size - 1) postlen = size - 1;
+    if (fieldlen > size - 1 - postlen) fieldlen = 0;
+    if (len > size - 1 - postlen - fieldlen) len = size - 1 - postlen - fieldlen;
 
-    // this *shouldn't* ever happen, but can't be too careful (if it does, the calling program
-    // should be able to intercept the abort signal if desired)
-    if (n < 0) abort();
+    if (fieldlen > 0) len += render_fields(buf + len, fieldlen + 1, fmt);
 
-    n = vfprintf(stdout, fmt, args);
-    if (n < 0) abort();
+    memcpy(buf + len, postfix, postlen);
+    buf[len + postlen] = '\0';
 
-    n = fprintf(stdout, "%s", postfix);
-    if (n < 0) abort();
+    return need;
 }
 
-void err_default(result_t result, const char* caller, const char* loc, const char* restrict fmt, va_list args) {
-    if (fmt == NULL) return;
+void render_stamp(char* buf, uint64_t stamp) {
+    char text[LURK_TIMESTAMP_SIZE];
+    lurk_format_timestamp(text, lurk_stamp_to_ns(stamp));
+
+    if (buf[0] == RENDER_JSON_TIME[0]) buf += strlen(RENDER_JSON_TIME);
+    else if (buf[0] == RENDER_LOGFMT_TIME[0]) buf += strlen(RENDER_LOGFMT_TIME);
+
+    memcpy(buf, text, LURK_TIMESTAMP_SIZE - 1);
+}
+
+size_t render_log(char* buf, size_t size, const struct config_snapshot* config,
+                  result_t result, const char* restrict fmt, va_list args) {
+    if (config->format != LURK_FORMAT_TEXT)
+        return render_structured(buf, size, config, result, false, NULL, NULL, fmt, args);
+
+    // a registered result is printed by its name (see [domain.h])
+    const char* name = lurk_result_name(result);
+    int n = name != NULL
+          ? snprintf(buf, size, "%*s  %s  [%s]  %s", LURK_TIMESTAMP_SIZE - 1, "", name,
+                     config->projname, config->prefix)
+          : snprintf(buf, size, "%*s  %08x  [%s]  %s", LURK_TIMESTAMP_SIZE - 1, "", result,
+                     config->projname, config->prefix);
 
-    if (!get_config_do_err()) return;
+    return render_finish(buf, size, config, n, fmt, args);
+}
+
+size_t render_err(char* buf, size_t size, const struct config_snapshot* config, result_t result,
+                  const char* caller, const char* loc,
+                  const char* restrict fmt, va_list args) {
+    if (config->format != LURK_FORMAT_TEXT)
+        return render_structured(buf, size, config, result, true, caller, loc, fmt, args);
 
     if (caller == NULL) caller = "(unknown)";
     if (loc == NULL) loc = "???";
 
-    struct tm t = get_time();
+    const char* name = lurk_result_name(result);
+    int n = name != NULL
+          ? snprintf(buf, size, "%*s  %s  [%s:%s.%s]  %s", LURK_TIMESTAMP_SIZE - 1, "", name,
+                     config->projname, caller, loc, config->prefix)
+          : snprintf(buf, size, "%*s  %08x  [%s:%s.%s]  %s", LURK_TIMESTAMP_SIZE - 1, "", result,
+                     config->projname, caller, loc, config->prefix);
 
-    const char* projname = get_config_projname();
-    const char* prefix = get_config_prefix();
-    const char* postfix = get_config_postfix();
+    return render_finish(buf, size, config, n, fmt, args);
+}
 
-    int n = fprintf(stderr, "%02d:%02d:%02d  %08x  [%s:%s.%s]  %s",
-                    t.tm_hour, t.tm_min, t.tm_sec, result, projname, caller, loc, prefix);
+// Each thread renders its records into its own scratch buffer and hands the whole record to the
+// kernel with a single [write], so records from different threads never interleave and no stdio
+// lock is taken. The buffer starts out in thread-local storage and moves to the heap only when a
+// record does not fit; the heap buffer is released when the thread exits.
+// ---------------------------------------------------------------------------------------------- //
+#define SCRATCH_INITIAL_SIZE 512
+
+struct scratch {
+    char* buf;
+    size_t size;
+    char initial[SCRATCH_INITIAL_SIZE];
+};
 
-    if (n < 0) abort(); // this *shouldn't* ever happen, but just in case
+static _Thread_local struct scratch scratch = {0};
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
 
-    n = vfprintf(stderr, fmt, args);
-    if (n < 0) abort();
+static void scratch_release(void* buf) {
+    free(buf);
+}
 
-    n = fprintf(stderr, "%s", postfix);
-    if (n < 0) abort();
+static void scratch_init_key(void) {
+    if (pthread_key_create(&scratch_key, &scratch_release) != 0) abort();
+}
+
+static struct scratch* get_scratch() {
+    if (scratch.buf == NULL) {
+        scratch.buf = scratch.initial;
+        scratch.size = sizeof(scratch.initial);
+    }
+    return &scratch;
+}
+
+static bool grow_scratch(struct scratch* s, size_t size) {
+    char* buf = malloc(size);
+    if (buf == NULL) return false;
+
+    pthread_once(&scratch_once, &scratch_init_key);
+
+    if (s->buf != s->initial) free(s->buf);
+    pthread_setspecific(scratch_key, buf);
+
+    s->buf = buf;
+    s->size = size;
+    return true;
+}
+
+void write_record(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+
+            // this *shouldn't* ever happen, but can't be too careful (if it does, the calling
+            // program should be able to intercept the abort signal if desired)
+            abort();
+        }
+
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+result_t lurk_log_site(result_t result, const lurk_site_t* site, ...) {
+    if (site == NULL || site->fmt == NULL) return result;
+
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (enabled & LURK_ENABLED_HITS) site_hit(site);
+    if (enabled & LURK_ENABLED_COUNT) counters_bump(result, false);
+    if (enabled & LURK_ENABLED_RECORD) {
+        va_list args;
+        va_start(args, site);
+        recorder_record(result, false, NULL, NULL, site->fmt, args);
+        va_end(args);
+    }
+    if (!(enabled & LURK_ENABLED_LOG)) return result;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_log) {
+        result_log_fn* log_fn = config->log_fn;
+
+        va_list args;
+
+        va_start(args, site);
+
+        (*log_fn)(result, site->fmt, args);
+
+        va_end(args);
+    }
+
+    config_exit();
+
+    return result;
+}
+
+result_t lurk_err_site(result_t result, const lurk_site_t* site, ...) {
+    if (site == NULL || site->fmt == NULL) return result;
+
+    unsigned enabled = __atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED);
+    if (enabled & LURK_ENABLED_HITS) site_hit(site);
+    if (enabled & LURK_ENABLED_COUNT) counters_bump(result, true);
+    if (enabled & LURK_ENABLED_RECORD) {
+        va_list args;
+        va_start(args, site);
+        recorder_record(result, true, site->caller, site->loc, site->fmt, args);
+        va_end(args);
+    }
+    if (!(enabled & LURK_ENABLED_ERR)) return result;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_err) {
+        result_err_fn* err_fn = config->err_fn;
+
+        va_list args;
+
+        va_start(args, site);
+
+        (*err_fn)(result, site->caller, site->loc, site->fmt, args);
+
+        va_end(args);
+    }
+
+    config_exit();
+
+    return result;
+}
+
+// writes a record on the calling thread when the asynchronous mode is not running
+static void log_sync(const struct config_snapshot* config,
+                     result_t result, const char* restrict fmt, va_list args) {
+    uint64_t stamp = lurk_stamp();
+
+    struct scratch* s = get_scratch();
+
+    va_list retry;
+    va_copy(retry, args);
+
+    size_t len = render_log(s->buf, s->size, config, result, fmt, args);
+    if (len >= s->size && grow_scratch(s, len + 1))
+        len = render_log(s->buf, s->size, config, result, fmt, retry);
+
+    va_end(retry);
+
+    if (len >= s->size) len = s->size - 1; // the record was truncated since the buffer couldn't grow
+    render_stamp(s->buf, stamp);
+    write_record(STDOUT_FILENO, s->buf, len);
+}
+
+static void err_sync(const struct config_snapshot* config, result_t result,
+                     const char* caller, const char* loc, const char* restrict fmt, va_list args) {
+    uint64_t stamp = lurk_stamp();
+
+    struct scratch* s = get_scratch();
+
+    va_list retry;
+    va_copy(retry, args);
+
+    size_t len = render_err(s->buf, s->size, config, result, caller, loc, fmt, args);
+    if (len >= s->size && grow_scratch(s, len + 1))
+        len = render_err(s->buf, s->size, config, result, caller, loc, fmt, retry);
+
+    va_end(retry);
+
+    if (len >= s->size) len = s->size - 1;
+    render_stamp(s->buf, stamp);
+    write_record(STDERR_FILENO, s->buf, len);
+}
+
+void log_default(result_t result, const char* restrict fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_log && !async_push_log(config, result, fmt, args))
+        log_sync(config, result, fmt, args);
+
+    config_exit();
+}
+
+void err_default(result_t result, const char* caller, const char* loc, const char* restrict fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_err && !async_push_err(config, result, caller, loc, fmt, args))
+        err_sync(config, result, caller, loc, fmt, args);
+
+    config_exit();
 }
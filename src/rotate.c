@@ -0,0 +1,435 @@
+#define _POSIX_C_SOURCE 200809L
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE // fallocate
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "rotate.h"
+#include "internal.h"
+
+#define ROTATE_CACHE_LINE 64
+#define ROTATE_SEQ_DIGITS 6
+
+// There are only ever two segments: the one producers write to and the one the maintenance thread
+// prepares next, and the two swap roles at every rotation. A producer counts itself in [users] of
+// the segment it loaded and then checks that the segment is still current, so once the maintenance
+// thread has switched [rotate_current] over and seen [users] drop to zero, nobody can write to the
+// old segment any more. Since segments are never freed, a producer that loads a segment just as it
+// is retired only ever touches its counter.
+struct rotate_segment {
+    _Alignas(ROTATE_CACHE_LINE) atomic_size_t tail;
+    atomic_size_t users;
+    int fd;
+    unsigned long seq;
+    time_t opened;
+};
+
+// the finished segments that count towards the budget, oldest first
+struct rotate_finished {
+    unsigned long seq;
+    size_t size;
+};
+
+static struct rotate_segment rotate_segments[2] = { { .fd = -1 }, { .fd = -1 } };
+static _Atomic(struct rotate_segment*) rotate_current = NULL;
+static struct rotate_segment* rotate_next = NULL;
+
+static char rotate_base[LURK_ROTATE_PATH_MAX];
+static size_t rotate_max_size = 0;
+static unsigned rotate_interval = 0;
+static size_t rotate_budget = 0;
+static unsigned long rotate_seq = 0;
+
+static struct rotate_finished* rotate_finished = NULL;
+static size_t rotate_nfinished = 0;
+static size_t rotate_capfinished = 0;
+
+static atomic_bool rotate_wanted = false;
+static atomic_bool rotate_stopping = false;
+static atomic_size_t rotate_count = 0;
+static atomic_size_t rotate_dropped = 0;
+static sem_t rotate_wake;
+static pthread_t rotate_thread;
+
+static pthread_mutex_t rotate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void segment_path(char* buf, size_t size, unsigned long seq) {
+    snprintf(buf, size, "%s.%0*lu", rotate_base, ROTATE_SEQ_DIGITS, seq);
+}
+
+static bool remember_finished(unsigned long seq, size_t size) {
+    if (rotate_nfinished == rotate_capfinished) {
+        size_t n = rotate_capfinished == 0 ? 16 : rotate_capfinished * 2;
+        struct rotate_finished* grown = realloc(rotate_finished, n * sizeof(*grown));
+        if (grown == NULL) return false;
+
+        rotate_finished = grown;
+        rotate_capfinished = n;
+    }
+
+    // segments are finished in order, but the ones found on disk at start are not listed in order
+    size_t i = rotate_nfinished++;
+    while (i > 0 && rotate_finished[i - 1].seq > seq) {
+        rotate_finished[i] = rotate_finished[i - 1];
+        i--;
+    }
+
+    rotate_finished[i] = (struct rotate_finished){ .seq = seq, .size = size };
+    return true;
+}
+
+// lists the segments left behind by earlier runs, so numbering continues after them and they are
+// deleted against the budget like any other
+static void find_existing(void) {
+    char dir[LURK_ROTATE_PATH_MAX];
+    const char* name = strrchr(rotate_base, '/');
+
+    if (name == NULL) {
+        strcpy(dir, ".");
+        name = rotate_base;
+    } else {
+        size_t n = (size_t)(name - rotate_base);
+        memcpy(dir, rotate_base, n);
+        strcpy(dir + n, n == 0 ? "/" : "");
+        name++;
+    }
+
+    DIR* d = opendir(dir);
+    if (d == NULL) return;
+
+    size_t namelen = strlen(name);
+    struct dirent* entry;
+
+    while ((entry = readdir(d)) != NULL) {
+        const char* s = entry->d_name;
+        if (strncmp(s, name, namelen) != 0 || s[namelen] != '.') continue;
+
+        char* end;
+        unsigned long seq = strtoul(s + namelen + 1, &end, 10);
+        if (end == s + namelen + 1 || *end != '\0' || seq == 0) continue;
+
+        char path[LURK_ROTATE_PATH_MAX + 32];
+        segment_path(path, sizeof(path), seq);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !remember_finished(seq, (size_t)st.st_size)) continue;
+
+        if (seq > rotate_seq) rotate_seq = seq;
+    }
+
+    closedir(d);
+}
+
+static bool prepare(struct rotate_segment* seg) {
+    char path[LURK_ROTATE_PATH_MAX + 32];
+    unsigned long seq = rotate_seq + 1;
+    segment_path(path, sizeof(path), seq);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    // the blocks are reserved ahead so the writes into them never have to allocate, without
+    // changing the size of the file, so a reader of a live segment only sees what was written; a
+    // file system that cannot preallocate is still fine to write to
+    if (rotate_max_size > 0) fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)rotate_max_size);
+
+    rotate_seq = seq;
+    seg->seq = seq;
+    seg->fd = fd;
+    atomic_store_explicit(&seg->tail, 0, memory_order_relaxed);
+    return true;
+}
+
+// waits for the producers still writing to a segment that is no longer current, then truncates it
+// to what was written, which gives back the preallocated blocks it did not use; if that fails they
+// stay allocated, so the segment counts against the budget at its preallocated size
+static void finish(struct rotate_segment* seg) {
+    while (atomic_load(&seg->users) != 0) sched_yield();
+
+    size_t size = atomic_load_explicit(&seg->tail, memory_order_relaxed);
+    if (ftruncate(seg->fd, (off_t)size) != 0 && size < rotate_max_size) size = rotate_max_size;
+    close(seg->fd);
+    seg->fd = -1;
+
+    remember_finished(seg->seq, size);
+}
+
+static void retain(void) {
+    if (rotate_budget == 0) return;
+
+    struct rotate_segment* cur = atomic_load(&rotate_current);
+    size_t total = 0;
+    if (cur != NULL) {
+        size_t tail = atomic_load_explicit(&cur->tail, memory_order_relaxed);
+        total = tail > rotate_max_size ? tail : rotate_max_size;
+    }
+    for (size_t i = 0; i < rotate_nfinished; i++) total += rotate_finished[i].size;
+
+    size_t removed = 0;
+    while (total > rotate_budget && removed < rotate_nfinished) {
+        char path[LURK_ROTATE_PATH_MAX + 32];
+        segment_path(path, sizeof(path), rotate_finished[removed].seq);
+        unlink(path);
+
+        total -= rotate_finished[removed].size;
+        removed++;
+    }
+
+    rotate_nfinished -= removed;
+    memmove(rotate_finished, rotate_finished + removed,
+            rotate_nfinished * sizeof(*rotate_finished));
+}
+
+static void rotate(void) {
+    struct rotate_segment* old = atomic_load(&rotate_current);
+    struct rotate_segment* fresh = rotate_next;
+
+    // the next segment is normally ready long before it is needed; if it could not be created
+    // (e.g. the disk is full), producers simply stay on the current one
+    if (fresh->fd < 0 && !prepare(fresh)) return;
+
+    fresh->opened = time(NULL);
+    atomic_store(&rotate_current, fresh);
+    rotate_next = old;
+
+    finish(old);
+    atomic_fetch_add_explicit(&rotate_count, 1, memory_order_relaxed);
+
+    retain();
+    prepare(old);
+}
+
+static void* rotate_main(void* arg) {
+    (void)arg;
+
+    prepare(rotate_next);
+
+    while (!atomic_load(&rotate_stopping)) {
+        struct rotate_segment* cur = atomic_load(&rotate_current);
+
+        if (rotate_interval > 0) {
+            struct timespec until = { .tv_sec = cur->opened + (time_t)rotate_interval };
+            while (sem_timedwait(&rotate_wake, &until) != 0 && errno == EINTR);
+        } else {
+            while (sem_wait(&rotate_wake) != 0 && errno == EINTR);
+        }
+
+        if (atomic_load(&rotate_stopping)) break;
+
+        bool due = atomic_exchange(&rotate_wanted, false);
+        if (rotate_interval > 0 && time(NULL) >= cur->opened + (time_t)rotate_interval) {
+            if (atomic_load_explicit(&cur->tail, memory_order_relaxed) > 0) due = true;
+            else cur->opened = time(NULL);
+        }
+
+        if (due) rotate();
+    }
+
+    return NULL;
+}
+
+static void request_rotation(void) {
+    if (!atomic_load_explicit(&rotate_wanted, memory_order_relaxed) &&
+        !atomic_exchange(&rotate_wanted, true))
+        sem_post(&rotate_wake);
+}
+
+result_t lurk_rotate_start(const char* path, size_t max_size, unsigned interval, size_t budget) {
+    if (path == NULL) return RETURN_BAD_PARAM_NULL(path);
+    if (strlen(path) >= sizeof(rotate_base)) return RETURN_BAD_PARAM_MSG(path, "Too long.");
+    if (max_size == 0 && interval == 0)
+        return RETURN_BAD_PARAM_MSG(max_size, "Either the size or the interval must be set.");
+
+    pthread_mutex_lock(&rotate_lock);
+
+    if (atomic_load(&rotate_current) != NULL) {
+        pthread_mutex_unlock(&rotate_lock);
+        return RESULT_FAILURE;
+    }
+
+    strcpy(rotate_base, path);
+    rotate_max_size = max_size;
+    rotate_interval = interval;
+    rotate_budget = budget;
+    rotate_seq = 0;
+    rotate_nfinished = 0;
+
+    find_existing();
+
+    struct rotate_segment* first = &rotate_segments[0];
+    rotate_next = &rotate_segments[1];
+    rotate_next->fd = -1;
+
+    if (!prepare(first)) {
+        pthread_mutex_unlock(&rotate_lock);
+        return RETURN_ERROR_FMT(RESULT_INTERNAL_ERROR, "Could not create a segment of %s.", path);
+    }
+    first->opened = time(NULL);
+
+    atomic_store(&rotate_wanted, false);
+    atomic_store(&rotate_stopping, false);
+    sem_init(&rotate_wake, 0, 0);
+
+    atomic_store(&rotate_current, first);
+    retain();
+
+    if (pthread_create(&rotate_thread, NULL, &rotate_main, NULL) != 0) {
+        atomic_store(&rotate_current, NULL);
+        finish(first);
+        sem_destroy(&rotate_wake);
+        pthread_mutex_unlock(&rotate_lock);
+        return RETURN_ERROR(RESULT_INTERNAL_ERROR, "Could not create the maintenance thread.");
+    }
+
+    pthread_mutex_unlock(&rotate_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_rotate_stop(void) {
+    pthread_mutex_lock(&rotate_lock);
+
+    struct rotate_segment* cur = atomic_load(&rotate_current);
+    if (cur == NULL) {
+        pthread_mutex_unlock(&rotate_lock);
+        return RESULT_FAILURE;
+    }
+
+    atomic_store(&rotate_stopping, true);
+    sem_post(&rotate_wake);
+    pthread_join(rotate_thread, NULL);
+
+    cur = atomic_exchange(&rotate_current, NULL);
+    finish(cur);
+
+    // the segment prepared ahead was never written to
+    if (rotate_next->fd >= 0) {
+        char path[LURK_ROTATE_PATH_MAX + 32];
+        segment_path(path, sizeof(path), rotate_next->seq);
+        close(rotate_next->fd);
+        unlink(path);
+        rotate_next->fd = -1;
+    }
+
+    sem_destroy(&rotate_wake);
+
+    free(rotate_finished);
+    rotate_finished = NULL;
+    rotate_nfinished = 0;
+    rotate_capfinished = 0;
+
+    pthread_mutex_unlock(&rotate_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_rotate_now(void) {
+    if (atomic_load(&rotate_current) == NULL) return RESULT_FAILURE;
+
+    atomic_store(&rotate_wanted, true);
+    sem_post(&rotate_wake);
+    return RESULT_SUCCESS;
+}
+
+size_t lurk_rotate_rotations(void) {
+    return atomic_load_explicit(&rotate_count, memory_order_relaxed);
+}
+
+size_t lurk_rotate_dropped(void) {
+    return atomic_load_explicit(&rotate_dropped, memory_order_relaxed);
+}
+
+// writes a rendered record to the current segment, or returns [false] if the sink is not running
+static bool rotate_write(const char* buf, size_t len) {
+    struct rotate_segment* seg;
+
+    for (;;) {
+        seg = atomic_load(&rotate_current);
+        if (seg == NULL) return false;
+
+        atomic_fetch_add(&seg->users, 1);
+        if (atomic_load(&rotate_current) == seg) break;
+        atomic_fetch_sub(&seg->users, 1);
+    }
+
+    size_t at = atomic_fetch_add_explicit(&seg->tail, len, memory_order_relaxed);
+
+    // a record that cannot be written (the disk is full, say) is dropped and counted; the space
+    // reserved for it is left as a hole
+    for (size_t done = 0; done < len;) {
+        ssize_t n = pwrite(seg->fd, buf + done, len - done, (off_t)(at + done));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            atomic_fetch_add_explicit(&rotate_dropped, 1, memory_order_relaxed);
+            break;
+        }
+        done += (size_t)n;
+    }
+
+    atomic_fetch_sub_explicit(&seg->users, 1, memory_order_release);
+
+    if (rotate_max_size > 0 && at + len > rotate_max_size) request_rotation();
+    return true;
+}
+
+void lurk_rotate_log(result_t result, const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_log) {
+        char buf[LURK_ROTATE_RECORD_SIZE];
+        uint64_t stamp = lurk_stamp();
+
+        va_list retry;
+        va_copy(retry, args);
+
+        size_t len = render_log(buf, sizeof(buf), config, result, fmt, args);
+        if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+
+        render_stamp(buf, stamp);
+        if (!rotate_write(buf, len)) log_default(result, fmt, retry);
+
+        va_end(retry);
+    }
+
+    config_exit();
+}
+
+void lurk_rotate_err(result_t result, const char* caller, const char* loc,
+                     const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_err) {
+        char buf[LURK_ROTATE_RECORD_SIZE];
+        uint64_t stamp = lurk_stamp();
+
+        va_list retry;
+        va_copy(retry, args);
+
+        size_t len = render_err(buf, sizeof(buf), config, result, caller, loc, fmt, args);
+        if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+
+        render_stamp(buf, stamp);
+        if (!rotate_write(buf, len)) err_default(result, caller, loc, fmt, retry);
+
+        va_end(retry);
+    }
+
+    config_exit();
+}
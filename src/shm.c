@@ -0,0 +1,357 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "shm.h"
+#include "internal.h"
+
+_Static_assert(LURK_SHM_SLOT_SIZE % 8 == 0 && LURK_SHM_SLOT_SIZE >= 64 &&
+               LURK_SHM_SLOT_SIZE - LURK_SHM_SLOT_HEADER <= UINT16_MAX,
+               "LURK_SHM_SLOT_SIZE must be a multiple of 8 between 64 and 65544");
+_Static_assert((LURK_SHM_SLOTS & (LURK_SHM_SLOTS - 1)) == 0,
+               "LURK_SHM_SLOTS must be a power of two");
+
+// the top bit of [shm_users] marks the ring as unmapped; every producer counts itself in the other
+// bits while it writes, so [lurk_shm_stop] knows when it is safe to unmap, like in [mmap.c]
+#define SHM_CLOSED ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 1))
+
+// how long a process attaching to a ring waits for the process creating it to initialize it
+#define SHM_INIT_WAIT_MS 1000
+
+// how many times a producer tries for a slot another process is in the middle of claiming before
+// it drops its record instead
+#define SHM_CLAIM_TRIES 1024
+
+// The header and slots are laid out exactly as [shm.h] describes them. Every process maps the ring
+// at a different address, so nothing in it is a pointer.
+struct shm_header {
+    char magic[8];
+    _Atomic uint32_t byte_order;
+    uint32_t slots;
+    uint32_t slot_size;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+    _Alignas(64) _Atomic uint64_t head;
+    _Atomic uint64_t skipped;
+};
+
+struct shm_slot {
+    _Atomic uint64_t seq;
+    _Atomic uint32_t pid;
+    uint16_t len;
+    uint8_t err;
+    uint8_t pad;
+    char text[];
+};
+
+_Static_assert(sizeof(struct shm_header) == LURK_SHM_HEADER_SIZE, "shm header layout");
+_Static_assert(offsetof(struct shm_header, tail) == 64, "shm header layout");
+_Static_assert(offsetof(struct shm_header, head) == 128, "shm header layout");
+_Static_assert(offsetof(struct shm_slot, text) == LURK_SHM_SLOT_HEADER, "shm slot layout");
+
+static struct shm_header* ring = NULL;
+static size_t ring_size = 0;
+static uint64_t ring_mask = 0;
+static size_t ring_text = 0; // the room for text in a slot of the mapped ring
+
+static _Alignas(64) atomic_size_t shm_users = SHM_CLOSED;
+
+// the process id stamped on every record; kept up to date across [fork] by [shm_postfork_child]
+static uint32_t shm_pid = 0;
+static pthread_once_t shm_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void shm_postfork_child(void) {
+    shm_pid = (uint32_t)getpid();
+}
+
+static void shm_init_fork(void) {
+    if (pthread_atfork(NULL, NULL, &shm_postfork_child) != 0) abort();
+}
+
+static bool shm_enter(void) {
+    if (atomic_fetch_add_explicit(&shm_users, 1, memory_order_acquire) & SHM_CLOSED) {
+        atomic_fetch_sub_explicit(&shm_users, 1, memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+static void shm_exit(void) {
+    atomic_fetch_sub_explicit(&shm_users, 1, memory_order_release);
+}
+
+static struct shm_slot* shm_slot_at(uint64_t pos) {
+    size_t index = (size_t)(pos & ring_mask);
+    return (struct shm_slot*)((unsigned char*)ring + LURK_SHM_HEADER_SIZE +
+                              index * ring->slot_size);
+}
+
+// A slot is claimed by setting its process id from [0] and only then moving the tail past it, so
+// the collector never sees a claimed slot without the id of the process that has to write it. Only
+// the process holding the id can move the tail past the slot; a producer that set the id of a slot
+// whose position the tail had already passed (its position was stale) clears it again.
+static bool shm_claim(struct shm_slot* slot, uint64_t pos) {
+    uint32_t none = 0;
+    if (!atomic_compare_exchange_strong_explicit(&slot->pid, &none, shm_pid,
+                                                 memory_order_acq_rel, memory_order_relaxed))
+        return false;
+
+    uint64_t expected = pos;
+    if (atomic_compare_exchange_strong_explicit(&ring->tail, &expected, pos + 1,
+                                                memory_order_acq_rel, memory_order_relaxed))
+        return true;
+
+    atomic_store_explicit(&slot->pid, 0, memory_order_release);
+    return false;
+}
+
+// the time is filled in only once the slot is claimed, so that the order of the slots, which is the
+// order they are collected in, is also the order of the times
+static void shm_write(bool err, char* buf, size_t len) {
+    uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    struct shm_slot* slot;
+    unsigned tries = 0;
+
+    for (;;) {
+        slot = shm_slot_at(pos);
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t lag = (int64_t)(seq - pos);
+
+        if (lag == 0) {
+            if (shm_claim(slot, pos)) break;
+
+            uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            if (tail == pos) {
+                // another process is between setting the id and moving the tail
+                if (++tries == SHM_CLAIM_TRIES) {
+                    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+                    return;
+                }
+                sched_yield();
+            }
+            pos = tail;
+        } else if (lag < 0) {
+            // the slot still holds the record from the previous lap: the ring is full
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        }
+    }
+
+    render_stamp(buf, lurk_stamp());
+
+    slot->len = (uint16_t)len;
+    slot->err = err;
+    memcpy(slot->text, buf, len);
+
+    // the collector only gives up on a slot once the process that claimed it is gone
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+static void shm_sleep_ms(void) {
+    struct timespec ms = { .tv_sec = 0, .tv_nsec = 1000000L };
+    nanosleep(&ms, NULL);
+}
+
+// creates the ring as a new object, or maps the one another process created; returns [NULL] if
+// neither worked
+static struct shm_header* shm_map(const char* name, size_t slots, size_t* size) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if (fd >= 0) {
+        *size = LURK_SHM_HEADER_SIZE + slots * LURK_SHM_SLOT_SIZE;
+
+        void* mapped = ftruncate(fd, (off_t)*size) == 0
+                     ? mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                     : MAP_FAILED;
+        close(fd);
+
+        if (mapped == MAP_FAILED) {
+            shm_unlink(name);
+            return NULL;
+        }
+
+        // the object starts out zeroed, so only the sequence words and the header need setting
+        struct shm_header* h = mapped;
+        memcpy(h->magic, LURK_SHM_MAGIC, sizeof(h->magic));
+        h->slots = (uint32_t)slots;
+        h->slot_size = LURK_SHM_SLOT_SIZE;
+
+        for (size_t i = 0; i < slots; i++) {
+            struct shm_slot* slot = (struct shm_slot*)((unsigned char*)h + LURK_SHM_HEADER_SIZE +
+                                                       i * LURK_SHM_SLOT_SIZE);
+            atomic_store_explicit(&slot->seq, i, memory_order_relaxed);
+        }
+
+        atomic_store_explicit(&h->byte_order, LURK_SHM_BYTE_ORDER, memory_order_release);
+        return h;
+    }
+
+    if (errno != EEXIST) return NULL;
+
+    fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) return NULL;
+
+    // the creator sizes the object right after creating it
+    struct stat st = {0};
+    for (unsigned waited = 0; waited < SHM_INIT_WAIT_MS; waited++) {
+        if (fstat(fd, &st) != 0 || st.st_size > 0) break;
+        shm_sleep_ms();
+    }
+
+    void* mapped = st.st_size >= LURK_SHM_HEADER_SIZE
+                 ? mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                 : MAP_FAILED;
+    close(fd);
+    if (mapped == MAP_FAILED) return NULL;
+
+    struct shm_header* h = mapped;
+    *size = (size_t)st.st_size;
+
+    for (unsigned waited = 0; waited < SHM_INIT_WAIT_MS; waited++) {
+        if (atomic_load_explicit(&h->byte_order, memory_order_acquire) != 0) break;
+        shm_sleep_ms();
+    }
+
+    bool valid = memcmp(h->magic, LURK_SHM_MAGIC, sizeof(h->magic)) == 0 &&
+                 atomic_load_explicit(&h->byte_order, memory_order_acquire) ==
+                 LURK_SHM_BYTE_ORDER &&
+                 h->slots > 0 && (h->slots & (h->slots - 1)) == 0 &&
+                 h->slot_size % 8 == 0 && h->slot_size >= 64 &&
+                 h->slot_size - LURK_SHM_SLOT_HEADER <= UINT16_MAX &&
+                 LURK_SHM_HEADER_SIZE + (uint64_t)h->slots * h->slot_size <= *size;
+
+    if (!valid) {
+        munmap(mapped, *size);
+        return NULL;
+    }
+
+    return h;
+}
+
+result_t lurk_shm_start(const char* name, size_t slots) {
+    if (name == NULL) return RETURN_BAD_PARAM_NULL(name);
+    if (slots == 0) slots = LURK_SHM_SLOTS;
+    if ((slots & (slots - 1)) != 0 || slots > UINT32_MAX)
+        return RETURN_BAD_PARAM_MSG(slots, "Must be a power of two.");
+
+    pthread_mutex_lock(&shm_lock);
+
+    if (!(atomic_load(&shm_users) & SHM_CLOSED)) {
+        pthread_mutex_unlock(&shm_lock);
+        return RESULT_FAILURE;
+    }
+
+    size_t size = 0;
+    struct shm_header* h = shm_map(name, slots, &size);
+    if (h == NULL) {
+        pthread_mutex_unlock(&shm_lock);
+        return RETURN_ERROR_FMT(RESULT_INTERNAL_ERROR, "Could not create or map the ring %s.",
+                                name);
+    }
+
+    pthread_once(&shm_once, &shm_init_fork);
+    shm_pid = (uint32_t)getpid();
+
+    ring = h;
+    ring_size = size;
+    ring_mask = h->slots - 1;
+    ring_text = h->slot_size - LURK_SHM_SLOT_HEADER;
+
+    // clearing the closed bit is what lets producers in
+    atomic_fetch_and_explicit(&shm_users, ~SHM_CLOSED, memory_order_release);
+
+    pthread_mutex_unlock(&shm_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_shm_stop(void) {
+    pthread_mutex_lock(&shm_lock);
+
+    if (atomic_fetch_or(&shm_users, SHM_CLOSED) & SHM_CLOSED) {
+        pthread_mutex_unlock(&shm_lock);
+        return RESULT_FAILURE;
+    }
+
+    while (atomic_load(&shm_users) != SHM_CLOSED) sched_yield();
+
+    munmap(ring, ring_size);
+    ring = NULL;
+    ring_size = 0;
+
+    pthread_mutex_unlock(&shm_lock);
+    return RESULT_SUCCESS;
+}
+
+size_t lurk_shm_dropped(void) {
+    if (!shm_enter()) return 0;
+
+    size_t dropped = (size_t)atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+
+    shm_exit();
+    return dropped;
+}
+
+void lurk_shm_log(result_t result, const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    if (!shm_enter()) {
+        log_default(result, fmt, args);
+        return;
+    }
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_log) {
+        char buf[LURK_SHM_SLOT_SIZE - LURK_SHM_SLOT_HEADER];
+        size_t size = ring_text < sizeof(buf) ? ring_text : sizeof(buf);
+        size_t len = render_log(buf, size, config, result, fmt, args);
+        if (len >= size) len = size - 1;
+
+        shm_write(false, buf, len);
+    }
+
+    config_exit();
+    shm_exit();
+}
+
+void lurk_shm_err(result_t result, const char* caller, const char* loc,
+                  const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    if (!shm_enter()) {
+        err_default(result, caller, loc, fmt, args);
+        return;
+    }
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_err) {
+        char buf[LURK_SHM_SLOT_SIZE - LURK_SHM_SLOT_HEADER];
+        size_t size = ring_text < sizeof(buf) ? ring_text : sizeof(buf);
+        size_t len = render_err(buf, size, config, result, caller, loc, fmt, args);
+        if (len >= size) len = size - 1;
+
+        shm_write(true, buf, len);
+    }
+
+    config_exit();
+    shm_exit();
+}
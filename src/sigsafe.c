@@ -0,0 +1,402 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "sigsafe.h"
+#include "timestamp.h"
+#include "internal.h"
+
+// The strings of the config are copied into one of two static buffers whenever the config changes,
+// and the other buffer is filled next time; a record reads whichever one [sigsafe_current] names
+// when it starts. A record interrupted by two config changes in a row may read a mix of two
+// configs, but every string in either buffer is always nul-terminated.
+// ---------------------------------------------------------------------------------------------- //
+struct sigsafe_strings {
+    char projname[LURK_SIGSAFE_STRING_MAX];
+    char prefix[LURK_SIGSAFE_STRING_MAX];
+    char postfix[LURK_SIGSAFE_STRING_MAX];
+};
+
+static struct sigsafe_strings sigsafe_strings[2] = {
+    { .projname = "lurk", .prefix = "", .postfix = "\n" },
+};
+static atomic_uint sigsafe_current = 0;
+
+static void sigsafe_copy(char* dst, const char* src) {
+    size_t n = strlen(src);
+    if (n > LURK_SIGSAFE_STRING_MAX - 1) n = LURK_SIGSAFE_STRING_MAX - 1;
+
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+void sigsafe_publish(const struct config_snapshot* snapshot) {
+    unsigned next = atomic_load_explicit(&sigsafe_current, memory_order_relaxed) ^ 1u;
+    struct sigsafe_strings* s = &sigsafe_strings[next];
+
+    sigsafe_copy(s->projname, snapshot->projname);
+    sigsafe_copy(s->prefix, snapshot->prefix);
+    sigsafe_copy(s->postfix, snapshot->postfix);
+
+    atomic_store_explicit(&sigsafe_current, next, memory_order_release);
+}
+
+
+// The formatter appends to a fixed buffer and counts what did not fit, like [vsnprintf]. It only
+// touches the buffer and its arguments, which is what makes it async-signal-safe.
+// ---------------------------------------------------------------------------------------------- //
+#define SIGSAFE_LEFT  0x01
+#define SIGSAFE_ZERO  0x02
+#define SIGSAFE_PLUS  0x04
+#define SIGSAFE_SPACE 0x08
+#define SIGSAFE_ALT   0x10
+
+enum sigsafe_length {
+    SIGSAFE_INT,
+    SIGSAFE_CHAR,
+    SIGSAFE_SHORT,
+    SIGSAFE_LONG,
+    SIGSAFE_LLONG,
+    SIGSAFE_INTMAX,
+    SIGSAFE_SIZE,
+    SIGSAFE_PTRDIFF,
+    SIGSAFE_LDOUBLE,
+};
+
+struct sigsafe_out {
+    char* buf;
+    size_t cap; // how much of [buf] may be written
+    size_t len; // how much would have been written, which may be more than [cap]
+};
+
+static void sigsafe_putc(struct sigsafe_out* out, char c) {
+    if (out->len < out->cap) out->buf[out->len] = c;
+    out->len++;
+}
+
+static void sigsafe_put(struct sigsafe_out* out, const char* s, size_t n) {
+    for (size_t i = 0; i < n; i++) sigsafe_putc(out, s[i]);
+}
+
+static void sigsafe_pad(struct sigsafe_out* out, char c, int n) {
+    for (; n > 0; n--) sigsafe_putc(out, c);
+}
+
+// renders [n] bytes of [s] padded to [width] with spaces
+static void sigsafe_field(struct sigsafe_out* out, const char* s, size_t n, int width,
+                          unsigned flags) {
+    int pad = width > 0 && (size_t)width > n ? width - (int)n : 0;
+
+    if (!(flags & SIGSAFE_LEFT)) sigsafe_pad(out, ' ', pad);
+    sigsafe_put(out, s, n);
+    if (flags & SIGSAFE_LEFT) sigsafe_pad(out, ' ', pad);
+}
+
+static void sigsafe_integer(struct sigsafe_out* out, uintmax_t value, bool negative,
+                            unsigned base, bool upper, const char* prefix,
+                            int width, int precision, unsigned flags) {
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+    char text[3 * sizeof(uintmax_t)];
+    size_t n = 0;
+    for (; value != 0; value /= base) text[sizeof(text) - ++n] = digits[value % base];
+
+    // the precision is the minimum number of digits; an octal with ['#'] always starts with a zero
+    size_t zeros = precision >= 0 && (size_t)precision > n ? (size_t)precision - n : 0;
+    if (precision < 0 && n == 0) zeros = 1;
+    if (base == 8 && (flags & SIGSAFE_ALT) && zeros == 0) zeros = 1;
+
+    char sign = negative ? '-' : flags & SIGSAFE_PLUS ? '+' : flags & SIGSAFE_SPACE ? ' ' : '\0';
+    size_t prelen = strlen(prefix);
+    size_t total = (sign != '\0') + prelen + zeros + n;
+    int pad = width > 0 && (size_t)width > total ? width - (int)total : 0;
+
+    bool zero_pad = (flags & SIGSAFE_ZERO) && !(flags & SIGSAFE_LEFT) && precision < 0;
+    if (!(flags & SIGSAFE_LEFT) && !zero_pad) sigsafe_pad(out, ' ', pad);
+    if (sign != '\0') sigsafe_putc(out, sign);
+    sigsafe_put(out, prefix, prelen);
+    if (zero_pad) sigsafe_pad(out, '0', pad);
+    sigsafe_pad(out, '0', (int)zeros);
+    sigsafe_put(out, text + sizeof(text) - n, n);
+    if (flags & SIGSAFE_LEFT) sigsafe_pad(out, ' ', pad);
+}
+
+static intmax_t sigsafe_signed(enum sigsafe_length length, va_list* args) {
+    switch (length) {
+        case (SIGSAFE_CHAR): return (signed char)va_arg(*args, int);
+        case (SIGSAFE_SHORT): return (short)va_arg(*args, int);
+        case (SIGSAFE_LONG): return va_arg(*args, long);
+        case (SIGSAFE_LLONG): return va_arg(*args, long long);
+        case (SIGSAFE_INTMAX): return va_arg(*args, intmax_t);
+        case (SIGSAFE_SIZE): return va_arg(*args, ssize_t);
+        case (SIGSAFE_PTRDIFF): return va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, int);
+    }
+}
+
+static uintmax_t sigsafe_unsigned(enum sigsafe_length length, va_list* args) {
+    switch (length) {
+        case (SIGSAFE_CHAR): return (unsigned char)va_arg(*args, unsigned);
+        case (SIGSAFE_SHORT): return (unsigned short)va_arg(*args, unsigned);
+        case (SIGSAFE_LONG): return va_arg(*args, unsigned long);
+        case (SIGSAFE_LLONG): return va_arg(*args, unsigned long long);
+        case (SIGSAFE_INTMAX): return va_arg(*args, uintmax_t);
+        case (SIGSAFE_SIZE): return va_arg(*args, size_t);
+        case (SIGSAFE_PTRDIFF): return (uintmax_t)va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, unsigned);
+    }
+}
+
+static void sigsafe_format(struct sigsafe_out* out, const char* fmt, va_list* args) {
+    while (*fmt != '\0') {
+        if (*fmt != '%') {
+            sigsafe_putc(out, *fmt++);
+            continue;
+        }
+
+        const char* start = fmt++;
+
+        unsigned flags = 0;
+        for (;; fmt++) {
+            if (*fmt == '-') flags |= SIGSAFE_LEFT;
+            else if (*fmt == '0') flags |= SIGSAFE_ZERO;
+            else if (*fmt == '+') flags |= SIGSAFE_PLUS;
+            else if (*fmt == ' ') flags |= SIGSAFE_SPACE;
+            else if (*fmt == '#') flags |= SIGSAFE_ALT;
+            else break;
+        }
+
+        int width = 0;
+        if (*fmt == '*') {
+            width = va_arg(*args, int);
+            if (width < 0) {
+                flags |= SIGSAFE_LEFT;
+                width = width == INT_MIN ? INT_MAX : -width;
+            }
+            fmt++;
+        } else {
+            for (; *fmt >= '0' && *fmt <= '9'; fmt++)
+                if (width < INT_MAX / 10) width = width * 10 + (*fmt - '0');
+        }
+
+        int precision = -1;
+        if (*fmt == '.') {
+            fmt++;
+            if (*fmt == '*') {
+                precision = va_arg(*args, int);
+                if (precision < 0) precision = -1;
+                fmt++;
+            } else {
+                precision = 0;
+                for (; *fmt >= '0' && *fmt <= '9'; fmt++)
+                    if (precision < INT_MAX / 10) precision = precision * 10 + (*fmt - '0');
+            }
+        }
+
+        enum sigsafe_length length = SIGSAFE_INT;
+        switch (*fmt) {
+            case ('h'):
+                length = fmt[1] == 'h' ? SIGSAFE_CHAR : SIGSAFE_SHORT;
+                fmt += fmt[1] == 'h' ? 2 : 1;
+                break;
+            case ('l'):
+                length = fmt[1] == 'l' ? SIGSAFE_LLONG : SIGSAFE_LONG;
+                fmt += fmt[1] == 'l' ? 2 : 1;
+                break;
+            case ('q'): length = SIGSAFE_LLONG; fmt++; break;
+            case ('j'): length = SIGSAFE_INTMAX; fmt++; break;
+            case ('z'): length = SIGSAFE_SIZE; fmt++; break;
+            case ('t'): length = SIGSAFE_PTRDIFF; fmt++; break;
+            case ('L'): length = SIGSAFE_LDOUBLE; fmt++; break;
+        }
+
+        switch (*fmt) {
+            case ('d'):
+            case ('i'): {
+                intmax_t v = sigsafe_signed(length, args);
+                uintmax_t magnitude = v < 0 ? -(uintmax_t)v : (uintmax_t)v;
+                sigsafe_integer(out, magnitude, v < 0, 10, false, "", width, precision, flags);
+                break;
+            }
+            case ('u'):
+            case ('o'):
+            case ('x'):
+            case ('X'): {
+                uintmax_t v = sigsafe_unsigned(length, args);
+                unsigned base = *fmt == 'u' ? 10 : *fmt == 'o' ? 8 : 16;
+                const char* prefix = "";
+                if (base == 16 && (flags & SIGSAFE_ALT) && v != 0)
+                    prefix = *fmt == 'X' ? "0X" : "0x";
+
+                flags &= ~(unsigned)(SIGSAFE_PLUS | SIGSAFE_SPACE);
+                sigsafe_integer(out, v, false, base, *fmt == 'X', prefix, width, precision, flags);
+                break;
+            }
+            case ('p'): {
+                uintptr_t p = (uintptr_t)va_arg(*args, void*);
+                if (p == 0) sigsafe_field(out, "(nil)", 5, width, flags);
+                else sigsafe_integer(out, p, false, 16, false, "0x", width, -1,
+                                     flags & SIGSAFE_LEFT);
+                break;
+            }
+            case ('c'): {
+                char c = (char)va_arg(*args, int);
+                sigsafe_field(out, &c, 1, width, flags);
+                break;
+            }
+            case ('s'): {
+                const char* s = va_arg(*args, const char*);
+                if (s == NULL) s = precision < 0 || precision >= 6 ? "(null)" : "";
+
+                size_t n = 0;
+                while ((precision < 0 || n < (size_t)precision) && s[n] != '\0') n++;
+                sigsafe_field(out, s, n, width, flags);
+                break;
+            }
+            case ('e'):
+            case ('E'):
+            case ('f'):
+            case ('F'):
+            case ('g'):
+            case ('G'):
+            case ('a'):
+            case ('A'):
+                // floating point is out of reach without the locale and the C library's conversion
+                if (length == SIGSAFE_LDOUBLE) (void)va_arg(*args, long double);
+                else (void)va_arg(*args, double);
+                sigsafe_field(out, "?", 1, width, flags);
+                break;
+            case ('n'):
+                (void)va_arg(*args, void*);
+                break;
+            case ('%'):
+                sigsafe_putc(out, '%');
+                break;
+            case ('\0'):
+                sigsafe_put(out, start, (size_t)(fmt - start));
+                return;
+            default:
+                // an unknown conversion is left as it was written
+                sigsafe_put(out, start, (size_t)(fmt - start) + 1);
+                break;
+        }
+
+        fmt++;
+    }
+}
+
+static void sigsafe_append(struct sigsafe_out* out, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    sigsafe_format(out, fmt, &args);
+    va_end(args);
+}
+
+size_t lurk_format_sigsafe(char* buf, size_t size, const char* fmt, va_list args) {
+    struct sigsafe_out out = { .buf = buf, .cap = size > 0 ? size - 1 : 0, .len = 0 };
+
+    va_list copy;
+    va_copy(copy, args);
+    sigsafe_format(&out, fmt, &copy);
+    va_end(copy);
+
+    if (size > 0) buf[out.len < out.cap ? out.len : out.cap] = '\0';
+    return out.len;
+}
+
+
+// A record is rendered on the stack exactly like [render_log] and [render_err] render one in the
+// text format, then written with a single [write]. A failed write is dropped: there is nobody left
+// to tell in a crash handler, and aborting from one would hide the signal being handled.
+// ---------------------------------------------------------------------------------------------- //
+static void sigsafe_write(int fd, bool err, result_t result, const char* caller, const char* loc,
+                          const char* fmt, va_list args) {
+    int saved = errno;
+
+    const struct sigsafe_strings* s =
+        &sigsafe_strings[atomic_load_explicit(&sigsafe_current, memory_order_acquire)];
+    size_t postlen = strlen(s->postfix);
+
+    char buf[LURK_SIGSAFE_RECORD_SIZE];
+    struct sigsafe_out out = { .buf = buf, .cap = sizeof(buf) - postlen, .len = 0 };
+
+    char stamp[LURK_TIMESTAMP_SIZE];
+    timestamp_render(stamp, lurk_timestamp());
+
+    // a registered result is printed by its name (see [domain.h])
+    const char* name = lurk_result_name(result);
+    if (name != NULL) sigsafe_append(&out, "%s  %s  [%s", stamp, name, s->projname);
+    else sigsafe_append(&out, "%s  %08x  [%s", stamp, result, s->projname);
+
+    if (err) {
+        sigsafe_append(&out, ":%s.%s", caller != NULL ? caller : "(unknown)",
+                       loc != NULL ? loc : "???");
+    }
+
+    sigsafe_append(&out, "]  %s", s->prefix);
+
+    va_list copy;
+    va_copy(copy, args);
+    sigsafe_format(&out, fmt, &copy);
+    va_end(copy);
+
+    size_t len = out.len < out.cap ? out.len : out.cap;
+    memcpy(buf + len, s->postfix, postlen);
+    len += postlen;
+
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        p += n;
+        len -= (size_t)n;
+    }
+
+    errno = saved;
+}
+
+void lurk_sigsafe_log(result_t result, const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+    if (!(__atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED) & LURK_ENABLED_LOG)) return;
+
+    sigsafe_write(STDOUT_FILENO, false, result, NULL, NULL, fmt, args);
+}
+
+void lurk_sigsafe_err(result_t result, const char* caller, const char* loc,
+                      const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+    if (!(__atomic_load_n(&lurk_enabled, __ATOMIC_RELAXED) & LURK_ENABLED_ERR)) return;
+
+    sigsafe_write(STDERR_FILENO, true, result, caller, loc, fmt, args);
+}
+
+result_t lurk_log_sigsafe(result_t result, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    lurk_sigsafe_log(result, fmt, args);
+    va_end(args);
+
+    return result;
+}
+
+result_t lurk_err_sigsafe(result_t result,
+                          const char* caller, const char* loc, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    lurk_sigsafe_err(result, caller, loc, fmt, args);
+    va_end(args);
+
+    return result;
+}
@@ -0,0 +1,385 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "site.h"
+#include "internal.h"
+
+#define SITE_CHUNK 1024
+#define SITE_CHUNKS (LURK_SITE_HITS_MAX / SITE_CHUNK)
+
+#ifdef LURK_HAVE_SITES
+// the linker defines these around the [lurk_sites] section; they are weak so that a program without
+// any call sites still links
+extern const lurk_site_t __start_lurk_sites[] __attribute__((weak, visibility("hidden")));
+extern const lurk_site_t __stop_lurk_sites[] __attribute__((weak, visibility("hidden")));
+#endif
+
+size_t lurk_get_sites(const lurk_site_t** sites) {
+    if (sites == NULL) return 0;
+
+    *sites = NULL;
+
+#ifdef LURK_HAVE_SITES
+    if (__start_lurk_sites == NULL || __stop_lurk_sites == NULL) return 0;
+
+    *sites = __start_lurk_sites;
+    return (size_t)(__stop_lurk_sites - __start_lurk_sites);
+#else
+    return 0;
+#endif
+}
+
+static bool site_matches(const lurk_site_t* site, const char* pattern) {
+    if (site->caller != NULL && fnmatch(pattern, site->caller, 0) == 0) return true;
+    if (site->file == NULL) return false;
+    if (fnmatch(pattern, site->file, 0) == 0) return true;
+
+    char where[512];
+    int n = snprintf(where, sizeof(where), "%s:%d", site->file, site->line);
+    return n > 0 && (size_t)n < sizeof(where) && fnmatch(pattern, where, 0) == 0;
+}
+
+size_t lurk_sites_set_enabled(const char* pattern, bool enabled) {
+    if (pattern == NULL) return 0;
+
+    const lurk_site_t* sites;
+    size_t n = lurk_get_sites(&sites);
+    size_t matched = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (sites[i].state == NULL || !site_matches(&sites[i], pattern)) continue;
+
+        __atomic_store_n(&sites[i].state->disabled, !enabled, __ATOMIC_RELAXED);
+        matched++;
+    }
+
+    return matched;
+}
+
+bool lurk_site_enabled(const lurk_site_t* site) {
+    if (site == NULL) return false;
+    if (site->state == NULL) return true;
+
+    return !__atomic_load_n(&site->state->disabled, __ATOMIC_RELAXED);
+}
+
+// Each thread counts hits in a shard of its own that only it writes. The counters of a shard come
+// in chunks of [SITE_CHUNK], allocated the first time a site in them is hit and never moved, so a
+// ranking can read them while the owner keeps counting. Like the shards of the result counters
+// (see [counters.c]), a shard outlives its thread and is taken over by the next one.
+struct site_shard {
+    _Atomic(uint64_t*) chunks[SITE_CHUNKS];
+    struct site_shard* next;
+    atomic_bool in_use;
+};
+
+static _Atomic(struct site_shard*) site_shards = NULL;
+static _Thread_local struct site_shard* site_shard = NULL;
+static pthread_key_t site_key;
+static pthread_once_t site_once = PTHREAD_ONCE_INIT;
+
+// the sites in the order they were first hit, and their counts at the previous ranking; only
+// touched while holding [site_lock]
+static const lurk_site_t** site_registry = NULL;
+static uint64_t* site_previous = NULL;
+static size_t site_count = 0;
+static size_t site_capacity = 0;
+static uint64_t site_since = 0;
+static pthread_mutex_t site_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t dump_n = 0;
+static int dump_signo = 0;
+static struct sigaction dump_previous;
+static atomic_bool dump_stopping = false;
+static bool dump_running = false;
+static sem_t dump_wake;
+static pthread_t dump_thread;
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t site_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void site_release_shard(void* shard) {
+    struct site_shard* s = shard;
+
+    if (site_shard == s) site_shard = NULL;
+    atomic_store_explicit(&s->in_use, false, memory_order_release);
+}
+
+// a forked child only has the forking thread, so the shards of every other thread are free again
+static void site_postfork_child(void) {
+    struct site_shard* own = site_shard;
+
+    for (struct site_shard* s = atomic_load(&site_shards); s != NULL; s = s->next) {
+        if (s != own) site_release_shard(s);
+    }
+
+    pthread_mutex_init(&site_lock, NULL);
+}
+
+static void site_init_key(void) {
+    if (pthread_key_create(&site_key, &site_release_shard) != 0) abort();
+    if (pthread_atfork(NULL, NULL, &site_postfork_child) != 0) abort();
+}
+
+// claims a free shard for the calling thread, taking over those of exited threads
+static struct site_shard* site_claim(void) {
+    pthread_once(&site_once, &site_init_key);
+
+    struct site_shard* s = atomic_load_explicit(&site_shards, memory_order_acquire);
+    for (; s != NULL; s = s->next) {
+        bool unused = false;
+        if (atomic_compare_exchange_strong(&s->in_use, &unused, true)) break;
+    }
+
+    if (s == NULL) {
+        s = calloc(1, sizeof(*s));
+        if (s == NULL) abort();
+
+        atomic_init(&s->in_use, true);
+        s->next = atomic_load_explicit(&site_shards, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&site_shards, &s->next, s,
+                                                      memory_order_release,
+                                                      memory_order_relaxed)) {}
+    }
+
+    pthread_setspecific(site_key, s);
+    return s;
+}
+
+// gives [site] the next index, unless another thread just did; returns [0] if there is no room
+static unsigned site_register(const lurk_site_t* site) {
+    pthread_mutex_lock(&site_lock);
+
+    unsigned index = __atomic_load_n(&site->state->index, __ATOMIC_RELAXED);
+    if (index == 0 && site_count < LURK_SITE_HITS_MAX) {
+        if (site_count == site_capacity) {
+            size_t n = site_capacity == 0 ? 64 : site_capacity * 2;
+            const lurk_site_t** registry = realloc(site_registry, n * sizeof(*registry));
+            if (registry != NULL) site_registry = registry;
+            uint64_t* previous = realloc(site_previous, n * sizeof(*previous));
+            if (previous != NULL) site_previous = previous;
+
+            if (registry != NULL && previous != NULL) site_capacity = n;
+        }
+
+        if (site_count < site_capacity) {
+            site_registry[site_count] = site;
+            site_previous[site_count] = 0;
+            index = (unsigned)++site_count;
+            __atomic_store_n(&site->state->index, index, __ATOMIC_RELAXED);
+        }
+    }
+
+    pthread_mutex_unlock(&site_lock);
+    return index;
+}
+
+static uint64_t* site_chunk(struct site_shard* s, size_t chunk) {
+    uint64_t* counts = calloc(SITE_CHUNK, sizeof(*counts));
+    if (counts != NULL) atomic_store_explicit(&s->chunks[chunk], counts, memory_order_release);
+    return counts;
+}
+
+void site_hit(const lurk_site_t* site) {
+    if (site == NULL || site->state == NULL) return;
+
+    unsigned index = __atomic_load_n(&site->state->index, __ATOMIC_RELAXED);
+    if (index == 0 && (index = site_register(site)) == 0) return;
+    index--;
+
+    struct site_shard* s = site_shard;
+    if (s == NULL) s = site_shard = site_claim();
+
+    uint64_t* chunk = atomic_load_explicit(&s->chunks[index / SITE_CHUNK], memory_order_relaxed);
+    if (chunk == NULL && (chunk = site_chunk(s, index / SITE_CHUNK)) == NULL) return;
+
+    uint64_t* hits = &chunk[index % SITE_CHUNK];
+    __atomic_store_n(hits, __atomic_load_n(hits, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+result_t lurk_site_hits_enable(bool enable) {
+    pthread_mutex_lock(&site_lock);
+    if (enable && site_since == 0) site_since = site_now();
+    pthread_mutex_unlock(&site_lock);
+
+    config_set_tally(LURK_ENABLED_HITS, enable);
+    return RESULT_SUCCESS;
+}
+
+static int site_compare(const void* a, const void* b) {
+    uint64_t x = ((const struct lurk_site_hits*)a)->hits;
+    uint64_t y = ((const struct lurk_site_hits*)b)->hits;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+size_t lurk_site_hits_top(struct lurk_site_hits* top, size_t n) {
+    pthread_mutex_lock(&site_lock);
+
+    size_t count = site_count;
+    struct lurk_site_hits* all = count > 0 ? malloc(count * sizeof(*all)) : NULL;
+    if (all == NULL) {
+        pthread_mutex_unlock(&site_lock);
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) all[i] = (struct lurk_site_hits){ site_registry[i], 0, 0 };
+
+    struct site_shard* s = atomic_load_explicit(&site_shards, memory_order_acquire);
+    for (; s != NULL; s = s->next) {
+        for (size_t c = 0; c * SITE_CHUNK < count; c++) {
+            uint64_t* chunk = atomic_load_explicit(&s->chunks[c], memory_order_acquire);
+            if (chunk == NULL) continue;
+
+            size_t end = count - c * SITE_CHUNK < SITE_CHUNK ? count - c * SITE_CHUNK : SITE_CHUNK;
+            for (size_t i = 0; i < end; i++)
+                all[c * SITE_CHUNK + i].hits += __atomic_load_n(&chunk[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    uint64_t now = site_now();
+    double seconds = site_since > 0 && now > site_since ? (double)(now - site_since) / 1e9 : 0;
+    for (size_t i = 0; i < count; i++) {
+        if (seconds > 0) all[i].rate = (double)(all[i].hits - site_previous[i]) / seconds;
+        site_previous[i] = all[i].hits;
+    }
+    site_since = now;
+
+    pthread_mutex_unlock(&site_lock);
+
+    qsort(all, count, sizeof(*all), &site_compare);
+
+    size_t ranked = count < n ? count : n;
+    if (ranked > 0) memcpy(top, all, ranked * sizeof(*top));
+
+    free(all);
+    return ranked;
+}
+
+size_t lurk_site_hits_format(char* buf, size_t size, const struct lurk_site_hits* top, size_t n) {
+    size_t len = 0;
+    if (size > 0) buf[0] = '\0';
+    if (top == NULL) return 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const lurk_site_t* site = top[i].site;
+        size_t at = len < size ? len : size;
+
+        int w = snprintf(size > at ? buf + at : NULL, size - at,
+                         "%4zu  %12llu hits  %12.1f/s  %s  (%s:%d)\n", i + 1,
+                         (unsigned long long)top[i].hits, top[i].rate,
+                         site->caller != NULL ? site->caller : "(unknown)",
+                         site->file != NULL ? site->file : "???", site->line);
+        if (w > 0) len += (size_t)w;
+    }
+
+    return len;
+}
+
+static void dump_signal(int signo) {
+    (void)signo;
+
+    int saved = errno;
+    sem_post(&dump_wake);
+    errno = saved;
+}
+
+static void* dump_main(void* arg) {
+    (void)arg;
+
+    for (;;) {
+        while (sem_wait(&dump_wake) != 0 && errno == EINTR);
+        if (atomic_load(&dump_stopping)) break;
+
+        struct lurk_site_hits* top = malloc(dump_n * sizeof(*top));
+        if (top == NULL) continue;
+        size_t ranked = lurk_site_hits_top(top, dump_n);
+
+        size_t len = lurk_site_hits_format(NULL, 0, top, ranked);
+        char* text = malloc(len + 1);
+        if (text != NULL) {
+            lurk_site_hits_format(text, len + 1, top, ranked);
+            write_record(STDERR_FILENO, text, len);
+            free(text);
+        }
+
+        free(top);
+    }
+
+    return NULL;
+}
+
+result_t lurk_site_hits_dump_on(int signo, size_t n) {
+    if (n == 0) return RETURN_BAD_PARAM_MSG(n, "Must not be zero.");
+
+    pthread_mutex_lock(&dump_lock);
+
+    if (dump_running) {
+        pthread_mutex_unlock(&dump_lock);
+        return RESULT_FAILURE;
+    }
+
+    dump_n = n;
+    dump_signo = signo;
+    atomic_store(&dump_stopping, false);
+    sem_init(&dump_wake, 0, 0);
+
+    if (pthread_create(&dump_thread, NULL, &dump_main, NULL) != 0) {
+        sem_destroy(&dump_wake);
+        pthread_mutex_unlock(&dump_lock);
+        return RETURN_ERROR(RESULT_INTERNAL_ERROR, "Could not create the dump thread.");
+    }
+
+    struct sigaction action = { .sa_handler = &dump_signal, .sa_flags = SA_RESTART };
+    sigemptyset(&action.sa_mask);
+    if (sigaction(signo, &action, &dump_previous) != 0) {
+        atomic_store(&dump_stopping, true);
+        sem_post(&dump_wake);
+        pthread_join(dump_thread, NULL);
+        sem_destroy(&dump_wake);
+        pthread_mutex_unlock(&dump_lock);
+        return RETURN_ERROR_FMT(RESULT_INTERNAL_ERROR, "Could not handle signal %d.", signo);
+    }
+
+    dump_running = true;
+
+    pthread_mutex_unlock(&dump_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_site_hits_dump_off(void) {
+    pthread_mutex_lock(&dump_lock);
+
+    if (!dump_running) {
+        pthread_mutex_unlock(&dump_lock);
+        return RESULT_FAILURE;
+    }
+
+    sigaction(dump_signo, &dump_previous, NULL);
+
+    atomic_store(&dump_stopping, true);
+    sem_post(&dump_wake);
+    pthread_join(dump_thread, NULL);
+    sem_destroy(&dump_wake);
+    dump_running = false;
+
+    pthread_mutex_unlock(&dump_lock);
+    return RESULT_SUCCESS;
+}
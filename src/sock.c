@@ -0,0 +1,599 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "sock.h"
+#include "internal.h"
+
+#define SOCK_CACHE_LINE 64
+#define SOCK_CONNECT_TIMEOUT_MS 1000
+#define SOCK_POLL_MS 100
+#define SOCK_HOST_MAX 256
+
+// the top bit of [sock_head] marks the ring as closed, exactly like in [async.c]
+#define SOCK_CLOSED ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 1))
+
+// The ring works like the one of the asynchronous mode (see [async.c]): a slot's sequence number
+// equals its position while it is free for the producer reserving that position, the position plus
+// one once the record is published, and the position plus the capacity once the sender has sent it
+// and handed it back. The sender fills in the time just before first sending a record.
+struct sock_slot {
+    atomic_size_t seq;
+    size_t len;
+    uint64_t stamp; // [0] once the time has been filled in
+    char data[LURK_SOCK_RECORD_SIZE];
+};
+
+static struct sock_slot* sock_slots = NULL;
+static size_t sock_mask = 0;
+
+static _Alignas(SOCK_CACHE_LINE) atomic_size_t sock_head = SOCK_CLOSED;
+static _Alignas(SOCK_CACHE_LINE) size_t sock_tail = 0;
+static _Alignas(SOCK_CACHE_LINE) atomic_size_t sock_sent = 0;
+static atomic_size_t sock_dropped = 0;
+static size_t sock_dropped_reported = 0;
+
+// only touched by the sender: the socket, and how much of the record at [sock_tail] went out
+static int sock_fd = -1;
+static size_t sock_partial = 0;
+
+static struct sockaddr_storage sock_addr;
+static socklen_t sock_addrlen = 0;
+
+static atomic_bool sock_up = false;
+static atomic_bool sock_running = false;
+static atomic_bool sock_idle = false;
+static sem_t sock_wake;
+static pthread_t sock_sender;
+
+static atomic_int sock_flushers = 0;
+static pthread_mutex_t sock_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sock_flush_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_mutex_t sock_control_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool sock_hooks_registered = false;
+
+enum sock_reserve {
+    SOCK_RESERVED,
+    SOCK_FULL,
+    SOCK_NOT_RUNNING,
+};
+
+enum sock_send {
+    SOCK_EMPTY,
+    SOCK_SENT,
+    SOCK_BLOCKED,
+    SOCK_BROKEN,
+};
+
+static enum sock_reserve sock_reserve(size_t* pos) {
+    size_t p = atomic_load_explicit(&sock_head, memory_order_acquire);
+
+    for (;;) {
+        if (p & SOCK_CLOSED) return SOCK_NOT_RUNNING;
+
+        struct sock_slot* slot = &sock_slots[p & sock_mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - p);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&sock_head, &p, p + 1,
+                                                      memory_order_acq_rel,
+                                                      memory_order_acquire)) {
+                *pos = p;
+                return SOCK_RESERVED;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&sock_dropped, 1, memory_order_relaxed);
+            return SOCK_FULL;
+        } else {
+            p = atomic_load_explicit(&sock_head, memory_order_acquire);
+        }
+    }
+}
+
+// the fence pairs with the one in [sock_main] like in [async.c]: without both, the producer and
+// the sender may each miss the other's store, and the sender sleeps on a published record
+static void sock_publish(size_t pos) {
+    atomic_store_explicit(&sock_slots[pos & sock_mask].seq, pos + 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load(&sock_idle) && atomic_exchange(&sock_idle, false)) sem_post(&sock_wake);
+}
+
+static uint64_t sock_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+// sleeps for [ms] milliseconds, or until [lurk_sock_stop] wakes the sender
+static void sock_wait(unsigned ms) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    while (sem_timedwait(&sock_wake, &until) != 0 && errno == EINTR) {}
+}
+
+// parses [address] (see [lurk_sock_start]) into [sock_addr]
+static bool sock_resolve(const char* address) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un* un = (struct sockaddr_un*)&sock_addr;
+        const char* path = address + 5;
+        size_t len = strlen(path);
+        if (len == 0 || len >= sizeof(un->sun_path)) return false;
+
+        memset(un, 0, sizeof(*un));
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path, len + 1);
+        sock_addrlen = (socklen_t)sizeof(*un);
+        return true;
+    }
+
+    if (strncmp(address, "tcp:", 4) != 0) return false;
+
+    const char* host = address + 4;
+    const char* colon = strrchr(host, ':');
+    if (colon == NULL || colon[1] == '\0') return false;
+
+    size_t hostlen = (size_t)(colon - host);
+    if (hostlen >= 2 && host[0] == '[' && host[hostlen - 1] == ']') {
+        host++;
+        hostlen -= 2;
+    }
+
+    char name[SOCK_HOST_MAX];
+    if (hostlen == 0 || hostlen >= sizeof(name)) return false;
+    memcpy(name, host, hostlen);
+    name[hostlen] = '\0';
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* found = NULL;
+    if (getaddrinfo(name, colon + 1, &hints, &found) != 0) return false;
+
+    bool fits = found->ai_addrlen <= sizeof(sock_addr);
+    if (fits) {
+        memcpy(&sock_addr, found->ai_addr, found->ai_addrlen);
+        sock_addrlen = found->ai_addrlen;
+    }
+
+    freeaddrinfo(found);
+    return fits;
+}
+
+// makes one attempt at connecting, waiting at most [SOCK_CONNECT_TIMEOUT_MS]; returns the
+// non-blocking socket, or [-1]
+static int sock_connect(void) {
+    int fd = socket(sock_addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int flags = fcntl(fd, F_GETFL);
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0 || flags < 0 ||
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr*)&sock_addr, sock_addrlen) != 0) {
+        struct pollfd p = { .fd = fd, .events = POLLOUT };
+        int err = 0;
+        socklen_t errlen = sizeof(err);
+
+        if ((errno != EINPROGRESS && errno != EINTR) ||
+            poll(&p, 1, SOCK_CONNECT_TIMEOUT_MS) <= 0 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) != 0 || err != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    // frames are already coalesced here, so Nagle's algorithm would only delay them
+    if (sock_addr.ss_family != AF_UNIX) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+
+    return fd;
+}
+
+static void sock_report_drops(void) {
+    size_t total = atomic_load_explicit(&sock_dropped, memory_order_relaxed);
+    if (total == sock_dropped_reported) return;
+
+    char notice[96];
+    int n = snprintf(notice, sizeof(notice), "lurk: socket sink dropped %zu records\n",
+                     total - sock_dropped_reported);
+    sock_dropped_reported = total;
+
+    if (n > 0) write_record(STDERR_FILENO, notice, (size_t)n);
+}
+
+// hands the slots before [pos] back to the producers once their records are sent
+static void sock_release(size_t pos) {
+    for (size_t p = sock_tail; p != pos; p++)
+        atomic_store_explicit(&sock_slots[p & sock_mask].seq, p + sock_mask + 1,
+                              memory_order_release);
+
+    sock_tail = pos;
+    atomic_store(&sock_sent, pos);
+
+    if (atomic_load(&sock_flushers) > 0) {
+        pthread_mutex_lock(&sock_flush_lock);
+        pthread_cond_broadcast(&sock_flush_cond);
+        pthread_mutex_unlock(&sock_flush_lock);
+    }
+}
+
+static bool sock_pending(void) {
+    size_t seq = atomic_load_explicit(&sock_slots[sock_tail & sock_mask].seq, memory_order_acquire);
+    return seq == sock_tail + 1;
+}
+
+// sends one frame of the consecutive published records at the tail of the ring, releasing the
+// records that went out completely
+static enum sock_send sock_send(int fd) {
+    struct iovec iov[LURK_SOCK_BATCH];
+    int count = 0;
+
+    for (size_t pos = sock_tail; count < LURK_SOCK_BATCH; pos++, count++) {
+        struct sock_slot* slot = &sock_slots[pos & sock_mask];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) break;
+
+        if (slot->stamp != 0) {
+            render_stamp(slot->data, slot->stamp);
+            slot->stamp = 0;
+        }
+
+        size_t skip = count == 0 ? sock_partial : 0;
+        iov[count].iov_base = slot->data + skip;
+        iov[count].iov_len = slot->len - skip;
+    }
+
+    if (count == 0) return SOCK_EMPTY;
+
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = (size_t)count };
+    ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (n < 0) {
+        if (errno == EINTR) return SOCK_SENT;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return SOCK_BLOCKED;
+        return SOCK_BROKEN;
+    }
+
+    size_t done = (size_t)n;
+    int i = 0;
+    while (i < count && done >= iov[i].iov_len) done -= iov[i++].iov_len;
+
+    if (i == count) sock_partial = 0;
+    else sock_partial = (i == 0 ? sock_partial : 0) + done;
+
+    sock_release(sock_tail + (size_t)i);
+    return SOCK_SENT;
+}
+
+// drops the records left in the ring once the sender gives up on them at a stop
+static void sock_discard(size_t head) {
+    for (size_t p = sock_tail; p != head; p++) {
+        struct sock_slot* slot = &sock_slots[p & sock_mask];
+
+        // a producer that reserved the slot before the stop is still rendering into it
+        while (atomic_load_explicit(&slot->seq, memory_order_acquire) != p + 1) sched_yield();
+
+        atomic_store_explicit(&slot->seq, p + sock_mask + 1, memory_order_release);
+        atomic_fetch_add_explicit(&sock_dropped, 1, memory_order_relaxed);
+    }
+
+    sock_tail = head;
+    sock_partial = 0;
+}
+
+static void* sock_main(void* arg) {
+    (void)arg;
+
+    unsigned backoff = LURK_SOCK_BACKOFF_MIN_MS;
+    uint64_t deadline = 0;
+
+    for (;;) {
+        size_t h = atomic_load(&sock_head);
+        if (h & SOCK_CLOSED) {
+            if (deadline == 0) deadline = sock_now_ms() + LURK_SOCK_STOP_TIMEOUT_MS;
+            if (sock_tail == (h & ~SOCK_CLOSED) || sock_now_ms() >= deadline) break;
+        }
+
+        if (sock_fd < 0) {
+            sock_fd = sock_connect();
+            if (sock_fd < 0) {
+                sock_report_drops();
+                sock_wait(backoff);
+                backoff = backoff * 2 < LURK_SOCK_BACKOFF_MAX_MS
+                        ? backoff * 2 : LURK_SOCK_BACKOFF_MAX_MS;
+                continue;
+            }
+
+            backoff = LURK_SOCK_BACKOFF_MIN_MS;
+            atomic_store(&sock_up, true);
+        }
+
+        switch (sock_send(sock_fd)) {
+            case (SOCK_SENT):
+                sock_report_drops();
+                continue;
+            case (SOCK_BLOCKED): {
+                struct pollfd p = { .fd = sock_fd, .events = POLLOUT };
+                poll(&p, 1, SOCK_POLL_MS);
+                continue;
+            }
+            case (SOCK_BROKEN):
+                // the record that was cut off goes out again in full on the next connection
+                close(sock_fd);
+                sock_fd = -1;
+                sock_partial = 0;
+                atomic_store(&sock_up, false);
+                continue;
+            case (SOCK_EMPTY):
+                break;
+        }
+
+        // at a stop, a producer is still rendering into the slot at the tail
+        if (h & SOCK_CLOSED) {
+            sched_yield();
+            continue;
+        }
+
+        atomic_store(&sock_idle, true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sock_pending() || (atomic_load(&sock_head) & SOCK_CLOSED)) {
+            atomic_store(&sock_idle, false);
+            continue;
+        }
+
+        while (sem_wait(&sock_wake) != 0 && errno == EINTR) {}
+        atomic_store(&sock_idle, false);
+    }
+
+    if (sock_fd >= 0) close(sock_fd);
+    sock_fd = -1;
+    atomic_store(&sock_up, false);
+
+    sock_discard(atomic_load(&sock_head) & ~SOCK_CLOSED);
+    sock_report_drops();
+
+    pthread_mutex_lock(&sock_flush_lock);
+    atomic_store(&sock_running, false);
+    pthread_cond_broadcast(&sock_flush_cond);
+    pthread_mutex_unlock(&sock_flush_lock);
+
+    return NULL;
+}
+
+static void sock_atexit(void) {
+    lurk_sock_stop();
+}
+
+static void sock_prefork(void) {
+    pthread_mutex_lock(&sock_control_lock);
+}
+
+static void sock_postfork_parent(void) {
+    pthread_mutex_unlock(&sock_control_lock);
+}
+
+// the sender does not exist in the child and its connection belongs to the parent, so the child
+// starts over with an empty, stopped ring
+static void sock_postfork_child(void) {
+    if (sock_slots != NULL) {
+        for (size_t i = 0; i <= sock_mask; i++) atomic_init(&sock_slots[i].seq, i);
+    }
+
+    if (sock_fd >= 0) close(sock_fd);
+    sock_fd = -1;
+    sock_partial = 0;
+
+    atomic_init(&sock_head, SOCK_CLOSED);
+    sock_tail = 0;
+    atomic_init(&sock_sent, 0);
+    atomic_init(&sock_up, false);
+    atomic_init(&sock_running, false);
+    atomic_init(&sock_idle, false);
+    atomic_init(&sock_flushers, 0);
+
+    sem_init(&sock_wake, 0, 0);
+    pthread_mutex_init(&sock_flush_lock, NULL);
+    pthread_cond_init(&sock_flush_cond, NULL);
+    pthread_mutex_init(&sock_control_lock, NULL);
+}
+
+result_t lurk_sock_start(const char* address, size_t capacity) {
+    if (address == NULL) return RETURN_BAD_PARAM_NULL(address);
+    if ((capacity & (capacity - 1)) != 0)
+        return RETURN_BAD_PARAM_MSG(capacity, "Must be a power of two.");
+
+    pthread_mutex_lock(&sock_control_lock);
+
+    if (capacity == 0) capacity = (sock_slots != NULL) ? sock_mask + 1 : LURK_SOCK_DEFAULT_CAPACITY;
+
+    if (!(atomic_load(&sock_head) & SOCK_CLOSED)) {
+        pthread_mutex_unlock(&sock_control_lock);
+        return RESULT_FAILURE;
+    }
+
+    // producers may still be looking at the ring after a stop, so it is kept for the life of the
+    // process once allocated and its capacity is fixed from then on
+    if (sock_slots != NULL && capacity != sock_mask + 1) {
+        pthread_mutex_unlock(&sock_control_lock);
+        return RETURN_BAD_PARAM_MSG(capacity, "Must match the capacity of the first start.");
+    }
+
+    if (!sock_resolve(address)) {
+        pthread_mutex_unlock(&sock_control_lock);
+        return RETURN_BAD_PARAM_MSG(address, "Could not be parsed or resolved.");
+    }
+
+    if (sock_slots == NULL) {
+        struct sock_slot* s = malloc(capacity * sizeof(*s));
+        if (s == NULL) {
+            pthread_mutex_unlock(&sock_control_lock);
+            return RETURN_INTERNAL_ERROR_MSG("Could not allocate the socket ring.");
+        }
+
+        for (size_t i = 0; i < capacity; i++) atomic_init(&s[i].seq, i);
+
+        sock_slots = s;
+        sock_mask = capacity - 1;
+    }
+
+    // like in [async.c], the semaphore is never destroyed
+    if (!sock_hooks_registered) {
+        sem_init(&sock_wake, 0, 0);
+        if (atexit(&sock_atexit) != 0 ||
+            pthread_atfork(&sock_prefork, &sock_postfork_parent, &sock_postfork_child) != 0) {
+            pthread_mutex_unlock(&sock_control_lock);
+            return RETURN_INTERNAL_ERROR_MSG("Could not register the socket exit and fork hooks.");
+        }
+        sock_hooks_registered = true;
+    }
+
+    atomic_store(&sock_idle, false);
+    atomic_store(&sock_running, true);
+
+    size_t pos = sock_tail;
+    atomic_store(&sock_head, pos);
+
+    if (pthread_create(&sock_sender, NULL, &sock_main, NULL) != 0) {
+        atomic_store(&sock_head, pos | SOCK_CLOSED);
+        atomic_store(&sock_running, false);
+        pthread_mutex_unlock(&sock_control_lock);
+        return RETURN_INTERNAL_ERROR_MSG("Could not create the socket sender thread.");
+    }
+
+    pthread_mutex_unlock(&sock_control_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_sock_stop(void) {
+    pthread_mutex_lock(&sock_control_lock);
+
+    if (atomic_fetch_or(&sock_head, SOCK_CLOSED) & SOCK_CLOSED) {
+        pthread_mutex_unlock(&sock_control_lock);
+        return RESULT_FAILURE;
+    }
+
+    sem_post(&sock_wake);
+    pthread_join(sock_sender, NULL);
+
+    pthread_mutex_unlock(&sock_control_lock);
+    return RESULT_SUCCESS;
+}
+
+result_t lurk_sock_flush(void) {
+    size_t target = atomic_load(&sock_head);
+    if (target & SOCK_CLOSED) return RESULT_FAILURE;
+
+    atomic_fetch_add(&sock_flushers, 1);
+
+    // wake the sender if it went idle, but do not cut a reconnect backoff short
+    if (atomic_exchange(&sock_idle, false)) sem_post(&sock_wake);
+
+    pthread_mutex_lock(&sock_flush_lock);
+
+    bool pending;
+    while ((pending = (ptrdiff_t)(atomic_load(&sock_sent) - target) < 0) &&
+           atomic_load(&sock_running))
+        pthread_cond_wait(&sock_flush_cond, &sock_flush_lock);
+
+    pthread_mutex_unlock(&sock_flush_lock);
+    atomic_fetch_sub(&sock_flushers, 1);
+
+    return pending ? RESULT_FAILURE : RESULT_SUCCESS;
+}
+
+bool lurk_sock_connected(void) {
+    return atomic_load(&sock_up);
+}
+
+size_t lurk_sock_dropped(void) {
+    return atomic_load_explicit(&sock_dropped, memory_order_relaxed);
+}
+
+void lurk_sock_log(result_t result, const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_log) {
+        size_t pos;
+        switch (sock_reserve(&pos)) {
+            case (SOCK_NOT_RUNNING):
+                log_default(result, fmt, args);
+                break;
+            case (SOCK_FULL):
+                break;
+            case (SOCK_RESERVED): {
+                struct sock_slot* slot = &sock_slots[pos & sock_mask];
+                slot->stamp = lurk_stamp();
+                size_t len = render_log(slot->data, sizeof(slot->data), config, result, fmt, args);
+                slot->len = len < sizeof(slot->data) ? len : sizeof(slot->data) - 1;
+
+                sock_publish(pos);
+                break;
+            }
+        }
+    }
+
+    config_exit();
+}
+
+void lurk_sock_err(result_t result, const char* caller, const char* loc,
+                   const char* fmt, va_list args) {
+    if (fmt == NULL) return;
+
+    const struct config_snapshot* config = config_enter();
+
+    if (config->do_err) {
+        size_t pos;
+        switch (sock_reserve(&pos)) {
+            case (SOCK_NOT_RUNNING):
+                err_default(result, caller, loc, fmt, args);
+                break;
+            case (SOCK_FULL):
+                break;
+            case (SOCK_RESERVED): {
+                struct sock_slot* slot = &sock_slots[pos & sock_mask];
+                slot->stamp = lurk_stamp();
+                size_t len = render_err(slot->data, sizeof(slot->data), config, result,
+                                        caller, loc, fmt, args);
+                slot->len = len < sizeof(slot->data) ? len : sizeof(slot->data) - 1;
+
+                sock_publish(pos);
+                break;
+            }
+        }
+    }
+
+    config_exit();
+}
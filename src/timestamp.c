@@ -0,0 +1,319 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#   include <cpuid.h>
+#   define HAVE_TSC
+#endif
+
+#include "timestamp.h"
+#include "internal.h"
+
+// Like [format.c], this file has no dependencies on the rest of the library so that [lurk-decode]
+// can render timestamps exactly as the library does.
+
+#define PREFIX_LEN 19 // "YYYY-MM-DDTHH:MM:SS"
+
+#define TSC_SHIFT 32
+#define TSC_CALIBRATE_NS 10000000u
+#define TSC_SAMPLES 8
+// a new tick length that differs from the last by more than this (in parts per million) means the
+// wall clock was stepped rather than slewed
+#define TSC_MAX_DRIFT_PPM 1000u
+
+struct time_cache {
+    uint64_t sec;
+    char prefix[PREFIX_LEN];
+};
+
+// [sec] starts out as a second that can never be rendered, so the first call always misses
+static _Thread_local struct time_cache time_cache = { .sec = UINT64_MAX };
+
+static void put_digits(char* p, unsigned v, size_t n) {
+    while (n-- > 0) {
+        p[n] = (char)('0' + v % 10);
+        v /= 10;
+    }
+}
+
+// converts days since 1970-01-01 into a proleptic Gregorian date, counting in 400 year eras that
+// start on March 1st so that leap days fall at the end of each year
+static void civil_from_days(uint64_t days, unsigned* y, unsigned* m, unsigned* d) {
+    days += 719468; // days from 0000-03-01 to 1970-01-01
+    uint64_t era = days / 146097;
+    unsigned doe = (unsigned)(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (unsigned)(era * 400 + yoe) + (*m <= 2);
+}
+
+static void render_prefix(char* p, uint64_t sec) {
+    unsigned y, m, d;
+    civil_from_days(sec / 86400, &y, &m, &d);
+
+    unsigned s = (unsigned)(sec % 86400);
+
+    put_digits(p, y, 4);
+    p[4] = '-';
+    put_digits(p + 5, m, 2);
+    p[7] = '-';
+    put_digits(p + 8, d, 2);
+    p[10] = 'T';
+    put_digits(p + 11, s / 3600, 2);
+    p[13] = ':';
+    put_digits(p + 14, s / 60 % 60, 2);
+    p[16] = ':';
+    put_digits(p + 17, s % 60, 2);
+}
+
+uint64_t lurk_timestamp(void) {
+    struct timespec ts;
+    clock_gettime(LURK_TIMESTAMP_CLOCK, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// renders the rest of a timestamp after its prefix
+static size_t render_suffix(char* buf, uint64_t ns) {
+    buf[PREFIX_LEN] = '.';
+    put_digits(buf + PREFIX_LEN + 1, (unsigned)(ns % 1000000000u / 1000u), 6);
+    buf[PREFIX_LEN + 7] = 'Z';
+    buf[PREFIX_LEN + 8] = '\0';
+
+    return PREFIX_LEN + 8;
+}
+
+size_t lurk_format_timestamp(char* buf, uint64_t ns) {
+    uint64_t sec = ns / 1000000000u;
+
+    if (time_cache.sec != sec) {
+        render_prefix(time_cache.prefix, sec);
+        time_cache.sec = sec;
+    }
+
+    memcpy(buf, time_cache.prefix, PREFIX_LEN);
+    return render_suffix(buf, ns);
+}
+
+size_t timestamp_render(char* buf, uint64_t ns) {
+    render_prefix(buf, ns / 1000000000u);
+    return render_suffix(buf, ns);
+}
+
+
+// The calibration is published as a sequence lock: [tsc_seq] is odd while it is being rewritten,
+// and half of it is the generation of the calibration, which binary logs use to tell when to write
+// a new one. Only the thread holding [tsc_lock] ever rewrites it, and a thread that finds the lock
+// taken while refreshing simply keeps using the calibration it has.
+// ---------------------------------------------------------------------------------------------- //
+static atomic_bool tsc_running = false;
+static atomic_uint tsc_seq = 0;
+static _Atomic uint64_t tsc_anchor = 0;
+static _Atomic uint64_t tsc_anchor_ns = 0;
+static _Atomic uint64_t tsc_mult = 0;
+static atomic_flag tsc_lock = ATOMIC_FLAG_INIT;
+
+// the first sample of the current calibration, so that each refresh measures the tick length over
+// the longest span available; only touched while holding [tsc_lock]
+static uint64_t tsc_base = 0;
+static uint64_t tsc_base_ns = 0;
+
+static uint64_t mul_shift(uint64_t delta, uint64_t mult, uint32_t shift) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 u128;
+    return (uint64_t)(((u128)delta * mult) >> shift);
+#else
+    return (uint64_t)((long double)delta * mult / ((long double)(UINT64_C(1) << shift)));
+#endif
+}
+
+uint64_t lurk_tsc_to_ns(const struct lurk_tsc_calibration* cal, uint64_t stamp) {
+    if (!(stamp & LURK_STAMP_TSC)) return stamp;
+    if (cal == NULL) return 0;
+
+    uint64_t tsc = stamp & ~LURK_STAMP_TSC;
+    if (tsc >= cal->tsc) return cal->ns + mul_shift(tsc - cal->tsc, cal->mult, cal->shift);
+    return cal->ns - mul_shift(cal->tsc - tsc, cal->mult, cal->shift);
+}
+
+unsigned tsc_calibration(struct lurk_tsc_calibration* cal) {
+    for (;;) {
+        unsigned seq = atomic_load_explicit(&tsc_seq, memory_order_acquire);
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+
+        cal->tsc = atomic_load_explicit(&tsc_anchor, memory_order_relaxed);
+        cal->ns = atomic_load_explicit(&tsc_anchor_ns, memory_order_relaxed);
+        cal->mult = atomic_load_explicit(&tsc_mult, memory_order_relaxed);
+        cal->shift = TSC_SHIFT;
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&tsc_seq, memory_order_relaxed) == seq) return seq / 2;
+    }
+}
+
+#ifdef HAVE_TSC
+static uint64_t tsc_read(void) {
+    return __builtin_ia32_rdtsc() & ~LURK_STAMP_TSC;
+}
+
+static void tsc_publish(uint64_t tsc, uint64_t ns, uint64_t mult) {
+    unsigned seq = atomic_load_explicit(&tsc_seq, memory_order_relaxed);
+    atomic_store_explicit(&tsc_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&tsc_anchor, tsc, memory_order_relaxed);
+    atomic_store_explicit(&tsc_anchor_ns, ns, memory_order_relaxed);
+    atomic_store_explicit(&tsc_mult, mult, memory_order_relaxed);
+
+    atomic_store_explicit(&tsc_seq, seq + 2, memory_order_release);
+}
+
+// pairs a TSC reading with the clock, keeping the pair whose two TSC readings around the clock were
+// closest together so that a preemption in between does not skew it
+static void tsc_sample(uint64_t* tsc, uint64_t* ns) {
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < TSC_SAMPLES; i++) {
+        uint64_t before = tsc_read();
+        uint64_t now = lurk_timestamp();
+        uint64_t after = tsc_read();
+
+        if (after - before < best) {
+            best = after - before;
+            *tsc = before + (after - before) / 2;
+            *ns = now;
+        }
+    }
+}
+
+static uint64_t tsc_mult_between(uint64_t tsc0, uint64_t ns0, uint64_t tsc1, uint64_t ns1) {
+    if (tsc1 <= tsc0 || ns1 <= ns0) return 0;
+
+    __extension__ typedef unsigned __int128 u128;
+    return (uint64_t)(((u128)(ns1 - ns0) << TSC_SHIFT) / (tsc1 - tsc0));
+}
+
+static bool tsc_invariant(void) {
+    unsigned a, b, c, d;
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007) return false;
+    if (!__get_cpuid(0x80000007, &a, &b, &c, &d) || !(d & (1u << 8))) return false;
+
+    // the kernel drops the TSC as its clock source when it sees it misbehave (e.g. unsynchronized
+    // between sockets); if it cannot tell us, trust the CPU
+    int fd = open("/sys/devices/system/clocksource/clocksource0/current_clocksource", O_RDONLY);
+    if (fd < 0) return true;
+
+    char source[32] = {0};
+    ssize_t n = read(fd, source, sizeof(source) - 1);
+    close(fd);
+
+    return n <= 0 || strncmp(source, "tsc", 3) == 0;
+}
+#endif
+
+// refreshes the calibration if [stamp] is a TSC stamp taken [LURK_TSC_RECALIBRATE_NS] or more after
+// it was last anchored; the anchor moves to the present and the tick length is measured again from
+// the first sample, unless the clock was stepped in between, in which case the calibration starts
+// over from the new anchor with the old tick length
+unsigned tsc_refresh(uint64_t stamp, struct lurk_tsc_calibration* cal) {
+    unsigned gen = tsc_calibration(cal);
+
+#ifdef HAVE_TSC
+    if (!(stamp & LURK_STAMP_TSC) || !atomic_load_explicit(&tsc_running, memory_order_relaxed))
+        return gen;
+
+    uint64_t tsc = stamp & ~LURK_STAMP_TSC;
+    if (tsc < cal->tsc ||
+        mul_shift(tsc - cal->tsc, cal->mult, cal->shift) < LURK_TSC_RECALIBRATE_NS)
+        return gen;
+
+    if (atomic_flag_test_and_set_explicit(&tsc_lock, memory_order_acquire)) return gen;
+
+    uint64_t now, ns;
+    tsc_sample(&now, &ns);
+
+    uint64_t mult = tsc_mult_between(tsc_base, tsc_base_ns, now, ns);
+    uint64_t drift = mult > cal->mult ? mult - cal->mult : cal->mult - mult;
+
+    if (mult == 0 || drift > cal->mult / 1000000u * TSC_MAX_DRIFT_PPM) {
+        mult = cal->mult;
+        tsc_base = now;
+        tsc_base_ns = ns;
+    }
+
+    tsc_publish(now, ns, mult);
+    atomic_flag_clear_explicit(&tsc_lock, memory_order_release);
+
+    gen = tsc_calibration(cal);
+#else
+    (void)stamp;
+#endif
+
+    return gen;
+}
+
+result_t lurk_tsc_start(void) {
+#ifdef HAVE_TSC
+    while (atomic_flag_test_and_set_explicit(&tsc_lock, memory_order_acquire)) sched_yield();
+
+    if (atomic_load(&tsc_running) || !tsc_invariant()) {
+        atomic_flag_clear_explicit(&tsc_lock, memory_order_release);
+        return RESULT_FAILURE;
+    }
+
+    uint64_t tsc, ns;
+    tsc_sample(&tsc_base, &tsc_base_ns);
+    nanosleep(&(struct timespec){ .tv_nsec = TSC_CALIBRATE_NS }, NULL);
+    tsc_sample(&tsc, &ns);
+
+    uint64_t mult = tsc_mult_between(tsc_base, tsc_base_ns, tsc, ns);
+    if (mult != 0) {
+        tsc_publish(tsc, ns, mult);
+        atomic_store(&tsc_running, true);
+    }
+
+    atomic_flag_clear_explicit(&tsc_lock, memory_order_release);
+    return mult != 0 ? RESULT_SUCCESS : RESULT_FAILURE;
+#else
+    return RESULT_FAILURE;
+#endif
+}
+
+result_t lurk_tsc_stop(void) {
+    return atomic_exchange(&tsc_running, false) ? RESULT_SUCCESS : RESULT_FAILURE;
+}
+
+bool lurk_tsc_running(void) {
+    return atomic_load_explicit(&tsc_running, memory_order_relaxed);
+}
+
+uint64_t lurk_stamp(void) {
+#ifdef HAVE_TSC
+    if (atomic_load_explicit(&tsc_running, memory_order_relaxed))
+        return tsc_read() | LURK_STAMP_TSC;
+#endif
+
+    return lurk_timestamp();
+}
+
+uint64_t lurk_stamp_to_ns(uint64_t stamp) {
+    if (!(stamp & LURK_STAMP_TSC)) return stamp;
+
+    struct lurk_tsc_calibration cal;
+    tsc_refresh(stamp, &cal);
+    return lurk_tsc_to_ns(&cal, stamp);
+}
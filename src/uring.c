@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200809L
+#ifndef _DEFAULT_SOURCE
+#   define _DEFAULT_SOURCE // syscall
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "lurk.h"
+#include "internal.h"
+
+#if defined(__linux__) && defined(__has_include) && !defined(LURK_NO_IO_URING)
+#   if __has_include(<linux/io_uring.h>)
+#       define LURK_HAVE_IO_URING
+#   endif
+#endif
+
+#ifdef LURK_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// The ring is driven with the raw system calls, so no library is needed. Only one batch of the
+// asynchronous writer is ever in flight, as a single vectored write (or a write from the registered
+// buffer when the batch is a single record), so the next batch is only submitted once it completed
+// and records stay in order.
+#define URING_ENTRIES 4
+
+struct uring {
+    int fd;
+    bool fixed_buffer;
+
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;
+    size_t cq_map_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned* sq_array;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    // the number of records in the batch in flight, negated if it could not be submitted
+    int count;
+};
+
+static struct uring uring = { .fd = -1 };
+
+static int uring_enter(unsigned submit, unsigned complete) {
+    for (;;) {
+        long n = syscall(__NR_io_uring_enter, uring.fd, submit, complete,
+                         complete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (n >= 0 || errno != EINTR) return (int)n;
+    }
+}
+
+static void uring_unmap(void) {
+    if (uring.sqes != NULL) munmap(uring.sqes, uring.sqes_size);
+    if (uring.cq_map != NULL && uring.cq_map != uring.sq_map)
+        munmap(uring.cq_map, uring.cq_map_size);
+    if (uring.sq_map != NULL) munmap(uring.sq_map, uring.sq_map_size);
+    if (uring.fd >= 0) close(uring.fd);
+
+    uring = (struct uring){ .fd = -1 };
+}
+
+bool uring_start(void* buf, size_t size) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    long fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (fd < 0) return false;
+    uring.fd = (int)fd;
+
+    // writes at the current file position are what [write] does; without them there is no point
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        uring_unmap();
+        return false;
+    }
+
+    uring.sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring.cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring.cq_map_size > uring.sq_map_size) uring.sq_map_size = uring.cq_map_size;
+        uring.cq_map_size = uring.sq_map_size;
+    }
+
+    uring.sq_map = mmap(NULL, uring.sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring.fd,
+                        IORING_OFF_SQ_RING);
+    if (uring.sq_map == MAP_FAILED) {
+        uring.sq_map = NULL;
+        uring_unmap();
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        uring.cq_map = uring.sq_map;
+    } else {
+        uring.cq_map = mmap(NULL, uring.cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring.fd,
+                            IORING_OFF_CQ_RING);
+        if (uring.cq_map == MAP_FAILED) {
+            uring.cq_map = NULL;
+            uring_unmap();
+            return false;
+        }
+    }
+
+    uring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring.sqes = mmap(NULL, uring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring.fd,
+                      IORING_OFF_SQES);
+    if (uring.sqes == MAP_FAILED) {
+        uring.sqes = NULL;
+        uring_unmap();
+        return false;
+    }
+
+    unsigned char* sq = uring.sq_map;
+    uring.sq_head = (unsigned*)(sq + params.sq_off.head);
+    uring.sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    uring.sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    uring.sq_array = (unsigned*)(sq + params.sq_off.array);
+
+    unsigned char* cq = uring.cq_map;
+    uring.cq_head = (unsigned*)(cq + params.cq_off.head);
+    uring.cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    uring.cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    uring.cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // the registration is optional: pinning the buffer can fail against the locked memory limit,
+    // and plain writes still batch. The descriptors are deliberately not registered as fixed
+    // files, which would pin the files [stdout] and [stderr] referred to at start and ignore a
+    // later [dup2] or [freopen]; a plain descriptor is looked up again at every submission.
+    struct iovec region = { .iov_base = buf, .iov_len = size };
+    uring.fixed_buffer =
+        syscall(__NR_io_uring_register, uring.fd, IORING_REGISTER_BUFFERS, &region, 1) == 0;
+
+    return true;
+}
+
+void uring_stop(void) {
+    if (uring.fd >= 0) uring_unmap();
+}
+
+bool uring_running(void) {
+    return uring.fd >= 0;
+}
+
+void uring_write(int fd, const struct iovec* iov, int count) {
+    unsigned tail = *uring.sq_tail;
+    unsigned index = tail & uring.sq_mask;
+    struct io_uring_sqe* sqe = &uring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->fd = fd;
+    sqe->off = (uint64_t)-1;
+    if (count == 1 && uring.fixed_buffer) {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t)iov[0].iov_base;
+        sqe->len = (uint32_t)iov[0].iov_len;
+    } else {
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->addr = (uint64_t)(uintptr_t)iov;
+        sqe->len = (uint32_t)count;
+    }
+
+    uring.sq_array[index] = index;
+    __atomic_store_n(uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    uring.count = count;
+
+    // if the kernel does not take the batch, nothing was written and [uring_wait] says so
+    if (uring_enter(1, 0) < 0) {
+        __atomic_store_n(uring.sq_tail, *uring.sq_head, __ATOMIC_RELEASE);
+        uring.count = -count;
+    }
+}
+
+int uring_wait(struct iovec* iov) {
+    int count = uring.count;
+    uring.count = 0;
+    if (count <= 0) return 0;
+
+    size_t done = 0;
+    for (;;) {
+        unsigned head = *uring.cq_head;
+        unsigned tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE);
+        if (head != tail) {
+            struct io_uring_cqe* cqe = &uring.cqes[head & uring.cq_mask];
+            if (cqe->res > 0) done = (size_t)cqe->res;
+            __atomic_store_n(uring.cq_head, head + 1, __ATOMIC_RELEASE);
+            break;
+        }
+        if (uring_enter(0, 1) < 0 && errno != EAGAIN && errno != EBUSY) break;
+    }
+
+    // a short or failed write leaves everything from the first record that was not fully written
+    // on to the caller, in order
+    for (int i = 0; i < count; i++) {
+        if (done < iov[i].iov_len) {
+            iov[i].iov_base = (char*)iov[i].iov_base + done;
+            iov[i].iov_len -= done;
+            return i;
+        }
+        done -= iov[i].iov_len;
+    }
+
+    return count;
+}
+
+#else
+
+bool uring_start(void* buf, size_t size) {
+    (void)buf;
+    (void)size;
+    return false;
+}
+
+void uring_stop(void) {}
+
+bool uring_running(void) {
+    return false;
+}
+
+void uring_write(int fd, const struct iovec* iov, int count) {
+    (void)fd;
+    (void)iov;
+    (void)count;
+}
+
+int uring_wait(struct iovec* iov) {
+    (void)iov;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,286 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// lurk-agent.c
+// ---------------------------------------------------------------------------------------------- //
+// A stand-in for a local log collector, for trying out the socket sink (see [sock.h]) on one box.
+// Listens on a Unix-domain or TCP stream socket, accepts any number of senders at once, and writes
+// the records they send to a file ([stdout] by default). Records are only written once they are
+// complete, so records from different senders never interleave within a line; an incomplete record
+// left when a sender goes away is dropped, since the socket sink sends it again in full once it
+// has reconnected.
+//
+//     lurk-agent [-n records] [-o file] <unix:path | tcp:[host:]port>
+//
+//  -n  exits after that many records
+//  -o  appends the records to a file instead of writing them to [stdout]
+//
+// [SIGINT] and [SIGTERM] stop it; on the way out it reports how many records and bytes it received,
+// and how many incomplete records it dropped, on [stderr].
+//
+//     cc -std=c11 -Iinclude -o lurk-agent tools/lurk-agent.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CONNECTIONS 64
+#define BUFFER_SIZE 65536
+#define HOST_MAX 256
+
+struct connection {
+    int fd;
+    size_t len;
+    char* buf;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static struct connection connections[CONNECTIONS];
+static struct pollfd fds[CONNECTIONS + 1];
+
+static uint64_t records = 0;
+static uint64_t bytes = 0;
+static uint64_t partial = 0;
+
+static void on_stop(int signal) {
+    (void)signal;
+    stopping = 1;
+}
+
+static bool write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        buf += n;
+        len -= (size_t)n;
+    }
+
+    return true;
+}
+
+static void count(const char* buf, size_t len) {
+    for (const char* p = buf; (p = memchr(p, '\n', (size_t)(buf + len - p))) != NULL; p++)
+        records++;
+}
+
+// listens on [address], returning the socket or [-1]; [path] is set to the path of a Unix-domain
+// socket, which is removed on the way out
+static int listen_on(const char* address, const char** path) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un un = { .sun_family = AF_UNIX };
+        *path = address + 5;
+        if (strlen(*path) == 0 || strlen(*path) >= sizeof(un.sun_path)) return -1;
+        strcpy(un.sun_path, *path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(*path);
+        if (fd < 0 || bind(fd, (struct sockaddr*)&un, sizeof(un)) != 0 || listen(fd, 64) != 0)
+            return -1;
+        return fd;
+    }
+
+    if (strncmp(address, "tcp:", 4) != 0) return -1;
+
+    // the host is optional: [tcp:port] listens on every address
+    const char* host = address + 4;
+    const char* port = strrchr(host, ':');
+    char name[HOST_MAX];
+    if (port == NULL) {
+        port = host;
+        host = NULL;
+    } else {
+        size_t len = (size_t)(port - host);
+        if (len >= 2 && host[0] == '[' && host[len - 1] == ']') {
+            host++;
+            len -= 2;
+        }
+        if (len >= sizeof(name)) return -1;
+        memcpy(name, host, len);
+        name[len] = '\0';
+        host = name;
+        port++;
+    }
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_flags = AI_PASSIVE,
+    };
+    struct addrinfo* found = NULL;
+    if (getaddrinfo(host, port, &hints, &found) != 0) return -1;
+
+    int fd = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+    int on = 1;
+    bool ok = fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == 0 &&
+              bind(fd, found->ai_addr, found->ai_addrlen) == 0 && listen(fd, 64) == 0;
+    freeaddrinfo(found);
+
+    return ok ? fd : -1;
+}
+
+static void accept_one(int listener) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) return;
+
+    for (int i = 0; i < CONNECTIONS; i++) {
+        if (connections[i].fd >= 0) continue;
+
+        connections[i].fd = fd;
+        connections[i].len = 0;
+        fds[i + 1].fd = fd;
+        return;
+    }
+
+    fprintf(stderr, "lurk-agent: too many senders, refusing one\n");
+    close(fd);
+}
+
+// writes out the complete records of [c], or everything it has once its buffer is full without a
+// complete record in it; once [c] is [closed], an incomplete record after them is dropped
+static bool drain(struct connection* c, int out, bool closed) {
+    size_t len = c->len;
+    while (len > 0 && c->buf[len - 1] != '\n') len--;
+    if (len == 0 && c->len == BUFFER_SIZE) len = c->len;
+
+    if (len > 0) {
+        if (!write_all(out, c->buf, len)) return false;
+        count(c->buf, len);
+    }
+
+    if (closed) {
+        if (c->len > len) partial++;
+        c->len = 0;
+        return true;
+    }
+
+    memmove(c->buf, c->buf + len, c->len - len);
+    c->len -= len;
+    return true;
+}
+
+static void close_one(int i) {
+    close(connections[i].fd);
+    connections[i].fd = -1;
+    connections[i].len = 0;
+    fds[i + 1].fd = -1;
+}
+
+int main(int argc, char** argv) {
+    uint64_t limit = 0;
+    int out = STDOUT_FILENO;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+        switch (opt) {
+            case ('n'): limit = strtoull(optarg, NULL, 10); break;
+            case ('o'):
+                out = open(optarg, O_WRONLY | O_CREAT | O_APPEND, 0644);
+                if (out < 0) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n records] [-o file] <unix:path | tcp:[host:]port>\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    if (argc - optind != 1) {
+        fprintf(stderr, "usage: %s [-n records] [-o file] <unix:path | tcp:[host:]port>\n",
+                argv[0]);
+        return 2;
+    }
+
+    const char* path = NULL;
+    int listener = listen_on(argv[optind], &path);
+    if (listener < 0) {
+        fprintf(stderr, "%s: could not listen\n", argv[optind]);
+        return 1;
+    }
+
+    struct sigaction action = { .sa_handler = &on_stop };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fds[0] = (struct pollfd){ .fd = listener, .events = POLLIN };
+    for (int i = 0; i < CONNECTIONS; i++) {
+        connections[i] = (struct connection){ .fd = -1, .buf = malloc(BUFFER_SIZE) };
+        if (connections[i].buf == NULL) return 1;
+        fds[i + 1] = (struct pollfd){ .fd = -1, .events = POLLIN };
+    }
+
+    int status = 0;
+    while (!stopping && (limit == 0 || records < limit)) {
+        if (poll(fds, CONNECTIONS + 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            status = 1;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) accept_one(listener);
+
+        for (int i = 0; i < CONNECTIONS; i++) {
+            struct connection* c = &connections[i];
+            if (c->fd < 0 || !(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            ssize_t n = read(c->fd, c->buf + c->len, BUFFER_SIZE - c->len);
+            if (n < 0 && errno == EINTR) continue;
+
+            bool closed = n <= 0;
+            if (!closed) {
+                c->len += (size_t)n;
+                bytes += (uint64_t)n;
+            }
+
+            if (!drain(c, out, closed)) {
+                perror("lurk-agent: write");
+                stopping = 1;
+                status = 1;
+            }
+
+            if (closed) close_one(i);
+        }
+    }
+
+    for (int i = 0; i < CONNECTIONS; i++) {
+        if (connections[i].fd >= 0) {
+            drain(&connections[i], out, true);
+            close_one(i);
+        }
+        free(connections[i].buf);
+    }
+
+    close(listener);
+    if (path != NULL) unlink(path);
+
+    fprintf(stderr, "lurk-agent: %llu records, %llu bytes, %llu incomplete records dropped\n",
+            (unsigned long long)records, (unsigned long long)bytes, (unsigned long long)partial);
+    return status;
+}
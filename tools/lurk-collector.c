@@ -0,0 +1,291 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// lurk-collector.c
+// ---------------------------------------------------------------------------------------------- //
+// Drains a shared-memory ring written by [lurk_shm_log] and [lurk_shm_err] (see [shm.h]) into
+// files, in the order the records were logged in across every process writing to it. Log records
+// are appended to the log file and errors to the error file, or to the log file as well when no
+// error file is given. The ring is created if no process has created it yet, so the collector and
+// the processes it collects from can start in any order; only one collector may drain a ring at a
+// time.
+//
+//     lurk-collector [-1] [-u] [-i interval] <ring> <log file> [<error file>]
+//
+//  -1  drains the records already in the ring and exits, e.g. to recover what was left in it
+//  -u  removes the ring when exiting
+//  -i  the number of milliseconds to sleep for when the ring is empty (10 by default)
+//
+// A slot that was claimed but never written stops the collector until it is written, unless the
+// process that claimed it has died, in which case it is skipped. [SIGINT] and [SIGTERM] drain the
+// ring once more and exit.
+//
+//     cc -std=c11 -Iinclude -pthread -o lurk-collector tools/lurk-collector.c build/liblurk.a
+
+#define _POSIX_C_SOURCE 200809L
+#ifndef _DEFAULT_SOURCE
+#   define _DEFAULT_SOURCE // flock
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm.h"
+
+#define BATCH 64
+
+// the layout of [shm.h]
+struct header {
+    char magic[8];
+    _Atomic uint32_t byte_order;
+    uint32_t slots;
+    uint32_t slot_size;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+    _Alignas(64) _Atomic uint64_t head;
+    _Atomic uint64_t skipped;
+};
+
+struct slot {
+    _Atomic uint64_t seq;
+    _Atomic uint32_t pid;
+    uint16_t len;
+    uint8_t err;
+    uint8_t pad;
+    char text[];
+};
+
+struct output {
+    int fd;
+    struct iovec iov[BATCH];
+    int count;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static struct header* ring = NULL;
+static size_t ring_size = 0;
+
+static void on_stop(int signal) {
+    (void)signal;
+    stopping = 1;
+}
+
+static struct slot* slot_at(uint64_t pos) {
+    size_t index = (size_t)(pos & (ring->slots - 1));
+    return (struct slot*)((unsigned char*)ring + LURK_SHM_HEADER_SIZE + index * ring->slot_size);
+}
+
+static bool flush(struct output* out) {
+    struct iovec* iov = out->iov;
+    int count = out->count;
+
+    while (count > 0) {
+        ssize_t n = writev(out->fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        // resume after a partial write
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+
+    out->count = 0;
+    return true;
+}
+
+// decides whether the process whose id is in [s] is gone; a producer sets its id before it claims
+// the slot (see [shm.h]), so a claimed slot always holds one
+static bool abandoned(struct slot* s) {
+    uint32_t pid = atomic_load_explicit(&s->pid, memory_order_acquire);
+    return pid != 0 && kill((pid_t)pid, 0) != 0 && errno == ESRCH;
+}
+
+// skips the claimed slot at [pos] unless its producer finishes it after all
+static bool skip(struct slot* s, uint64_t pos) {
+    uint64_t claimed = pos;
+    if (!atomic_compare_exchange_strong(&s->seq, &claimed, pos + ring->slots)) return false;
+
+    fprintf(stderr, "lurk-collector: skipped a record left unwritten by process %u\n",
+            (unsigned)atomic_load_explicit(&s->pid, memory_order_relaxed));
+
+    atomic_store_explicit(&s->pid, 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring->skipped, 1, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, pos + 1, memory_order_release);
+    return true;
+}
+
+// writes out up to [BATCH] records from the head of the ring, returning how many slots it moved
+// past, or [-1] if writing failed
+static int drain(struct output* log, struct output* err) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int count = 0;
+
+    for (; count < BATCH; count++) {
+        uint64_t pos = head + (uint64_t)count;
+        struct slot* s = slot_at(pos);
+        uint64_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+
+        if (seq != pos + 1) {
+            if (count > 0 || seq != pos || !abandoned(s)) break;
+
+            // a process that died between setting its id and moving the tail leaves the slot
+            // unclaimed but unclaimable, so the id is cleared for the next producer
+            if (atomic_load_explicit(&ring->tail, memory_order_acquire) == pos) {
+                uint32_t pid = atomic_load_explicit(&s->pid, memory_order_relaxed);
+                atomic_compare_exchange_strong(&s->pid, &pid, 0);
+                break;
+            }
+
+            return skip(s, pos) ? 1 : 0;
+        }
+
+        size_t len = s->len <= ring->slot_size - LURK_SHM_SLOT_HEADER
+                   ? s->len : ring->slot_size - LURK_SHM_SLOT_HEADER;
+        struct output* out = s->err && err->fd != log->fd ? err : log;
+        out->iov[out->count++] = (struct iovec){ .iov_base = s->text, .iov_len = len };
+    }
+
+    if (count == 0) return 0;
+    if (!flush(log) || !flush(err)) return -1;
+
+    // the slots go back to the producers only once their records are out
+    for (int i = 0; i < count; i++) {
+        uint64_t pos = head + (uint64_t)i;
+        struct slot* s = slot_at(pos);
+        atomic_store_explicit(&s->pid, 0, memory_order_relaxed);
+        atomic_store_explicit(&s->seq, pos + ring->slots, memory_order_release);
+    }
+
+    atomic_store_explicit(&ring->head, head + (uint64_t)count, memory_order_release);
+    return count;
+}
+
+static int open_output(const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) perror(path);
+    return fd;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [-1] [-u] [-i interval] <ring> <log file> [<error file>]\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    bool once = false;
+    bool unlink_ring = false;
+    unsigned interval = 10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "1ui:")) != -1) {
+        switch (opt) {
+            case ('1'): once = true; break;
+            case ('u'): unlink_ring = true; break;
+            case ('i'): interval = (unsigned)strtoul(optarg, NULL, 10); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    if (argc - optind < 2 || argc - optind > 3) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char* name = argv[optind];
+
+    // creates the ring if no producer has yet, exactly as a producer would
+    if (lurk_shm_start(name, 0) != RESULT_SUCCESS) return 1;
+    lurk_shm_stop();
+
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(name);
+        return 1;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "%s: another collector is draining it\n", name);
+        return 1;
+    }
+
+    ring_size = (size_t)st.st_size;
+    void* mapped = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        perror(name);
+        return 1;
+    }
+    ring = mapped;
+
+    struct output log = { .fd = open_output(argv[optind + 1]) };
+    struct output err = { .fd = log.fd };
+    if (argc - optind == 3) err.fd = open_output(argv[optind + 2]);
+    if (log.fd < 0 || err.fd < 0) return 1;
+
+    struct sigaction action = { .sa_handler = &on_stop };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    struct timespec idle = {
+        .tv_sec = interval / 1000,
+        .tv_nsec = (long)(interval % 1000) * 1000000L,
+    };
+
+    int status = 0;
+    for (;;) {
+        int n = drain(&log, &err);
+        if (n < 0) {
+            perror("lurk-collector: write");
+            status = 1;
+            break;
+        }
+
+        if (n > 0) continue;
+        if (once || stopping) break;
+
+        nanosleep(&idle, NULL);
+    }
+
+    uint64_t dropped = atomic_load(&ring->dropped);
+    uint64_t skipped = atomic_load(&ring->skipped);
+    if (dropped > 0 || skipped > 0) {
+        fprintf(stderr, "lurk-collector: %llu records dropped, %llu skipped\n",
+                (unsigned long long)dropped, (unsigned long long)skipped);
+    }
+
+    if (unlink_ring) shm_unlink(name);
+    munmap(ring, ring_size);
+    close(fd);
+
+    return status;
+}
@@ -0,0 +1,451 @@
+// license
+// ---------------------------------------------------------------------------------------------- //
+// Copyright (c) 2023, Casey Walker
+// All rights reserved.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+//
+//
+// lurk-decode.c
+// ---------------------------------------------------------------------------------------------- //
+// Renders a binary log written by [lurk_binlog_start] or dumped by the flight recorder (see
+// [recorder.h]) into the text format of the default log and error functions. Reads the file given
+// as the only argument, or [stdin] when there is none, and writes the text to [stdout]. A file
+// written by [lurk_mmap_start] (see [mmap.h]) is recognized by its magic and its committed records
+// are written out as they are. A core file is recognized as an ELF file and searched for flight
+// recorder rings, whose records are rendered ring by ring.
+//
+//     cc -std=c11 -pthread -Iinclude -o lurk-decode tools/lurk-decode.c src/*.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binlog.h"
+#include "domain.h"
+#include "mmap.h"
+#include "recorder.h"
+#include "timestamp.h"
+
+#define RECORD_MAX UINT16_MAX
+#define ARGS_MAX UINT8_MAX
+#define MSG_SIZE 4096
+#define ELF_MAGIC "\177ELF"
+
+struct site {
+    char* caller;
+    char* loc;
+    char* fmt;
+};
+
+struct reader {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok;
+};
+
+static struct site* sites = NULL;
+static size_t nsites = 0;
+
+static char* projname = NULL;
+static char* prefix = NULL;
+static char* postfix = NULL;
+
+// the calibration of the TSC stamps that follow, once the log has given one
+static struct lurk_tsc_calibration calibration;
+static bool have_calibration = false;
+
+static void get(struct reader* r, void* out, size_t n) {
+    if (!r->ok || (size_t)(r->end - r->p) < n) {
+        r->ok = false;
+        memset(out, 0, n);
+        return;
+    }
+    memcpy(out, r->p, n);
+    r->p += n;
+}
+
+static uint8_t get_u8(struct reader* r) { uint8_t v; get(r, &v, sizeof(v)); return v; }
+static uint16_t get_u16(struct reader* r) { uint16_t v; get(r, &v, sizeof(v)); return v; }
+static uint32_t get_u32(struct reader* r) { uint32_t v; get(r, &v, sizeof(v)); return v; }
+static uint64_t get_u64(struct reader* r) { uint64_t v; get(r, &v, sizeof(v)); return v; }
+
+// strings are returned as heap copies so they outlive the record
+static char* get_str(struct reader* r) {
+    uint16_t n = get_u16(r);
+    if (!r->ok || (size_t)(r->end - r->p) < n) {
+        r->ok = false;
+        return NULL;
+    }
+
+    char* s = malloc((size_t)n + 1);
+    if (s == NULL) {
+        r->ok = false;
+        return NULL;
+    }
+
+    memcpy(s, r->p, n);
+    s[n] = '\0';
+    r->p += n;
+    return s;
+}
+
+static bool define_site(uint32_t id, struct site site) {
+    if (id == 0) return false;
+
+    if (id > nsites) {
+        size_t n = nsites == 0 ? 64 : nsites;
+        while (n < id) n *= 2;
+
+        struct site* grown = realloc(sites, n * sizeof(*grown));
+        if (grown == NULL) return false;
+
+        memset(grown + nsites, 0, (n - nsites) * sizeof(*grown));
+        sites = grown;
+        nsites = n;
+    }
+
+    struct site* s = &sites[id - 1];
+    free(s->caller);
+    free(s->loc);
+    free(s->fmt);
+    *s = site;
+    return true;
+}
+
+static void print_event(const struct site* site, struct reader* r) {
+    result_t result = (result_t)get_u32(r);
+    uint64_t stamp = get_u64(r);
+    uint8_t nargs = get_u8(r);
+
+    struct lurk_arg args[ARGS_MAX];
+    char* strs[ARGS_MAX] = {0};
+
+    for (uint8_t i = 0; i < nargs && r->ok; i++) {
+        args[i].type = (enum lurk_arg_type)get_u8(r);
+
+        switch (args[i].type) {
+            case (LURK_ARG_INT): args[i].i = (long long)get_u64(r); break;
+            case (LURK_ARG_UINT): args[i].u = get_u64(r); break;
+            case (LURK_ARG_DOUBLE): get(r, &args[i].d, sizeof(args[i].d)); break;
+            case (LURK_ARG_STR): args[i].s = strs[i] = get_str(r); break;
+            case (LURK_ARG_PTR): args[i].p = (const void*)(uintptr_t)get_u64(r); break;
+            default: r->ok = false; break;
+        }
+    }
+
+    if (r->ok && (stamp & LURK_STAMP_TSC) && !have_calibration)
+        fprintf(stderr, "lurk-decode: TSC stamp without a calibration\n");
+
+    if (r->ok) {
+        char when[LURK_TIMESTAMP_SIZE];
+        lurk_format_timestamp(when, lurk_tsc_to_ns(have_calibration ? &calibration : NULL, stamp));
+
+        char msg[MSG_SIZE];
+        lurk_format_args(msg, sizeof(msg), site->fmt, nargs, args);
+
+        // a result the library has a name for, which includes every built-in one, is printed by
+        // its name like the text records are (see [domain.h]); codes registered only by the program
+        // that wrote the log are not known here
+        char code[sizeof("ffffffff")];
+        const char* name = lurk_result_name(result);
+        if (name == NULL) {
+            snprintf(code, sizeof(code), "%08x", (unsigned)result);
+            name = code;
+        }
+
+        // logged records have neither a caller nor a location
+        if (site->caller == NULL)
+            printf("%s  %s  [%s]  %s%s%s", when, name, projname != NULL ? projname : "lurk",
+                   prefix != NULL ? prefix : "", msg, postfix != NULL ? postfix : "\n");
+        else
+            printf("%s  %s  [%s:%s.%s]  %s%s%s", when, name,
+                   projname != NULL ? projname : "lurk",
+                   site->caller, site->loc,
+                   prefix != NULL ? prefix : "", msg, postfix != NULL ? postfix : "\n");
+    }
+
+    for (uint8_t i = 0; i < nargs; i++) free(strs[i]);
+}
+
+static bool decode_record(const unsigned char* rec, size_t size) {
+    struct reader r = { .p = rec, .end = rec + size, .ok = true };
+
+    switch ((enum lurk_binlog_kind)get_u8(&r)) {
+        case (LURK_BINLOG_HEADER): {
+            char magic[sizeof(LURK_BINLOG_MAGIC) - 1];
+            get(&r, magic, sizeof(magic));
+            if (memcmp(magic, LURK_BINLOG_MAGIC, sizeof(magic)) != 0) return false;
+
+            if (get_u32(&r) != LURK_BINLOG_BYTE_ORDER) {
+                fprintf(stderr, "lurk-decode: log was written with a different byte order\n");
+                return false;
+            }
+
+            free(projname);
+            free(prefix);
+            free(postfix);
+            projname = get_str(&r);
+            prefix = get_str(&r);
+            postfix = get_str(&r);
+
+            // a new stream restarts the site definitions and the calibration
+            for (size_t i = 0; i < nsites; i++) define_site((uint32_t)i + 1, (struct site){0});
+            have_calibration = false;
+            break;
+        }
+        case (LURK_BINLOG_SITE): {
+            uint32_t id = get_u32(&r);
+            struct site s = { .caller = get_str(&r), .loc = get_str(&r), .fmt = get_str(&r) };
+            if (!r.ok || !define_site(id, s)) return false;
+            break;
+        }
+        case (LURK_BINLOG_EVENT): {
+            uint32_t id = get_u32(&r);
+            if (id == 0 || id > nsites || sites[id - 1].fmt == NULL) {
+                fprintf(stderr, "lurk-decode: event for undefined site %u\n", id);
+                return true;
+            }
+            print_event(&sites[id - 1], &r);
+            break;
+        }
+        case (LURK_BINLOG_INLINE_EVENT): {
+            struct site s = { .caller = get_str(&r), .loc = get_str(&r), .fmt = get_str(&r) };
+            if (r.ok) print_event(&s, &r);
+            free(s.caller);
+            free(s.loc);
+            free(s.fmt);
+            break;
+        }
+        case (LURK_BINLOG_INLINE_LOG): {
+            struct site s = { .fmt = get_str(&r) };
+            if (r.ok) print_event(&s, &r);
+            free(s.fmt);
+            break;
+        }
+        case (LURK_BINLOG_CLOCK): {
+            calibration.tsc = get_u64(&r);
+            calibration.ns = get_u64(&r);
+            calibration.mult = get_u64(&r);
+            calibration.shift = get_u32(&r);
+            have_calibration = r.ok && calibration.shift < 64;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    return r.ok;
+}
+
+// the bytes read ahead to tell the two formats apart are consumed before the rest of [in]
+struct input {
+    FILE* f;
+    unsigned char ahead[LURK_MMAP_HEADER_SIZE];
+    size_t pos;
+    size_t len;
+};
+
+static size_t input_read(struct input* in, void* out, size_t n) {
+    size_t got = in->len - in->pos < n ? in->len - in->pos : n;
+    memcpy(out, in->ahead + in->pos, got);
+    in->pos += got;
+
+    return got + fread((unsigned char*)out + got, 1, n - got, in->f);
+}
+
+static int decode_binlog(struct input* in) {
+    static unsigned char rec[RECORD_MAX];
+    uint16_t size;
+
+    while (input_read(in, &size, sizeof(size)) == sizeof(size)) {
+        if (size < sizeof(size) + 1) {
+            fprintf(stderr, "lurk-decode: corrupt record size %u\n", size);
+            return 1;
+        }
+
+        size_t body = size - sizeof(size);
+        if (input_read(in, rec, body) != body) {
+            fprintf(stderr, "lurk-decode: truncated record\n");
+            return 1;
+        }
+
+        if (!decode_record(rec, body)) {
+            fprintf(stderr, "lurk-decode: corrupt record\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// a zero header word is skipped one aligned word at a time; a record that was started but never
+// committed is skipped whole, since its length was written first
+static int decode_mapped(struct input* in) {
+    uint32_t order;
+    memcpy(&order, in->ahead + strlen(LURK_MMAP_MAGIC), sizeof(order));
+    if (order != LURK_MMAP_BYTE_ORDER) {
+        fprintf(stderr, "lurk-decode: file was written with a different byte order\n");
+        return 1;
+    }
+
+    char* text = NULL;
+    size_t size = 0;
+    size_t uncommitted = 0;
+    uint32_t word;
+
+    while (input_read(in, &word, sizeof(word)) == sizeof(word)) {
+        size_t len = word & ~LURK_MMAP_COMMITTED;
+        size_t frame = (sizeof(word) + len + LURK_MMAP_ALIGN - 1) & ~(size_t)(LURK_MMAP_ALIGN - 1);
+        size_t rest = frame - sizeof(word);
+
+        if (rest > size) {
+            char* grown = realloc(text, rest);
+            if (grown == NULL) {
+                fprintf(stderr, "lurk-decode: out of memory\n");
+                return 1;
+            }
+            text = grown;
+            size = rest;
+        }
+
+        if (input_read(in, text, rest) != rest) {
+            fprintf(stderr, "lurk-decode: truncated record\n");
+            return 1;
+        }
+
+        if (len == 0) continue;
+
+        if (!(word & LURK_MMAP_COMMITTED)) {
+            uncommitted++;
+            continue;
+        }
+
+        fwrite(text, 1, len, stdout);
+    }
+
+    if (uncommitted > 0)
+        fprintf(stderr, "lurk-decode: skipped %zu uncommitted records\n", uncommitted);
+
+    free(text);
+    return 0;
+}
+
+static uint32_t load_u32(const unsigned char* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static uint64_t load_u64(const unsigned char* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+// renders the records of the ring at [ring], oldest first, if it holds a complete ring header and
+// its slots fit in the [avail] bytes that follow it; returns the size of the ring, or [0]
+static size_t decode_ring(const unsigned char* ring, size_t avail) {
+    if (avail < LURK_RECORDER_HEADER_SIZE) return 0;
+    if (load_u32(ring + 8) != LURK_RECORDER_BYTE_ORDER) return 0;
+
+    uint32_t slots = load_u32(ring + 12);
+    uint32_t slot_size = load_u32(ring + 16);
+    if (slots == 0 || (slots & (slots - 1)) != 0) return 0;
+    if (slot_size < 64 || slot_size % 8 != 0 || slot_size - sizeof(uint64_t) > RECORD_MAX) return 0;
+    if ((avail - LURK_RECORDER_HEADER_SIZE) / slot_size < slots) return 0;
+
+    uint64_t head = load_u64(ring + 24);
+    calibration.tsc = load_u64(ring + 32);
+    calibration.ns = load_u64(ring + 40);
+    calibration.mult = load_u64(ring + 48);
+    calibration.shift = load_u32(ring + 56);
+    have_calibration = calibration.mult != 0 && calibration.shift < 64;
+
+    const unsigned char* first = ring + LURK_RECORDER_HEADER_SIZE;
+    for (uint64_t n = head > slots ? head - slots : 0; n < head; n++) {
+        const unsigned char* slot = first + (n & (slots - 1)) * slot_size;
+        // the record was overwritten, or was being written when the core was taken
+        if (load_u64(slot) != n + 1) continue;
+
+        uint16_t size;
+        memcpy(&size, slot + sizeof(uint64_t), sizeof(size));
+        if (size < sizeof(size) + 1 || size > slot_size - sizeof(uint64_t)) continue;
+
+        if (!decode_record(slot + sizeof(uint64_t) + sizeof(size), size - sizeof(size)))
+            fprintf(stderr, "lurk-decode: corrupt record in the ring of thread %u\n",
+                    load_u32(ring + 20));
+    }
+
+    return LURK_RECORDER_HEADER_SIZE + (size_t)slots * slot_size;
+}
+
+// rings are aligned to 64 bytes in memory, and so in the segments of a core file, which start on
+// page boundaries
+static int decode_core(struct input* in) {
+    size_t size = in->len, cap = in->len;
+    unsigned char* core = malloc(cap);
+    if (core == NULL) {
+        fprintf(stderr, "lurk-decode: out of memory\n");
+        return 1;
+    }
+    memcpy(core, in->ahead, in->len);
+
+    for (;;) {
+        if (size == cap) {
+            unsigned char* grown = realloc(core, cap * 2);
+            if (grown == NULL) {
+                fprintf(stderr, "lurk-decode: out of memory\n");
+                free(core);
+                return 1;
+            }
+            core = grown;
+            cap *= 2;
+        }
+
+        size_t n = fread(core + size, 1, cap - size, in->f);
+        if (n == 0) break;
+        size += n;
+    }
+
+    size_t rings = 0;
+    size_t magic = strlen(LURK_RECORDER_MAGIC);
+    for (size_t at = 0; at + LURK_RECORDER_HEADER_SIZE <= size; at += 64) {
+        if (memcmp(core + at, LURK_RECORDER_MAGIC, magic) != 0) continue;
+
+        size_t ring = decode_ring(core + at, size - at);
+        if (ring == 0) continue;
+
+        rings++;
+        at += ring - 64;
+    }
+
+    if (rings == 0) fprintf(stderr, "lurk-decode: no flight recorder rings found\n");
+
+    free(core);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [binary log, mapped file, or core file]\n", argv[0]);
+        return 2;
+    }
+
+    struct input in = { .f = stdin };
+    if (argc == 2) {
+        in.f = fopen(argv[1], "rb");
+        if (in.f == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    in.len = fread(in.ahead, 1, sizeof(in.ahead), in.f);
+
+    size_t magic = strlen(LURK_MMAP_MAGIC);
+    if (in.len == sizeof(in.ahead) && memcmp(in.ahead, LURK_MMAP_MAGIC, magic) == 0) {
+        in.pos = in.len;
+        return decode_mapped(&in);
+    }
+
+    if (in.len == sizeof(in.ahead) && memcmp(in.ahead, ELF_MAGIC, strlen(ELF_MAGIC)) == 0)
+        return decode_core(&in);
+
+    return decode_binlog(&in);
+}